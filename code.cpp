@@ -2,7 +2,17 @@
 #include <Adafruit_ST7789.h>
 #include <SPI.h>
 #include <ESP32Servo.h>
+#include <LittleFS.h>
 #include <math.h>
+#include <atomic>
+#include <algorithm>
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+#include "esp_adc/adc_continuous.h"
+#endif
+#include "pitch_dsp.h"
+#include "sim_model.h"
+#include "pluck_synth.h"
+#include "counting_st7789.h"
 
 // ===== TFT DISPLAY =====
 #define TFT_MOSI  11
@@ -12,15 +22,17 @@
 #define TFT_RST   6
 #define TFT_BL    10
 
-Adafruit_ST7789 tft = Adafruit_ST7789(TFT_CS, TFT_DC, TFT_RST);
+CountingST7789 tft(TFT_CS, TFT_DC, TFT_RST);
 
 // ===== BUTTONS =====
 #define BTN_TOGGLE    46
 #define BTN_SELECT    3
 
-bool lastButtonState[2] = {LOW, LOW};
-unsigned long buttonPressStart[2] = {0, 0};
-bool buttonLongPressTriggered[2] = {false, false};
+// Press classification; a very long press fires while still held
+const unsigned long BUTTON_DEBOUNCE_MS = 20;
+const unsigned long BUTTON_CLICK_MS = 50;  // Shorter presses are ignored
+const unsigned long BUTTON_LONG_MS = 800;
+const unsigned long BUTTON_VERY_LONG_MS = 2000;
 
 // ===== PIEZO SENSOR =====
 const int PIEZO_PIN = 2;
@@ -29,19 +41,33 @@ const int PIEZO_PIN = 2;
 const int SERVO_PIN = 45;
 
 // ===== AUTOCORRELATION CONFIG =====
-const uint16_t SAMPLES = 1024;
-const double SAMPLING_FREQ = 8192.0;
-int16_t *sampleBuffer;
+// Detector constants and flags, the tuning tables and the sample ring are
+// in pitch_dsp.h, shared with the host benchmark and tests.
 
-// Frequency range for guitar (E2=82Hz to E4=330Hz)
-const float F_MIN = 75.0f;
-const float F_MAX = 450.0f;
-float NOISE_THRESHOLD = 4.0f;
+// Run capture + pitch detection in its own task on core 0, leaving loop()
+// on core 1 for buttons, servo and display
+#ifndef DSP_DUAL_CORE
+#define DSP_DUAL_CORE 1
+#endif
+
+// Detector debug prints; off while benchmarking so they don't skew timings
+bool pitchDebugLog = true;
 
 // ===== PITCH TRACKING =====
-float lastValidFreq = 0.0f;
-unsigned long lastValidTime = 0;
-const unsigned long HOLD_TIME = 300;
+// Between the detector and the servo: frames further than TRACK_OUTLIER_CENTS
+// from the median of the last TRACK_MEDIAN_LEN are dropped (octave jumps,
+// pick noise), the rest feed a constant-velocity Kalman filter on
+// log-frequency. The track ends TRACK_TIMEOUT_MS after the last accepted frame.
+const int TRACK_MEDIAN_LEN = 5;
+const float TRACK_OUTLIER_CENTS = 35.0f;
+const float TRACK_RESET_CENTS = 80.0f;    // Innovation that restarts the filter
+const float TRACK_MEAS_CENTS = 4.0f;      // Detector noise, 1 sigma
+const float TRACK_RATE_CENTS = 50.0f;     // Initial drift uncertainty, cents/s
+const float TRACK_ACCEL = 2000.0f;        // White-acceleration noise, cents^2/s^3
+const unsigned long TRACK_TIMEOUT_MS = 300;
+const float TRACK_CONFIDENT = 0.6f;       // Confidence for the short in-tune wait
+const float TRACK_STEP_SPREAD = 0.2f;     // Uncertainty of an expected step, as a fraction of it
+const float TRACK_TRANSIENT_NOISE = 2.0f;  // Detector noise multiplier at the start of a step
 
 // ===== SYSTEM STATES =====
 enum SystemState {
@@ -50,7 +76,8 @@ enum SystemState {
   STATE_TUNING,
   STATE_AUTO_TUNE_ALL,
   STATE_STRING_SELECT,
-  STATE_MODE_SELECT
+  STATE_MODE_SELECT,
+  STATE_PROFILE         // Hidden: hold SELECT on the string select screen
 };
 
 SystemState currentState = STATE_STANDBY;
@@ -64,33 +91,84 @@ bool autoTuneInProgress = false;
 unsigned long autoTuneStringStartTime = 0;
 const unsigned long AUTO_TUNE_TIMEOUT = 30000;
 
-// ===== TUNING DEFINITIONS =====
-struct TuningDef {
-  const char* name;
-  float freqs[6];
-  const char* noteNames[6];  // Note names for each string in this tuning
-};
-
-TuningDef tuningModes[] = {
-  {"STANDARD",    {82.41, 110.0, 146.83, 196.0, 246.94, 329.63},  {"E2", "A2", "D3", "G3", "B3", "E4"}},
-  {"Eb Standard", {77.78, 103.83, 138.59, 185.0, 233.08, 311.13}, {"Eb2", "Ab2", "Db3", "Gb3", "Bb3", "Eb4"}},
-  {"Drop D",      {73.42, 110.0, 146.83, 196.0, 246.94, 329.63},  {"D2", "A2", "D3", "G3", "B3", "E4"}},
-  {"Open G",      {73.42, 98.0, 146.83, 196.0, 246.94, 293.66},   {"D2", "G2", "D3", "G3", "B3", "D4"}}
-};
-
-const char* NOTE_NAMES[] = {"C","C#","D","D#","E","F","F#","G","G#","A","A#","B"};
-
 int TUNE_TOLERANCE = 10;
-float signalLevel = 0;
 unsigned long currentTuneStartTime = 0;
 
 // ===== SERVO =====
 Servo tunerServo;
-int servoPos = 105;  // Center for 210° servo
+// Center for 210° servo. loop() moves it; atomic because the DSP task's
+// trace records read it too.
+std::atomic<int> servoPos{105};
 int targetServoPos = 105;
 unsigned long lastServoMove = 0;
 uint32_t SERVO_MOVE_PERIOD = 100;  // Reduced from 150 for more responsive tuning
 bool servoAttached = false;
+bool servoMuted = false;  // Offline runs: decide moves but don't drive the servo
+bool offlineRunActive = false;  // Between beginOfflineRun() and endOfflineRun()
+
+// Clock for the tracker and servo logic. Offline runs (replay) set it from
+// the sample count so they can run faster than real time.
+bool useVirtualClock = false;
+unsigned long virtualClockMs = 0;
+
+unsigned long controlMillis() {
+  return useVirtualClock ? virtualClockMs : millis();
+}
+
+// Servo controller: fixed step table, or proportional moves from a
+// cents-per-degree gain learned online for each string
+enum ServoControlMode {
+  SERVO_CTRL_STEP,
+  SERVO_CTRL_ADAPTIVE
+};
+
+int servoControlMode = SERVO_CTRL_ADAPTIVE;
+const float SERVO_GAIN_INIT = 4.0f;    // cents per degree before anything is learned
+const float SERVO_GAIN_MIN = 0.5f;
+const float SERVO_GAIN_MAX = 30.0f;
+const float SERVO_GAIN_ALPHA = 0.5f;   // Weight of each new gain observation
+const int SERVO_MAX_STEP = 12;         // degrees per move
+
+// Adaptive moves are timestamped and the pitch is modelled as reaching its
+// new value along 1 - exp(-t / tau), tau = SERVO_SETTLE_BASE_MS +
+// SERVO_SETTLE_PER_DEG_MS * |deg|. The tracker is told about each move, so
+// frames in the transient are weighed against the model instead of being
+// acted on, and the next move goes out as soon as the tracked pitch is known
+// to SERVO_CONVERGED_CENTS, with no fixed period.
+const unsigned long SERVO_SETTLE_BASE_MS = 60;
+const unsigned long SERVO_SETTLE_PER_DEG_MS = 15;
+const float SERVO_CONVERGED_CENTS = 3.5f;  // Tracker sigma before the next move
+
+float servoGain[6] = {SERVO_GAIN_INIT, SERVO_GAIN_INIT, SERVO_GAIN_INIT,
+                      SERVO_GAIN_INIT, SERVO_GAIN_INIT, SERVO_GAIN_INIT};
+
+// Each move goes out once the tracker has converged and covers
+// SERVO_MOVE_FRACTION of the correction the gain predicts. Coming in from
+// one side, a gain that is off costs a move rather than an overshoot.
+const float SERVO_MOVE_FRACTION = 0.7f;
+
+// The string follows the peg with a lag of its own (120-220 ms) on top of
+// the servo's travel. Gain is learned only between two settled samples:
+// frames accepted once the step model, that lag included, has all but
+// SERVO_SETTLED_LEFT of the travel since the last sample played out, with
+// tracker confidence >= TRACK_CONFIDENT. What is still to come is taken off
+// the travel, so the gain isn't biased low.
+const unsigned long SERVO_STRING_LAG_MS = 170;
+const float SERVO_SETTLED_LEFT = 0.3f;
+const int SERVO_LEARN_MIN_DEG = 2;  // Less travel than this between samples is noise
+
+struct ServoControllerState {
+  int stringNum;
+  bool awaitingSettle;
+  unsigned long moveAt;    // When the servo last moved
+  float pendingDeg;        // Travel the string had yet to follow at moveAt
+  float pendingTauMs;      // Time constant it follows with
+  bool anchored;           // anchorCents is a settled sample on this string
+  float anchorCents;       // Tracked cents re A4 at that sample
+  int degSinceAnchor;      // Servo travel since, signed
+};
+
+ServoControllerState servoCtl = {-1, false, 0, 0.0f, 1.0f, false, 0.0f, 0};
 
 // Servo limits (210° range: 0-210)
 const int SERVO_MIN = 0;
@@ -111,9 +189,10 @@ int lastCents = 0;
 unsigned long inTuneStartTime = 0;
 bool wasInTune = false;
 const unsigned long IN_TUNE_DURATION = 500;
+const unsigned long IN_TUNE_DURATION_CONFIDENT = 250;  // Track confidence >= TRACK_CONFIDENT
 
 // ===== STRUM DETECTION =====
-bool hadSignal = false;
+uint32_t lastOnsetCount = 0;  // Onsets already acted on
 
 // ===== SERVO CONFIRMATION =====
 bool waitingForConfirm = true;  // Wait for SELECT button before servo moves
@@ -123,6 +202,8 @@ bool showSuccessAnimation = false;
 int successAnimationFrame = 0;
 unsigned long successAnimationStartTime = 0;
 const unsigned long SUCCESS_DISPLAY_TIME = 2000;
+const unsigned long SUCCESS_FRAME_PERIOD = 125;  // loop() no longer blocks on capture
+unsigned long lastSuccessFrameTime = 0;
 
 // ===== COLORS =====
 #define COLOR_BG        0x0000
@@ -134,934 +215,3901 @@ const unsigned long SUCCESS_DISPLAY_TIME = 2000;
 #define COLOR_TEXT      0xFFFF
 #define COLOR_TEXT_DIM  0x8410
 
-// ===== SAMPLE CAPTURE =====
+// ===== TRACE LOG =====
+// Control-path events go into a RAM ring as 16-byte binary records and a
+// low-priority task formats them for Serial, so a full UART never stalls a
+// frame. TRACE() costs a few atomics and a struct copy; build with
+// -DTRACE_LOG=0 to compile it out.
+#ifndef TRACE_LOG
+#define TRACE_LOG 1
+#endif
+
+enum TraceEvent : uint8_t {
+  TRACE_TRACK,          // cents = string, value = tracker confidence
+  TRACE_FRAME,          // value = tracked Hz
+  TRACE_FRAME_HELD,     // value = tracked Hz, bridged over a frame with no pitch
+  TRACE_DISPLAY,        // value = pixels pushed by the display update
+  TRACE_ONSET,
+  TRACE_SUBHARMONIC,    // value = corrected Hz
+  TRACE_NARROW,         // Wide detection found a signal
+  TRACE_IN_TUNE_ENTER,
+  TRACE_IN_TUNE_LEAVE,
+  TRACE_IN_TUNE,        // value = hold time in ms
+  TRACE_SERVO_MOVE,     // value = signed step in degrees, servoPos is the new angle
+  TRACE_SERVO_LIMIT,
+  TRACE_SERVO_GAIN,     // cents = string, value = cents/deg
+  TRACE_EVENT_COUNT
+};
 
-void captureSamples() {
-  unsigned long periodUs = 1000000UL / (unsigned long)SAMPLING_FREQ;
+const char* TRACE_EVENT_NAMES[] = {
+  "track", "frame", "held", "display", "onset", "subharmonic", "narrow", "enter", "leave",
+  "in_tune", "servo", "limit", "gain"
+};
+
+struct TraceRecord {
+  uint32_t us;
+  uint8_t event;
+  uint8_t servoPos;
+  int16_t cents;
+  float value;
+  float level;          // signalLevel when the event was logged
+};
+static_assert(sizeof(TraceRecord) == 16, "TraceRecord should stay 16 bytes");
+
+enum TraceOutput {
+  TRACE_OUT_OFF,
+  TRACE_OUT_TEXT,       // The old log lines, frames at most every TRACE_TEXT_FRAME_MS
+  TRACE_OUT_CSV,        // Every record: us,event,servo,cents,value,level
+  TRACE_OUT_BIN         // Every record, framed binary; tools/trace_format.md
+};
+
+// Binary frames: sync, type, payload length, payload, checksum (the low
+// byte of the sum of type, length and payload). Text printed meanwhile sits
+// between frames; tools/trace_decode.py skips it.
+const uint8_t TRACE_BIN_SYNC[2] = {0xA5, 0x5A};
+const uint8_t TRACE_BIN_VERSION = 1;
+enum TraceBinFrame : uint8_t {
+  TRACE_BIN_HEADER = 'H',  // version, record size, event count, NUL-terminated event names
+  TRACE_BIN_RECORD = 'R',  // One TraceRecord, little-endian
+  TRACE_BIN_DROPS = 'D'    // uint32_t records dropped since the last report
+};
+
+const uint32_t TRACE_RING_SIZE = 256;  // Must be a power of two
+const unsigned long TRACE_TEXT_FRAME_MS = 200;
+const int TRACE_LINE_MAX = 128;
+int traceOutput = TRACE_OUT_TEXT;
+
+// Bounded multi-producer / single-consumer ring (the DSP task and loop() both
+// log). A producer claims a slot with a CAS on head and publishes it through
+// the slot's sequence number; when the ring is full the record is dropped and
+// counted rather than waiting for the drain.
+class TraceRing {
+public:
+  void log(uint8_t event, float value, int cents, int servo, float level) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    do {
+      if (h - tail.load(std::memory_order_acquire) >= TRACE_RING_SIZE) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+    } while (!head.compare_exchange_weak(h, h + 1, std::memory_order_relaxed));
+
+    uint32_t i = h & (TRACE_RING_SIZE - 1);
+    TraceRecord &r = slots[i];
+    r.us = micros();
+    r.event = event;
+    r.servoPos = (uint8_t)servo;
+    r.cents = (int16_t)constrain(cents, -32768, 32767);
+    r.value = value;
+    r.level = level;
+    ready[i].store(h + 1, std::memory_order_release);
+  }
+
+  // Consumer side: false when the next record isn't published yet
+  bool pop(TraceRecord &out) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    uint32_t i = t & (TRACE_RING_SIZE - 1);
+    if (ready[i].load(std::memory_order_acquire) != t + 1) return false;
+    out = slots[i];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
 
-  for (int i = 0; i < SAMPLES; i++) {
-    unsigned long start = micros();
-    sampleBuffer[i] = analogRead(PIEZO_PIN);
-    while (micros() - start < periodUs);
+  uint32_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+  TraceRecord slots[TRACE_RING_SIZE];
+  std::atomic<uint32_t> ready[TRACE_RING_SIZE] = {};
+  std::atomic<uint32_t> head{0}, tail{0}, dropped{0};
+};
+
+TraceRing traceRing;
+TaskHandle_t traceTaskHandle = nullptr;
+
+// Level of the frame loop() last took a pitch from. loop() only: the DSP
+// task traces with its own frame's signalLevel through TRACE_AT().
+float pitchLevel = 0;
+
+#if TRACE_LOG
+#define TRACE_AT(event, value, cents, level) \
+  traceRing.log((event), (value), (cents), servoPos.load(std::memory_order_relaxed), (level))
+#else
+#define TRACE_AT(event, value, cents, level) ((void)sizeof((value) + (cents) + (level)))
+#endif
+#define TRACE(event, value, cents) TRACE_AT(event, value, cents, pitchLevel)
+
+// Formats one record the way the log used to print it; returns the length,
+// 0 for a frame skipped by the text rate limit
+int formatTraceText(const TraceRecord &r, char* line) {
+  static uint32_t lastFrameUs = 0;
+  static int string = -1;
+  static float confidence = 0.0f;
+  static unsigned long pixels = 0;
+  unsigned long ms = r.us / 1000;
+  switch (r.event) {
+    case TRACE_TRACK:
+      string = r.cents;
+      confidence = r.value;
+      return 0;
+    case TRACE_DISPLAY:
+      pixels = (unsigned long)r.value;
+      return 0;
+    case TRACE_FRAME:
+    case TRACE_FRAME_HELD:
+      if (r.us - lastFrameUs < TRACE_TEXT_FRAME_MS * 1000) return 0;
+      lastFrameUs = r.us;
+      return snprintf(line, TRACE_LINE_MAX,
+                      "Freq: %.1f Hz | String: %d | Cents: %d | Conf: %.2f | Signal: %.0f | Raw: %s | Px: %lu\n",
+                      r.value, string, r.cents, confidence, r.level,
+                      r.event == TRACE_FRAME ? "YES" : "held", pixels);
+    case TRACE_ONSET:
+      return snprintf(line, TRACE_LINE_MAX,
+                      ">>> NEW STRUM DETECTED at %lu ms - resetting state <<<\n", ms);
+    case TRACE_SUBHARMONIC:
+      return snprintf(line, TRACE_LINE_MAX, "Subharmonic correction: %.1f Hz\n", r.value);
+    case TRACE_NARROW:
+      return snprintf(line, TRACE_LINE_MAX, "Got signal - switching back to narrow detection\n");
+    case TRACE_IN_TUNE_ENTER:
+      return snprintf(line, TRACE_LINE_MAX, "Entered in tune zone...\n");
+    case TRACE_IN_TUNE_LEAVE:
+      return snprintf(line, TRACE_LINE_MAX, "Left in tune zone, resetting\n");
+    case TRACE_IN_TUNE:
+      return snprintf(line, TRACE_LINE_MAX, "IN TUNE (held for %.0fms at %d cents)\n",
+                      r.value, r.cents);
+    case TRACE_SERVO_MOVE:
+      return snprintf(line, TRACE_LINE_MAX, "Servo: %d -> %d (cents: %d, step: %d)\n",
+                      r.servoPos - (int)r.value, r.servoPos, r.cents, abs((int)r.value));
+    case TRACE_SERVO_LIMIT:
+      return snprintf(line, TRACE_LINE_MAX,
+                      "SERVO LIMIT REACHED - need to %s more, press SELECT to reposition\n",
+                      r.cents < 0 ? "tighten" : "loosen");
+    case TRACE_SERVO_GAIN:
+      return snprintf(line, TRACE_LINE_MAX, "Servo gain S%d: %.1f cents/deg\n",
+                      r.cents, r.value);
   }
+  return 0;
+}
+
+// Wraps 'len' payload bytes in a binary frame; returns the frame length
+int traceBinFrame(uint8_t type, const void* payload, int len, char* line) {
+  uint8_t* f = (uint8_t*)line;
+  f[0] = TRACE_BIN_SYNC[0];
+  f[1] = TRACE_BIN_SYNC[1];
+  f[2] = type;
+  f[3] = (uint8_t)len;
+  memcpy(f + 4, payload, len);
+  uint8_t sum = type + (uint8_t)len;
+  for (int i = 0; i < len; i++) sum += f[4 + i];
+  f[4 + len] = sum;
+  return len + 5;
 }
 
-void removeDC() {
-  int32_t sum = 0;
-  for (int i = 0; i < SAMPLES; i++) {
-    sum += sampleBuffer[i];
+int formatTraceBinHeader(char* line) {
+  uint8_t payload[TRACE_LINE_MAX - 6];
+  int n = 0;
+  payload[n++] = TRACE_BIN_VERSION;
+  payload[n++] = sizeof(TraceRecord);
+  payload[n++] = TRACE_EVENT_COUNT;
+  for (int e = 0; e < TRACE_EVENT_COUNT; e++) {
+    int len = strlen(TRACE_EVENT_NAMES[e]) + 1;
+    if (n + len > (int)sizeof(payload)) break;  // The decoder has its own copy of the names
+    memcpy(payload + n, TRACE_EVENT_NAMES[e], len);
+    n += len;
   }
-  int16_t mean = sum / SAMPLES;
-  for (int i = 0; i < SAMPLES; i++) {
-    sampleBuffer[i] -= mean;
+  return traceBinFrame(TRACE_BIN_HEADER, payload, n, line);
+}
+
+int formatTraceCsv(const TraceRecord &r, char* line) {
+  const char* name = r.event < TRACE_EVENT_COUNT ? TRACE_EVENT_NAMES[r.event] : "?";
+  return snprintf(line, TRACE_LINE_MAX, "%lu,%s,%d,%d,%.2f,%.1f\n",
+                  (unsigned long)r.us, name, r.servoPos, r.cents, r.value, r.level);
+}
+
+// Writes a line once the UART has room for it, so this task is the one that
+// waits, never the control path
+void traceWrite(const char* line, int n) {
+  n = min(n, TRACE_LINE_MAX - 1);
+  while (Serial.availableForWrite() < n) vTaskDelay(1);
+  Serial.write((const uint8_t*)line, n);
+}
+
+// Drains the ring at low priority
+void traceTask(void* arg) {
+  char line[TRACE_LINE_MAX];
+  uint32_t reportedDrops = 0;
+  int lastOutput = TRACE_OUT_OFF;
+  while (true) {
+    int output = traceOutput;
+    if (output == TRACE_OUT_BIN && lastOutput != TRACE_OUT_BIN) {
+      traceWrite(line, formatTraceBinHeader(line));  // Each binary stream starts with one
+    }
+    lastOutput = output;
+
+    TraceRecord r;
+    while (traceRing.pop(r)) {
+      int n = 0;
+      if (output == TRACE_OUT_TEXT) n = formatTraceText(r, line);
+      else if (output == TRACE_OUT_CSV) n = formatTraceCsv(r, line);
+      else if (output == TRACE_OUT_BIN) n = traceBinFrame(TRACE_BIN_RECORD, &r, sizeof(r), line);
+      if (n > 0) traceWrite(line, n);
+    }
+    uint32_t drops = traceRing.droppedCount();
+    if (drops != reportedDrops) {
+      uint32_t lost = drops - reportedDrops;
+      int n = output == TRACE_OUT_BIN ?
+              traceBinFrame(TRACE_BIN_DROPS, &lost, sizeof(lost), line) :
+              snprintf(line, TRACE_LINE_MAX, "# trace: %lu records dropped\n", (unsigned long)lost);
+      if (output != TRACE_OUT_OFF) traceWrite(line, n);
+      reportedDrops = drops;
+    }
+    vTaskDelay(pdMS_TO_TICKS(10));
   }
 }
 
-// ===== AUTOCORRELATION PITCH DETECTION =====
+bool startTraceTask() {
+#if TRACE_LOG
+  return xTaskCreatePinnedToCore(traceTask, "trace", 3072, nullptr, 1, &traceTaskHandle, 0) == pdPASS;
+#else
+  return true;
+#endif
+}
 
-float calculateSignalLevel() {
-  int32_t sum = 0;
-  for (int i = 0; i < SAMPLES; i++) {
-    sum += abs(sampleBuffer[i]);
+// ===== PROFILING =====
+// Stages, counters and PROFILE_SCOPE are in profile.h. With PROFILE=0 none
+// of it is built: "prof" says so and the profile screen can't be opened.
+
+#if PROFILE
+void printProfile(Print &out) {
+  float perUs = halCyclesPerUs();
+  out.printf("{\"cycles_per_us\":%.0f,\"stages\":[", perUs);
+  for (int i = 0; i < PROF_STAGE_COUNT; i++) {
+    const ProfileStat &p = profileStats[i];
+    float mean = p.count ? (float)p.totalCycles / p.count : 0.0f;
+    out.printf("%s{\"stage\":\"%s\",\"count\":%lu,\"min_us\":%.1f,\"mean_us\":%.1f,"
+               "\"p99_us\":%.1f,\"max_us\":%.1f}",
+               i ? "," : "", PROFILE_STAGE_NAMES[i], (unsigned long)p.count,
+               p.minCycles / perUs, mean / perUs, profilePercentile(p, 0.99f) / perUs,
+               p.maxCycles / perUs);
   }
-  return (float)sum / SAMPLES;
+  out.println("]}");
 }
+#endif
+
+// ===== FRAME RECORDER =====
+// "rec start" logs every raw ADC sample plus the control state, servo angle
+// and in-tune events into a PSRAM buffer; "rec save" / "rec load" keep it on
+// LittleFS and "replay" runs it back through the detector and servo logic.
+// Sample n of a log is at n / SAMPLING_FREQ, so events are stamped with the
+// number of samples logged before them.
+//
+// Samples are coded against the previous one:
+//   0ddddddd            delta -64..63
+//   10vvvvvv vvvvvvvv   absolute 14-bit value (first sample, large steps)
+// tuner_sim --record measures 1.01 bytes/sample over its auto-tune runs
+// (plucks, decay and silence), so REC_SAMPLE_BYTES holds about 125 s.
+const size_t REC_SAMPLE_BYTES = 1 << 20;
+const int REC_MAX_EVENTS = 1024;
+const uint32_t REC_MAGIC = 0x31435247;  // "GRC1"
+const char* REC_PATH = "/rec.bin";
+
+enum RecordEventType : uint8_t {
+  REC_EVENT_STATE,      // v: state, tuning, selected string + 1, auto-tune string, flags
+  REC_EVENT_SERVO,      // v[0..1]: angle written, little-endian
+  REC_EVENT_IN_TUNE
+};
 
-float detectPitchAutocorrelation(float expectedFreq) {
-  removeDC();
+// Flags in a STATE event
+const uint8_t REC_FLAG_WAITING = 1;
+const uint8_t REC_FLAG_AUTO_MODE = 2;
+const uint8_t REC_FLAG_WIDE = 4;
+const uint8_t REC_FLAG_AUTO_TUNE = 8;
+
+struct RecordEvent {
+  uint32_t sample;
+  uint8_t type;
+  uint8_t v[7];
+};
+
+struct RecordHeader {
+  uint32_t magic;
+  uint32_t sampleRate;
+  uint32_t sampleBytes;
+  uint32_t events;
+};
 
-  signalLevel = calculateSignalLevel();
-  if (signalLevel < NOISE_THRESHOLD) {
-    return 0.0f;
+// The acquisition task is the only writer of samples and loop() the only
+// writer of events, so neither needs a lock
+class FrameRecorder {
+public:
+  uint8_t* bytes = nullptr;
+  RecordEvent* events = nullptr;
+  int eventCount = 0;
+
+  bool alloc() {
+    if (bytes) return true;
+    bytes = (uint8_t*)(psramFound() ? ps_malloc(REC_SAMPLE_BYTES) : malloc(REC_SAMPLE_BYTES));
+    events = (RecordEvent*)malloc(REC_MAX_EVENTS * sizeof(RecordEvent));
+    if (!bytes || !events) {
+      free(bytes);
+      free(events);
+      bytes = nullptr;
+      events = nullptr;
+      return false;
+    }
+    return true;
   }
 
-  int globalMinLag = (int)(SAMPLING_FREQ / F_MAX);
-  int globalMaxLag = (int)(SAMPLING_FREQ / F_MIN);
-  if (globalMaxLag > SAMPLES / 2) globalMaxLag = SAMPLES / 2;
-  if (globalMinLag < 2) globalMinLag = 2;
+  // Restarting while recording is fine: the acquisition task is waited out
+  // of sample() before the counters are reset under it
+  bool start() {
+    if (!alloc()) return false;
+    recording.store(false);
+    while (inSample.load()) yield();
+    used.store(0);
+    samples.store(0);
+    prev = 0;
+    eventCount = 0;
+    full.store(false);
+    recording.store(true, std::memory_order_release);
+    return true;
+  }
 
-  int minLag = globalMinLag;
-  int maxLag = globalMaxLag;
+  void stop() { recording.store(false); }
+  bool active() const { return recording.load(std::memory_order_relaxed); }
+  bool overflowed() const { return full.load(std::memory_order_acquire); }
+  size_t sampleBytes() const { return used.load(std::memory_order_acquire); }
+  uint32_t sampleCount() const { return samples.load(std::memory_order_acquire); }
+
+  // Acquisition task. inSample is raised before recording is checked again,
+  // so start() either sees it or this call sees the recorder stopped.
+  void sample(int16_t raw) {
+    if (!recording.load(std::memory_order_acquire)) return;
+    inSample.store(true);
+    if (recording.load()) append(raw);
+    inSample.store(false, std::memory_order_release);
+  }
 
-  if (expectedFreq > 0.0f) {
-    int centerLag = (int)(SAMPLING_FREQ / expectedFreq);
-    // Narrower window: 0.7x to 1.3x to avoid harmonics
-    int localMin = (int)(centerLag * 0.7f);
-    int localMax = (int)(centerLag * 1.3f);
-    if (localMin < globalMinLag) localMin = globalMinLag;
-    if (localMax > globalMaxLag) localMax = globalMaxLag;
-    minLag = localMin;
-    maxLag = localMax;
+  // loop()
+  void event(uint8_t type, const uint8_t* v, int len) {
+    if (!active() || eventCount >= REC_MAX_EVENTS) return;
+    RecordEvent &e = events[eventCount++];
+    e.sample = sampleCount();
+    e.type = type;
+    memset(e.v, 0, sizeof(e.v));
+    if (v) memcpy(e.v, v, min(len, (int)sizeof(e.v)));
   }
 
-  int32_t maxCorr = 0;
-  int bestLag = 0;
+  // Used by load: the log is replaced wholesale
+  void setLoaded(size_t sampleBytes, int events) {
+    used.store(sampleBytes);
+    samples.store(0);  // Not known until decoded
+    eventCount = events;
+    full.store(false);
+  }
 
-  for (int lag = minLag; lag <= maxLag; lag++) {
-    int32_t corr = 0;
-    for (int i = 0; i < SAMPLES - lag; i++) {
-      corr += (int32_t)sampleBuffer[i] * sampleBuffer[i + lag];
+private:
+  std::atomic<bool> recording{false};
+  std::atomic<bool> inSample{false};
+  std::atomic<size_t> used{0};
+  std::atomic<uint32_t> samples{0};
+  int16_t prev = 0;
+  std::atomic<bool> full{false};  // Set by the acquisition task, read by loop()
+
+  void append(int16_t raw) {
+    size_t u = used.load(std::memory_order_relaxed);
+    uint32_t n = samples.load(std::memory_order_relaxed);
+    if (u + 2 > REC_SAMPLE_BYTES) {
+      full.store(true, std::memory_order_release);
+      recording.store(false);
+      return;
     }
-    if (corr > maxCorr) {
-      maxCorr = corr;
-      bestLag = lag;
+    int d = raw - prev;
+    if (n > 0 && d >= -64 && d <= 63) {
+      bytes[u++] = (uint8_t)(d & 0x7F);
+    } else {
+      bytes[u++] = 0x80 | ((raw >> 8) & 0x3F);
+      bytes[u++] = raw & 0xFF;
     }
+    prev = raw;
+    used.store(u, std::memory_order_release);
+    samples.store(n + 1, std::memory_order_release);
   }
+};
+
+FrameRecorder frameRecorder;
 
-  if (bestLag == 0) return 0.0f;
+// Sequential decoder for the sample bytes
+struct RecordReader {
+  const uint8_t* p;
+  const uint8_t* end;
+  int16_t prev;
 
-  float detectedFreq = SAMPLING_FREQ / (float)bestLag;
-  if (detectedFreq < F_MIN || detectedFreq > F_MAX) {
-    return 0.0f;
+  bool next(int16_t &raw) {
+    if (p >= end) return false;
+    uint8_t b = *p++;
+    if (b & 0x80) {
+      if (p >= end) return false;
+      raw = (int16_t)(((b & 0x3F) << 8) | *p++);
+    } else {
+      raw = prev + (int16_t)((int8_t)(b << 1) >> 1);  // Sign-extend 7 bits
+    }
+    prev = raw;
+    return true;
   }
+};
+
+// ===== SAMPLE CAPTURE =====
+// The ring, frame capture and prefilter are in pitch_dsp.cpp; the sources
+// that feed the ring stay here with the rest of the device code.
+
+// Anything that can feed the ring: the piezo ADC on the device, or a
+// synthetic/recorded signal when testing without a guitar.
+class SampleSource {
+public:
+  virtual ~SampleSource() {}
+  virtual bool begin(SampleRing* ring) = 0;
+  virtual void end() = 0;
+};
 
-  // Always check for subharmonic (octave below) - harmonics are common on guitar
-  // If detected frequency is significantly higher than expected, check for fundamental
-  bool checkSubharmonic = false;
-  if (expectedFreq > 0.0f && detectedFreq > expectedFreq * 1.4f) {
-    // Detected freq is way higher than expected - likely a harmonic
-    checkSubharmonic = true;
-  } else if (expectedFreq <= 0.0f && detectedFreq > 150.0f) {
-    // Auto mode - check higher frequencies for possible harmonics
-    checkSubharmonic = true;
+// A source fed by its own task. end() asks the task to stop and waits until
+// it has: the task finishes the poll() it is in (never mid-push()) and
+// deletes itself.
+class TaskSampleSource : public SampleSource {
+public:
+  void end() override {
+    if (!task) return;
+    stopping.store(true, std::memory_order_release);
+    while (!stopped.load(std::memory_order_acquire)) delay(1);
+    task = nullptr;
   }
-  
-  if (checkSubharmonic) {
-    int doubleLag = bestLag * 2;
-    if (doubleLag <= globalMaxLag) {
-      int32_t corr2x = 0;
-      for (int i = 0; i < SAMPLES - doubleLag; i++) {
-        corr2x += (int32_t)sampleBuffer[i] * sampleBuffer[i + doubleLag];
-      }
-      // If subharmonic correlation is reasonably strong, use it
-      if (corr2x > maxCorr * 0.5f) {
-        bestLag = doubleLag;
-        maxCorr = corr2x;
-        detectedFreq = SAMPLING_FREQ / (float)bestLag;
-        Serial.printf("Subharmonic correction: %.1f Hz\n", detectedFreq);
-      }
+
+protected:
+  bool startTask(const char* name, uint32_t stack, UBaseType_t priority) {
+    stopping.store(false);
+    stopped.store(false);
+    if (xTaskCreatePinnedToCore(taskEntry, name, stack, this, priority, &task, 0) != pdPASS) {
+      task = nullptr;
+      return false;
+    }
+    return true;
+  }
+
+  // Called over and over until end(); must block or delay, and return
+  // within a few ms so end() isn't kept waiting
+  virtual void poll() = 0;
+
+  SampleRing* ring = nullptr;
+  TaskHandle_t task = nullptr;
+
+private:
+  static void taskEntry(void* arg) {
+    TaskSampleSource* self = (TaskSampleSource*)arg;
+    while (!self->stopping.load(std::memory_order_acquire)) self->poll();
+    self->stopped.store(true, std::memory_order_release);
+    vTaskDelete(nullptr);
+  }
+
+  std::atomic<bool> stopping{false};
+  std::atomic<bool> stopped{false};
+};
+
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+// The ADC in continuous mode: its controller converts PIEZO_PIN at
+// SAMPLING_FREQ into DMA buffers on its own, and the acquisition task wakes
+// once per ADC_FRAME_SAMPLES (~16 ms) to move a whole frame into the ring.
+const uint32_t ADC_FRAME_SAMPLES = 128;
+const uint32_t ADC_POOL_FRAMES = 8;        // Held by the driver if the task falls behind
+const uint32_t ADC_READ_TIMEOUT_MS = 50;
+
+class AdcSource : public TaskSampleSource {
+public:
+  bool begin(SampleRing* r) override {
+    ring = r;
+    if (adc_continuous_io_to_channel(PIEZO_PIN, &unit, &channel) != ESP_OK || unit != ADC_UNIT_1) {
+      return false;
+    }
+    adc_continuous_handle_cfg_t cfg = {};
+    cfg.max_store_buf_size = ADC_POOL_FRAMES * sizeof(frame);
+    cfg.conv_frame_size = sizeof(frame);
+    if (adc_continuous_new_handle(&cfg, &adc) != ESP_OK) {
+      adc = nullptr;
+      return false;
     }
+    adc_digi_pattern_config_t pattern = {};
+    pattern.atten = ADC_ATTEN_DB_6;  // As analogSetAttenuation(ADC_6db)
+    pattern.channel = channel;
+    pattern.unit = unit;
+    pattern.bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+    adc_continuous_config_t conf = {};
+    conf.pattern_num = 1;
+    conf.adc_pattern = &pattern;
+    conf.sample_freq_hz = (uint32_t)SAMPLING_FREQ;
+    conf.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+    conf.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+    if (adc_continuous_config(adc, &conf) != ESP_OK || adc_continuous_start(adc) != ESP_OK ||
+        !startTask("acq", 3072, configMAX_PRIORITIES - 1)) {
+      end();
+      return false;
+    }
+    return true;
   }
 
-  if (bestLag > minLag && bestLag < maxLag) {
-    int32_t corrPrev = 0, corrCurr = maxCorr, corrNext = 0;
-    for (int i = 0; i < SAMPLES - bestLag - 1; i++) {
-      corrPrev += (int32_t)sampleBuffer[i] * sampleBuffer[i + bestLag - 1];
-      corrNext += (int32_t)sampleBuffer[i] * sampleBuffer[i + bestLag + 1];
+  void end() override {
+    TaskSampleSource::end();
+    if (adc) {
+      adc_continuous_stop(adc);
+      adc_continuous_deinit(adc);
+      adc = nullptr;
     }
+  }
 
-    float denom = 2.0f * (corrPrev - 2.0f * corrCurr + corrNext);
-    if (fabsf(denom) > 0.001f) {
-      float delta = (float)(corrPrev - corrNext) / denom;
-      delta = constrain(delta, -0.5f, 0.5f);
-      float refinedLag = bestLag + delta;
-      if (refinedLag > 0) {
-        detectedFreq = SAMPLING_FREQ / refinedLag;
+protected:
+  void poll() override {
+    uint32_t n = 0;
+    if (adc_continuous_read(adc, frame, sizeof(frame), &n, ADC_READ_TIMEOUT_MS) != ESP_OK) return;
+    for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= n; i += SOC_ADC_DIGI_RESULT_BYTES) {
+      adc_digi_output_data_t d;
+      memcpy(&d, frame + i, sizeof(d));
+      // A stray conversion or a misaligned frame is not a piezo sample
+      if (d.type2.unit != (uint32_t)unit || d.type2.channel != (uint32_t)channel) {
+        strays.fetch_add(1, std::memory_order_relaxed);
+        continue;
       }
+      int16_t raw = d.type2.data;
+      frameRecorder.sample(raw);
+      ring->push(raw);
     }
   }
 
-  if (detectedFreq < F_MIN || detectedFreq > F_MAX) {
-    return 0.0f;
+public:
+  // Results skipped for not being PIEZO_PIN's channel
+  uint32_t strayCount() const { return strays.load(std::memory_order_relaxed); }
+
+private:
+  uint8_t frame[ADC_FRAME_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES];
+  adc_continuous_handle_t adc = nullptr;
+  adc_unit_t unit = ADC_UNIT_1;
+  adc_channel_t channel = ADC_CHANNEL_0;
+  std::atomic<uint32_t> strays{0};
+};
+#else
+// Core 2.x has no continuous driver to build on: a hardware timer fires
+// every SAMPLE_PERIOD_US and wakes a high-priority task that does the
+// analogRead() (the ADC driver is not ISR-safe).
+class AdcSource : public TaskSampleSource {
+public:
+  bool begin(SampleRing* r) override {
+    ring = r;
+    active = this;
+    if (!startTask("acq", 2048, configMAX_PRIORITIES - 1)) return false;
+    timer = timerBegin(0, 80, true);
+    if (!timer) {
+      end();
+      return false;
+    }
+    timerAttachInterrupt(timer, onTimer, true);
+    timerAlarmWrite(timer, SAMPLE_PERIOD_US, true);
+    timerAlarmEnable(timer);
+    return true;
   }
 
-  return detectedFreq;
-}
+  void end() override {
+    if (timer) {
+      timerEnd(timer);  // First, so the ISR never notifies a task that has gone
+      timer = nullptr;
+    }
+    TaskSampleSource::end();
+  }
 
-// ===== UI HELPER FUNCTIONS =====
+protected:
+  void poll() override {
+    if (!ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10))) return;
+    int16_t raw = analogRead(PIEZO_PIN);
+    frameRecorder.sample(raw);
+    ring->push(raw);
+  }
 
-void drawCenteredText(const char* text, int y, int size, uint16_t color) {
-  tft.setTextSize(size);
-  tft.setTextColor(color);
-  int16_t x1, y1;
-  uint16_t w, h;
-  tft.getTextBounds(text, 0, 0, &x1, &y1, &w, &h);
-  tft.setCursor((320 - w) / 2, y);
-  tft.print(text);
-}
+private:
+  static void IRAM_ATTR onTimer() {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(active->task, &woken);
+    portYIELD_FROM_ISR(woken);
+  }
 
-void drawCentsMeter(int y, int cents) {
-  int meterWidth = 280;
-  int meterHeight = 40;
-  int x = (320 - meterWidth) / 2;
+  static AdcSource* active;
+  hw_timer_t* timer = nullptr;
+};
 
-  tft.fillRoundRect(x, y, meterWidth, meterHeight, 6, COLOR_CARD);
+AdcSource* AdcSource::active = nullptr;
+#endif
 
-  int centerX = x + meterWidth / 2;
-  tft.drawFastVLine(centerX, y + 8, meterHeight - 16, COLOR_TEXT_DIM);
+// Plucked-string stand-in (syntheticSample()), paced off micros() so the
+// ring fills at the real sample rate.
+class SyntheticSource : public TaskSampleSource {
+public:
+  float freq = 110.0f;
 
-  int tolerancePixels = map(TUNE_TOLERANCE, 0, 50, 0, meterWidth / 2);
-  tft.fillRect(centerX - tolerancePixels, y + 4, tolerancePixels * 2, meterHeight - 8, 0x0320);
+  bool begin(SampleRing* r) override {
+    ring = r;
+    start = micros();
+    produced = 0;
+    return startTask("synth", 2048, 5);
+  }
 
-  int c = constrain(cents, -50, 50);
-  int indicatorX = centerX + map(c, -50, 50, -meterWidth/2 + 15, meterWidth/2 - 15);
+  int16_t sampleAt(uint32_t n) const {
+    return syntheticSample(freq, n);
+  }
 
-  uint16_t color = COLOR_SUCCESS;
-  if (abs(cents) > TUNE_TOLERANCE && abs(cents) <= 15) color = COLOR_WARNING;
-  else if (abs(cents) > 15) color = COLOR_DANGER;
+protected:
+  void poll() override {
+    uint32_t due = (uint32_t)((micros() - start) / SAMPLE_PERIOD_US);
+    while (produced < due) ring->push(sampleAt(produced++));
+    vTaskDelay(1);
+  }
 
-  tft.fillCircle(indicatorX, y + meterHeight/2, 12, color);
-  tft.drawCircle(indicatorX, y + meterHeight/2, 13, COLOR_TEXT);
-}
+private:
+  unsigned long start = 0;
+  uint32_t produced = 0;
+};
 
-void drawStringIndicator(int stringNum) {
-  int y = 45;
-  int boxWidth = 45;
-  int spacing = 5;
-  int totalWidth = 6 * boxWidth + 5 * spacing;
-  int startX = (320 - totalWidth) / 2;
+AdcSource adcSource;
+SyntheticSource syntheticSource;
+SampleSource* sampleSource = &adcSource;
 
-  for (int i = 0; i < 6; i++) {
-    int x = startX + i * (boxWidth + spacing);
-    bool isSelected = (stringNum == i);
+// ===== DSP TASK =====
 
-    if (isSelected) {
-      tft.fillRoundRect(x, y, boxWidth, 30, 4, COLOR_PRIMARY);
-      tft.setTextColor(COLOR_BG);
-    } else {
-      tft.fillRoundRect(x, y, boxWidth, 30, 4, COLOR_CARD);
-      tft.setTextColor(COLOR_TEXT_DIM);
-    }
+struct PitchResult {
+  float freq;            // Detector output, 0 = no pitch
+  float signalLevel;
+  int32_t lagQ15;        // Detector period in Q15 samples, 0 if not fixed-point
+  float expectedFreq;    // Target the detector was asked to use
+  unsigned long timeMs;
+};
 
-    tft.setTextSize(1);
-    int16_t x1, y1;
-    uint16_t w, h;
-    // Use note names from current tuning mode
-    tft.getTextBounds(tuningModes[tuningMode].noteNames[i], 0, 0, &x1, &y1, &w, &h);
-    tft.setCursor(x + (boxWidth - w) / 2, y + 10);
-    tft.print(tuningModes[tuningMode].noteNames[i]);
+// Single-writer seqlock: the DSP task publishes, loop() takes the latest
+// result without ever blocking the writer. The record is kept as atomic
+// words rather than a plain struct, so a read racing a publish is
+// a discarded torn copy and not a data race.
+class PitchMailbox {
+public:
+  void publish(const PitchResult &r) {
+    uint32_t w[WORDS];
+    memcpy(w, &r, sizeof(r));
+    uint32_t s = seq.load(std::memory_order_relaxed);
+    seq.store(s + 1, std::memory_order_relaxed);  // Odd: write in progress
+    // Release stores keep the odd count ahead of the words
+    for (int i = 0; i < WORDS; i++) data[i].store(w[i], std::memory_order_release);
+    seq.store(s + 2, std::memory_order_release);
   }
-}
 
-// ===== UI SCREENS =====
+  // True if a result newer than lastSeq was read
+  bool read(PitchResult &out, uint32_t &lastSeq) const {
+    while (true) {
+      uint32_t s0 = seq.load(std::memory_order_acquire);
+      if (s0 == lastSeq) return false;
+      if (s0 & 1) continue;
+      uint32_t w[WORDS];
+      // Acquire loads keep the words ahead of the re-check; a word from a
+      // newer publish then also shows the odd count
+      for (int i = 0; i < WORDS; i++) w[i] = data[i].load(std::memory_order_acquire);
+      if (seq.load(std::memory_order_relaxed) == s0) {
+        memcpy(&out, w, sizeof(out));
+        lastSeq = s0;
+        return true;
+      }
+    }
+  }
 
-void drawStandbyScreen() {
-  tft.fillScreen(COLOR_BG);
+private:
+  static_assert(sizeof(PitchResult) % sizeof(uint32_t) == 0, "PitchResult must be whole words");
+  static const int WORDS = sizeof(PitchResult) / sizeof(uint32_t);
+  std::atomic<uint32_t> data[WORDS] = {};
+  std::atomic<uint32_t> seq{0};
+};
 
-  drawCenteredText("GUITAR TUNER", 30, 3, COLOR_PRIMARY);
+// detectPitch() plus the debug trace the detector can't log itself. Runs on
+// the DSP task, so the trace takes that frame's level, not loop()'s.
+float detectPitchLogged(float expectedFreq) {
+  float freq = detectPitch(expectedFreq);
+  if (detectedSubharmonic && pitchDebugLog) TRACE_AT(TRACE_SUBHARMONIC, freq, 0, signalLevel);
+  return freq;
+}
 
-  tft.fillRoundRect(20, 80, 280, 50, 8, COLOR_CARD);
-  tft.setTextSize(1);
-  tft.setTextColor(COLOR_TEXT_DIM);
-  tft.setCursor(30, 90);
-  tft.print("MODE");
-  tft.setTextSize(2);
-  tft.setTextColor(COLOR_TEXT);
-  tft.setCursor(30, 105);
-  tft.print(tuningModes[tuningMode].name);
+PitchMailbox pitchMailbox;
+uint32_t lastPitchSeq = 0;
+std::atomic<float> dspExpectedFreq{-1.0f};
+std::atomic<bool> dspRunning{false};
+std::atomic<bool> dspIdle{true};  // Set while the task holds no frame
+TaskHandle_t dspTaskHandle = nullptr;
+
+// One pass of the DSP task: capture, detect, publish. False if no new hop
+// was ready. Everything loop() needs from the frame goes through the
+// mailbox; detectPitch()'s globals stay on this side.
+bool dspFrame() {
+  if (!captureSamples()) return false;
+  PitchResult r;
+  r.expectedFreq = dspExpectedFreq.load();
+  r.freq = detectPitchLogged(r.expectedFreq);
+  r.lagQ15 = detectedLagQ15;
+  r.signalLevel = signalLevel;
+  r.timeMs = millis();
+  pitchMailbox.publish(r);
+  return true;
+}
 
-  tft.setTextSize(1);
-  tft.setTextColor(COLOR_TEXT_DIM);
-  tft.setCursor(180, 90);
-  tft.print("STRING");
-  tft.setTextSize(2);
-  tft.setTextColor(COLOR_PRIMARY);
-  tft.setCursor(180, 105);
-  if (isAutoMode) tft.print("AUTO");
-  else tft.print(tuningModes[tuningMode].noteNames[selectedString]);
+void dspTask(void* arg) {
+  while (true) {
+    dspIdle.store(false);
+    if (!dspRunning.load() || !dspFrame()) {
+      dspIdle.store(true);
+      vTaskDelay(1);
+    }
+  }
+}
 
-  tft.fillRoundRect(20, 150, 280, 70, 8, COLOR_CARD);
-  tft.setTextSize(1);
-  tft.setTextColor(COLOR_TEXT);
-  tft.setCursor(35, 165);
-  tft.print("TOGGLE: Start Tuning");
-  tft.setCursor(35, 180);
-  tft.print("SELECT: Choose String");
-  tft.setTextColor(COLOR_TEXT_DIM);
-  tft.setCursor(35, 200);
-  tft.print("Long press for more options");
+bool startDspTask() {
+#if DSP_DUAL_CORE
+  return xTaskCreatePinnedToCore(dspTask, "dsp", 4096, nullptr, 2, &dspTaskHandle, 0) == pdPASS;
+#else
+  return true;
+#endif
 }
 
-void drawTuningScreen() {
-  tft.fillScreen(COLOR_BG);
+// Gets the next pitch estimate for expectedFreq, false if none is ready yet.
+// lagQ15 is the matching period for lagToNote(), 0 if there is none; level
+// is the frame's signal level.
+bool fetchPitch(float expectedFreq, float &freq, int32_t &lagQ15, float &level) {
+#if DSP_DUAL_CORE
+  if (offlineRunActive) {
+    // The task is paused; offline runs detect inline on the caller's ring
+    if (!captureSamples()) return false;
+    freq = detectPitchLogged(expectedFreq);
+    lagQ15 = detectedLagQ15;
+    level = signalLevel;
+    return true;
+  }
+  dspExpectedFreq.store(expectedFreq);
+  dspRunning.store(true);
+  PitchResult r;
+  if (!pitchMailbox.read(r, lastPitchSeq)) return false;
+  if (r.expectedFreq != expectedFreq) return false;  // Computed for an old target
+  freq = r.freq;
+  lagQ15 = r.lagQ15;
+  level = r.signalLevel;
+  return true;
+#else
+  if (!captureSamples()) return false;
+  freq = detectPitchLogged(expectedFreq);
+  lagQ15 = detectedLagQ15;
+  level = signalLevel;
+  return true;
+#endif
+}
 
-  tft.setTextSize(1);
-  tft.setTextColor(COLOR_TEXT_DIM);
-  tft.setCursor(10, 10);
-  tft.print(tuningModes[tuningMode].name);
+void stopPitchTask() {
+  dspRunning.store(false);
+}
 
-  tft.setTextColor(COLOR_SUCCESS);
-  tft.setCursor(260, 10);
-  tft.print("TUNING");
+// Like stopPitchTask(), but also waits for a frame in flight to finish
+void pausePitchTask() {
+  stopPitchTask();
+#if DSP_DUAL_CORE
+  while (!dspIdle.load()) delay(1);
+#endif
+}
 
-  drawStringIndicator(-1);
+// ===== PITCH TRACKER =====
+
+// State is log-frequency in cents re A4 and its drift in cents/s, with
+// covariance [p00 p01; p01 p11]. Confidence is R / (R + p00): about 0.5 after
+// the first frame, approaching 1 as frames agree and decaying between them.
+//
+// A known pitch step (a servo move) is a control input: it unfolds as
+// stepCents * (1 - exp(-(t - stepAt) / stepTauMs)), the prediction follows
+// it, and frames taken early in it count for less.
+//
+// Frames come in as Hz (trackerUpdate, the float path) or as Q15 periods
+// (trackerUpdateLag, the fixed-point path). A period's cents re A4 is
+// A4_PERIOD_Q8 minus its log from the lag tables, and trackerPeriodQ8()
+// gives the estimate back in that form, so the fixed path never goes
+// through Hz. The filter arithmetic itself is float either way.
+struct PitchTrackerState {
+  bool active;
+  float cents, rate;
+  float p00, p01, p11;
+  float confidence;
+  unsigned long lastPredict, lastAccept;
+  float recent[TRACK_MEDIAN_LEN];
+  int recentCount, recentNext;
+  unsigned long stepAt;
+  float stepCents, stepTauMs;
+};
+
+PitchTrackerState tracker = {};
+
+void trackerReset(PitchTrackerState &t = tracker) {
+  t = PitchTrackerState();
 }
 
-void updateTuningDisplay(float freq, const String& note, int cents, int stringNum) {
-  drawStringIndicator(stringNum);
+// Fraction of the expected step still to come at 'now'
+float trackerStepLeft(const PitchTrackerState &t, unsigned long now) {
+  if (t.stepCents == 0.0f) return 0.0f;
+  return expf(-(float)(now - t.stepAt) / t.stepTauMs);
+}
 
-  tft.fillRect(20, 85, 280, 75, COLOR_BG);
+// Cents of the expected step still to come at 'now'
+float trackerStepRemaining(const PitchTrackerState &t, unsigned long now) {
+  return t.stepCents * trackerStepLeft(t, now);
+}
 
-  if (freq > 0) {
-    tft.setTextSize(5);
-    tft.setTextColor(COLOR_TEXT);
-    int16_t x1, y1;
-    uint16_t w, h;
-    tft.getTextBounds(note.c_str(), 0, 0, &x1, &y1, &w, &h);
-    tft.setCursor((320 - w) / 2, 90);
-    tft.print(note);
+// Tells the tracker the pitch is about to move by 'cents' with time constant
+// tauMs. What is left of an earlier step carries over into this one.
+void trackerExpectStep(float cents, unsigned long now, float tauMs) {
+  tracker.stepCents = cents + trackerStepRemaining(tracker, now);
+  tracker.stepAt = now;
+  tracker.stepTauMs = tauMs;
+}
 
-    tft.setTextSize(2);
-    tft.setTextColor(COLOR_TEXT_DIM);
-    char freqStr[16];
-    sprintf(freqStr, "%d Hz", (int)freq);
-    tft.getTextBounds(freqStr, 0, 0, &x1, &y1, &w, &h);
-    tft.setCursor((320 - w) / 2, 140);
-    tft.print(freqStr);
-  } else {
-    tft.setTextSize(4);
-    tft.setTextColor(COLOR_TEXT_DIM);
-    int16_t x1, y1;
-    uint16_t w, h;
-    tft.getTextBounds("---", 0, 0, &x1, &y1, &w, &h);
-    tft.setCursor((320 - w) / 2, 100);
-    tft.print("---");
+float trackerMedian(const PitchTrackerState &t) {
+  float v[TRACK_MEDIAN_LEN];
+  int n = t.recentCount;
+  for (int i = 0; i < n; i++) {
+    float x = t.recent[i];
+    int j = i;
+    for (; j > 0 && v[j - 1] > x; j--) v[j] = v[j - 1];
+    v[j] = x;
   }
+  return v[n / 2];
+}
+
+void trackerStart(PitchTrackerState &t, float z, unsigned long now) {
+  t.active = true;
+  t.cents = z;
+  t.rate = 0.0f;
+  t.p00 = TRACK_MEAS_CENTS * TRACK_MEAS_CENTS;
+  t.p01 = 0.0f;
+  t.p11 = TRACK_RATE_CENTS * TRACK_RATE_CENTS;
+  t.lastPredict = now;
+  t.lastAccept = now;
+}
 
-  drawCentsMeter(175, cents);
+// One frame in cents re A4, 'hasPitch' false when nothing was detected
+bool trackerUpdateCents(PitchTrackerState &t, bool hasPitch, float z, unsigned long now) {
+  const float R = TRACK_MEAS_CENTS * TRACK_MEAS_CENTS;
+
+  if (t.active) {
+    // Predict: x += rate * dt + the part of an expected step played out since,
+    // P = F P F' + Q
+    float dt = (now - t.lastPredict) / 1000.0f;
+    float q = TRACK_ACCEL * dt;
+    float stepped = trackerStepRemaining(t, t.lastPredict) - trackerStepRemaining(t, now);
+    float stepVar = TRACK_STEP_SPREAD * stepped;
+    t.cents += t.rate * dt + stepped;
+    // Carry the outlier history along so it doesn't reject the new pitch
+    for (int i = 0; i < t.recentCount; i++) t.recent[i] += stepped;
+    t.p00 += dt * (2.0f * t.p01 + dt * t.p11) + q * dt * dt / 3.0f + stepVar * stepVar;
+    t.p01 += dt * t.p11 + q * dt / 2.0f;
+    t.p11 += q;
+    t.lastPredict = now;
+  }
 
-  tft.fillRect(0, 220, 320, 20, COLOR_BG);
+  if (hasPitch) {
+    t.recent[t.recentNext] = z;
+    t.recentNext = (t.recentNext + 1) % TRACK_MEDIAN_LEN;
+    if (t.recentCount < TRACK_MEDIAN_LEN) t.recentCount++;
 
-  if (servoLimitReached && waitingForConfirm) {
-    // Show limit warning overlay
-    tft.fillRect(20, 85, 280, 75, COLOR_DANGER);
-    if (!servoReturningToCenter) {
-      // Step 1: Just hit limit
-      drawCenteredText("SERVO LIMIT!", 95, 2, COLOR_TEXT);
-      if (needsTightenRoom) {
-        drawCenteredText("Need more room to TIGHTEN", 120, 1, COLOR_TEXT);
+    bool outlier = t.recentCount >= 3 && fabsf(z - trackerMedian(t)) > TRACK_OUTLIER_CENTS;
+    if (!outlier) {
+      float y = z - t.cents;
+      if (!t.active || fabsf(y) > TRACK_RESET_CENTS) {
+        trackerStart(t, z, now);
       } else {
-        drawCenteredText("Need more room to LOOSEN", 120, 1, COLOR_TEXT);
+        float S = t.p00 + R * (1.0f + TRACK_TRANSIENT_NOISE * trackerStepLeft(t, now));
+        float k0 = t.p00 / S;
+        float k1 = t.p01 / S;
+        t.cents += k0 * y;
+        t.rate += k1 * y;
+        t.p11 -= k1 * t.p01;
+        t.p01 -= k0 * t.p01;
+        t.p00 -= k0 * t.p00;
+        t.lastAccept = now;
       }
-      drawCenteredText("Press SELECT to reposition", 222, 2, COLOR_WARNING);
-    } else {
-      // Step 2: Servo at center, waiting to resume
-      drawCenteredText("REPOSITION MOTOR", 95, 2, COLOR_TEXT);
-      drawCenteredText("Motor at center position", 120, 1, COLOR_TEXT);
-      drawCenteredText("Press SELECT to resume", 222, 2, COLOR_WARNING);
     }
-  } else if (waitingForConfirm) {
-    drawCenteredText("Press SELECT to start", 222, 2, COLOR_WARNING);
-  } else if (freq <= 0) {
-    drawCenteredText("Play a string", 222, 2, COLOR_TEXT_DIM);
-  } else if (abs(cents) <= TUNE_TOLERANCE) {
-    drawCenteredText("IN TUNE", 222, 2, COLOR_SUCCESS);
-  } else {
-    char statusStr[20];
-    sprintf(statusStr, "%s%d cents", cents > 0 ? "+" : "", cents);
-    uint16_t color = abs(cents) > 15 ? COLOR_DANGER : COLOR_WARNING;
-    drawCenteredText(statusStr, 222, 2, color);
   }
+
+  if (t.active && now - t.lastAccept > TRACK_TIMEOUT_MS) {
+    t.active = false;
+  }
+  t.confidence = t.active ? R / (R + t.p00) : 0.0f;
+  return t.active;
 }
 
-void drawAutoTuneAllScreen() {
-  tft.fillScreen(COLOR_BG);
+// Feeds one detector frame (freq 0 = nothing detected) taken at 'now'.
+// Returns true while there is a track; trackerFreq() is then the estimate.
+bool trackerUpdate(float freq, unsigned long now, PitchTrackerState &t = tracker) {
+  float z = freq > 0.0f ? 1200.0f * log2f(freq / 440.0f) : 0.0f;
+  return trackerUpdateCents(t, freq > 0.0f, z, now);
+}
 
-  drawCenteredText("AUTO TUNE", 20, 3, COLOR_PRIMARY);
-  
-  // Show tuning mode name
-  tft.setTextSize(1);
-  tft.setTextColor(COLOR_TEXT_DIM);
-  tft.setCursor(10, 50);
-  tft.print(tuningModes[tuningMode].name);
+// trackerUpdate() from the detector's Q15 period (0 = nothing detected);
+// trackerPeriodQ8() is then the estimate
+bool trackerUpdateLag(int32_t lagQ15, unsigned long now, PitchTrackerState &t = tracker) {
+  float z = lagQ15 > 0 ? (A4_PERIOD_Q8 - periodQ8FromLagQ15(lagQ15)) / 256.0f : 0.0f;
+  return trackerUpdateCents(t, lagQ15 > 0, z, now);
+}
 
-  // Draw string boxes
-  int boxSize = 40;
-  int spacing = 10;
-  int totalWidth = 6 * boxSize + 5 * spacing;
-  int startX = (320 - totalWidth) / 2;
-  int y = 70;
+float trackerFreq(const PitchTrackerState &t = tracker) {
+  return 440.0f * exp2f(t.cents / 1200.0f);
+}
 
-  for (int i = 0; i < 6; i++) {
-    int x = startX + i * (boxSize + spacing);
+// The estimate as 1200*log2(period) in Q8, for periodToNote()
+int32_t trackerPeriodQ8(const PitchTrackerState &t = tracker) {
+  return A4_PERIOD_Q8 - (int32_t)lroundf(t.cents * 256.0f);
+}
 
-    uint16_t bgColor = COLOR_CARD;
-    uint16_t textColor = COLOR_TEXT_DIM;
+// ===== POLYPHONIC CHECK =====
+// All six strings from one strum. After an onset the next POLY_SAMPLES (1 s)
+// go through a Hann-windowed real FFT with 1 Hz bins. For each string of the
+// current tuning the harmonic sum S(f) = sum |X(h f)| / h, h = 1..POLY_HARMONICS,
+// is scanned over +-POLY_RANGE_CENTS of the target in 1-cent steps. Its peak
+// picks out the string's partials, and their interpolated bin frequencies,
+// divided by h, give the cents. Partials within POLY_CLASH_BINS of another
+// string's partial are left out of that average when any others are left.
+//
+// Strings sharing partials (octaves, E2's 3rd harmonic and B3, ...) would
+// otherwise claim each other's peaks, so strings are resolved low to high: a
+// string's sum skips harmonics within POLY_SHARED_CENTS of a higher string's
+// target partials, and once it is placed its upper partials are cleared from
+// the working spectrum the higher strings are searched in.
+// The ~80 KB of buffers come from PSRAM when there is any, on first use.
+const int POLY_SAMPLES = 8192;
+const int POLY_HALF = POLY_SAMPLES / 2;
+const uint32_t POLY_SKIP = (uint32_t)(SAMPLING_FREQ / 20);  // Past the pick attack
+const int POLY_HARMONICS = 6;
+const int POLY_RANGE_CENTS = 100;
+const float POLY_CLASH_BINS = 2.0f;
+const float POLY_SHARED_CENTS = 60.0f;
+const float POLY_PRESENT_RATIO = 6.0f;   // Fundamental vs the median bin of the guitar band
+const float POLY_PRESENT_FRACTION = 0.1f;  // Fundamental vs the strongest string's
+const float POLY_BIN_HZ = SAMPLING_FREQ / POLY_SAMPLES;
+
+struct PolyResult {
+  bool present[6];
+  bool inTune[6];
+  float cents[6];
+  unsigned long analysisUs;
+};
 
-    if (i < autoTuneCurrentString) {
-      bgColor = COLOR_SUCCESS;
-      textColor = COLOR_BG;
-    } else if (i == autoTuneCurrentString) {
-      bgColor = COLOR_WARNING;
-      textColor = COLOR_BG;
-    }
+enum PolyState {
+  POLY_IDLE,
+  POLY_ARMED,      // Waiting for an onset
+  POLY_CAPTURING
+};
 
-    tft.fillRoundRect(x, y, boxSize, boxSize, 6, bgColor);
-    tft.setTextSize(1);
-    tft.setTextColor(textColor);
-    int16_t x1, y1;
-    uint16_t w, h;
-    tft.getTextBounds(tuningModes[tuningMode].noteNames[i], 0, 0, &x1, &y1, &w, &h);
-    tft.setCursor(x + (boxSize - w) / 2, y + (boxSize - h) / 2);
-    tft.print(tuningModes[tuningMode].noteNames[i]);
+PolyResult polyResult = {};
+bool polyResultValid = false;
+int polyState = POLY_IDLE;
+bool polyRequested = false;  // Armed by the serial command rather than auto-tune
+uint32_t polyOnsetsSeen = 0;
+uint32_t polyStart = 0;   // Ring index of the first captured sample
+uint32_t polyFill = 0;
+float *polyRe = nullptr, *polyIm = nullptr;  // POLY_HALF each: packed samples, then the FFT
+float *polyCos, *polySin;                    // POLY_HALF each: cos/sin(2*pi*k / POLY_SAMPLES)
+float *polyMag;                              // POLY_HALF + 1 bins of |X[k]|
+
+void* polyAlloc(size_t bytes) {
+  return psramFound() ? ps_malloc(bytes) : malloc(bytes);
+}
+
+bool initPolyBuffers() {
+  if (polyRe) return true;
+  float* bufs[5];
+  for (int i = 0; i < 5; i++) {
+    bufs[i] = (float*)polyAlloc((POLY_HALF + (i == 4)) * sizeof(float));
+    if (!bufs[i]) {
+      while (i--) free(bufs[i]);
+      return false;
+    }
+  }
+  polyRe = bufs[0];
+  polyIm = bufs[1];
+  polyCos = bufs[2];
+  polySin = bufs[3];
+  polyMag = bufs[4];
+  for (int k = 0; k < POLY_HALF; k++) {
+    double a = 2.0 * M_PI * k / POLY_SAMPLES;
+    polyCos[k] = (float)cos(a);
+    polySin[k] = (float)sin(a);
   }
+  return true;
+}
 
-  // Show current note being tuned
-  if (autoTuneCurrentString < 6) {
-    tft.setTextSize(4);
-    tft.setTextColor(COLOR_WARNING);
-    const char* noteName = tuningModes[tuningMode].noteNames[autoTuneCurrentString];
-    tft.setCursor(80, 135);
-    tft.print(noteName);
-    
-    tft.setTextSize(2);
-    tft.setTextColor(COLOR_TEXT_DIM);
-    tft.setCursor(180, 145);
-    tft.print((int)tuningModes[tuningMode].freqs[autoTuneCurrentString]);
-    tft.print(" Hz");
-  }
+// Captures and analyses the next strum; polyStep() does the work
+bool polyArm() {
+  if (!initPolyBuffers()) return false;
+  polyOnsetsSeen = sampleRing.onsetCount();
+  polyState = POLY_ARMED;
+  return true;
+}
 
-  drawCentsMeter(210, 0);
+// |X| at hz from a POLY_HALF-bin spectrum, linearly interpolated between bins
+float polyMagAt(const float* mag, float hz) {
+  float bin = hz / POLY_BIN_HZ;
+  int k = (int)bin;
+  if (k >= POLY_HALF - 1) return 0.0f;
+  float t = bin - k;
+  return mag[k] + t * (mag[k + 1] - mag[k]);
 }
 
-void updateAutoTuneDisplay(float freq, int cents) {
-  // Redraw string boxes to show current string highlighted
-  int boxSize = 40;
-  int spacing = 10;
-  int totalWidth = 6 * boxSize + 5 * spacing;
-  int startX = (320 - totalWidth) / 2;
-  int y = 70;
+// Harmonic sum over the harmonics whose bit is set in 'use' (bit h = harmonic h)
+float polySalience(const float* mag, float f0, uint32_t use) {
+  float sum = 0.0f;
+  for (int h = 1; h <= POLY_HARMONICS; h++) {
+    if (use & (1u << h)) sum += polyMagAt(mag, h * f0) / h;
+  }
+  return sum;
+}
 
-  for (int i = 0; i < 6; i++) {
-    int x = startX + i * (boxSize + spacing);
+// Harmonics of string s that no higher string of the tuning shares
+uint32_t polyOwnHarmonics(const TuningDef &td, int s) {
+  const float shared = exp2f(POLY_SHARED_CENTS / 1200.0f) - 1.0f;
+  uint32_t use = 0;
+  for (int h = 1; h <= POLY_HARMONICS; h++) {
+    bool own = true;
+    for (int o = s + 1; o < 6 && own; o++) {
+      for (int g = 1; g <= POLY_HARMONICS && own; g++) {
+        own = fabsf(h * td.freqs[s] / (g * td.freqs[o]) - 1.0f) >= shared;
+      }
+    }
+    if (own) use |= 1u << h;
+  }
+  return use;  // Always has h = 1: a higher string has no partial that low
+}
 
-    uint16_t bgColor = COLOR_CARD;
-    uint16_t textColor = COLOR_TEXT_DIM;
+// True if hz is within POLY_CLASH_BINS of a partial of another heard string
+bool polyClashes(int s, float hz, const float* f0) {
+  for (int o = 0; o < 6; o++) {
+    if (o == s || !polyResult.present[o]) continue;
+    for (int h = 1; h <= POLY_HARMONICS; h++) {
+      if (fabsf(h * f0[o] - hz) < POLY_CLASH_BINS * POLY_BIN_HZ) return true;
+    }
+  }
+  return false;
+}
 
-    if (i < autoTuneCurrentString) {
-      bgColor = COLOR_SUCCESS;
-      textColor = COLOR_BG;
-    } else if (i == autoTuneCurrentString) {
-      bgColor = COLOR_WARNING;
-      textColor = COLOR_BG;
+void polyAnalyse() {
+  unsigned long t0 = halWallMicros();
+
+  // Hann window; cos(2*pi*i / N) for i >= N/2 is -cos of i - N/2
+  for (int m = 0; m < POLY_HALF; m++) {
+    int i = 2 * m;
+    float c0 = (i < POLY_HALF) ? polyCos[i] : -polyCos[i - POLY_HALF];
+    float c1 = (i + 1 < POLY_HALF) ? polyCos[i + 1] : -polyCos[i + 1 - POLY_HALF];
+    polyRe[m] *= 0.5f - 0.5f * c0;
+    polyIm[m] *= 0.5f - 0.5f * c1;
+  }
+  fftComplex(polyRe, polyIm, POLY_HALF, polyCos, polySin, false);
+  realFftPower(polyRe, polyIm, POLY_HALF, polyCos, polySin, polyMag);
+  for (int k = 0; k <= POLY_HALF; k++) polyMag[k] = sqrtf(polyMag[k]);
+
+  // Noise reference: median bin of the band the strings' partials occupy
+  // (polyRe is free again as scratch)
+  int lo = (int)(F_MIN / POLY_BIN_HZ);
+  int hi = min(POLY_HALF, (int)(POLY_HARMONICS * F_MAX / POLY_BIN_HZ));
+  int n = hi - lo;
+  memcpy(polyRe, polyMag + lo, n * sizeof(float));
+  std::nth_element(polyRe, polyRe + n / 2, polyRe + n);
+  float noise = polyRe[n / 2];
+
+  // Working spectrum for the salience search (polyRe again)
+  float* work = polyRe;
+  memcpy(work, polyMag, POLY_HALF * sizeof(float));
+
+  // Salience peak per string, low to high
+  const TuningDef &td = tuningModes[tuningMode];
+  const float centStep = exp2f(1.0f / 1200.0f);
+  float f0[6];
+  float fundamental[6];  // Peak at f0 after the lower strings' partials are cleared
+  float strongest = 0.0f;
+  for (int s = 0; s < 6; s++) {
+    uint32_t use = polyOwnHarmonics(td, s);
+    float f = td.freqs[s] * exp2f(-POLY_RANGE_CENTS / 1200.0f);
+    float bestSal = -1.0f;
+    f0[s] = td.freqs[s];
+    for (int c = -POLY_RANGE_CENTS; c <= POLY_RANGE_CENTS; c++, f *= centStep) {
+      float sal = polySalience(work, f, use);
+      if (sal > bestSal) {
+        bestSal = sal;
+        f0[s] = f;
+      }
+    }
+    int k1 = (int)lroundf(f0[s] / POLY_BIN_HZ);
+    fundamental[s] = max(work[k1], max(work[k1 - 1], work[k1 + 1]));
+    strongest = max(strongest, fundamental[s]);
+
+    for (int h = 2; h <= POLY_HARMONICS; h++) {
+      int k = (int)lroundf(h * f0[s] / POLY_BIN_HZ);
+      for (int j = max(k - 1, 0); j <= min(k + 1, POLY_HALF - 1); j++) {
+        work[j] = min(work[j], noise);
+      }
     }
+  }
 
-    tft.fillRoundRect(x, y, boxSize, boxSize, 6, bgColor);
-    tft.setTextSize(1);
-    tft.setTextColor(textColor);
-    int16_t x1, y1;
-    uint16_t w, h;
-    tft.getTextBounds(tuningModes[tuningMode].noteNames[i], 0, 0, &x1, &y1, &w, &h);
-    tft.setCursor(x + (boxSize - w) / 2, y + (boxSize - h) / 2);
-    tft.print(tuningModes[tuningMode].noteNames[i]);
+  // Heard = a fundamental of its own, not far below the strongest string's
+  for (int s = 0; s < 6; s++) {
+    polyResult.present[s] = fundamental[s] >= POLY_PRESENT_RATIO * noise &&
+                            fundamental[s] >= POLY_PRESENT_FRACTION * strongest;
   }
 
-  // Show current note being tuned in large text
-  tft.fillRect(40, 130, 240, 55, COLOR_BG);
-  if (autoTuneCurrentString < 6) {
-    // Large note name
-    tft.setTextSize(4);
-    tft.setTextColor(COLOR_WARNING);
-    int16_t x1, y1;
-    uint16_t w, h;
-    const char* noteName = tuningModes[tuningMode].noteNames[autoTuneCurrentString];
-    tft.getTextBounds(noteName, 0, 0, &x1, &y1, &w, &h);
-    tft.setCursor(80, 135);
-    tft.print(noteName);
-    
-    // Target frequency
-    tft.setTextSize(2);
-    tft.setTextColor(COLOR_TEXT_DIM);
-    tft.setCursor(180, 145);
-    tft.print((int)tuningModes[tuningMode].freqs[autoTuneCurrentString]);
-    tft.print(" Hz");
+  // Refine from the partials' own peaks, weighting each by |X| * h
+  // (a bin is h times finer in f0 at the h-th partial)
+  for (int s = 0; s < 6; s++) {
+    float num = 0.0f, den = 0.0f, numAll = 0.0f, denAll = 0.0f;
+    for (int h = 1; h <= POLY_HARMONICS; h++) {
+      float hz = h * f0[s];
+      int k = (int)lroundf(hz / POLY_BIN_HZ);
+      if (k < 2 || k > POLY_HALF - 2) continue;
+      if (polyMag[k - 1] > polyMag[k]) k--;
+      else if (polyMag[k + 1] > polyMag[k]) k++;
+      if (polyMag[k] < polyMag[k - 1] || polyMag[k] < polyMag[k + 1]) continue;
+      if (polyMag[k] < POLY_PRESENT_RATIO * noise) continue;
+
+      float a = logf(polyMag[k - 1] + 1e-6f);
+      float b = logf(polyMag[k]);
+      float c = logf(polyMag[k + 1] + 1e-6f);
+      float d = a - 2.0f * b + c;
+      float peakHz = (k + ((d < 0.0f) ? 0.5f * (a - c) / d : 0.0f)) * POLY_BIN_HZ;
+      float w = polyMag[k] * h;
+      numAll += w * peakHz / h;
+      denAll += w;
+      if (!polyClashes(s, hz, f0)) {
+        num += w * peakHz / h;
+        den += w;
+      }
+    }
+    float f = (den > 0.0f) ? num / den : (denAll > 0.0f) ? numAll / denAll : f0[s];
+    polyResult.cents[s] = 1200.0f * log2f(f / td.freqs[s]);
+    polyResult.inTune[s] = polyResult.present[s] && fabsf(polyResult.cents[s]) <= TUNE_TOLERANCE;
   }
 
-  tft.fillRect(0, 190, 320, 50, COLOR_BG);
-  drawCentsMeter(210, freq > 0 ? cents : 0);
+  polyResult.analysisUs = halWallMicros() - t0;
+  polyResultValid = true;
+}
 
-  if (servoLimitReached && waitingForConfirm) {
-    tft.fillRect(0, 130, 320, 60, COLOR_DANGER);
-    if (!servoReturningToCenter) {
-      drawCenteredText("SERVO LIMIT!", 135, 2, COLOR_TEXT);
-      if (needsTightenRoom) {
-        drawCenteredText("Need more room to TIGHTEN", 155, 1, COLOR_TEXT);
-      } else {
-        drawCenteredText("Need more room to LOOSEN", 155, 1, COLOR_TEXT);
-      }
-      drawCenteredText("Press SELECT to reposition", 192, 2, COLOR_WARNING);
-    } else {
-      drawCenteredText("REPOSITION MOTOR", 135, 2, COLOR_TEXT);
-      drawCenteredText("Motor at center position", 155, 1, COLOR_TEXT);
-      drawCenteredText("Press SELECT to resume", 192, 2, COLOR_WARNING);
+// Non-blocking, called from loop(): moves what has arrived since the last
+// call from the ring into the capture, and analyses it once full. True when
+// a new polyResult is ready.
+bool polyStep() {
+  if (polyState == POLY_ARMED) {
+    if (sampleRing.onsetCount() == polyOnsetsSeen) return false;
+    polyStart = sampleRing.onsetIndex() + POLY_SKIP;
+    polyFill = 0;
+    polyState = POLY_CAPTURING;
+  }
+  if (polyState != POLY_CAPTURING) return false;
+
+  uint32_t end = sampleRing.count();
+  int32_t avail = (int32_t)(end - (polyStart + polyFill));
+  if (avail > (int32_t)(RING_SIZE - SAMPLES)) {
+    // Fell behind the producer - wait for the next strum
+    polyOnsetsSeen = sampleRing.onsetCount();
+    polyState = POLY_ARMED;
+    return false;
+  }
+
+  int16_t chunk[FRAME_HOP];
+  while (avail > 0 && polyFill < (uint32_t)POLY_SAMPLES) {
+    int n = min(min(avail, (int32_t)FRAME_HOP), (int32_t)(POLY_SAMPLES - polyFill));
+    sampleRing.copyWindow(chunk, polyStart + polyFill + n, n);
+    for (int i = 0; i < n; i++) {
+      uint32_t j = polyFill + i;
+      ((j & 1) ? polyIm : polyRe)[j >> 1] = chunk[i];
     }
-  } else if (waitingForConfirm) {
-    drawCenteredText("Press SELECT to start", 192, 2, COLOR_WARNING);
-  } else if (freq > 0) {
-    char buf[32];
-    sprintf(buf, "%d Hz (%s%d)", (int)freq, cents > 0 ? "+" : "", cents);
-    drawCenteredText(buf, 192, 2, COLOR_TEXT);
-  } else {
-    drawCenteredText("Play string", 192, 2, COLOR_TEXT_DIM);
+    polyFill += n;
+    avail -= n;
   }
+  if (polyFill < (uint32_t)POLY_SAMPLES) return false;
+
+  polyAnalyse();
+  polyState = POLY_IDLE;
+  return true;
 }
 
-void drawStringSelectScreen() {
-  tft.fillScreen(COLOR_BG);
+void printPolyResult(Print &out) {
+  out.printf("{\"tuning\":\"%s\",\"analysis_us\":%lu,\"strings\":[",
+             tuningModes[tuningMode].name, polyResult.analysisUs);
+  for (int s = 0; s < 6; s++) {
+    out.printf("%s{\"string\":\"%s\",\"present\":%s,\"cents\":%.1f,\"in_tune\":%s}",
+               s ? "," : "", tuningModes[tuningMode].noteNames[s],
+               polyResult.present[s] ? "true" : "false", polyResult.cents[s],
+               polyResult.inTune[s] ? "true" : "false");
+  }
+  out.println("]}");
+}
 
-  drawCenteredText("SELECT STRING", 20, 2, COLOR_PRIMARY);
-  
-  // Show tuning mode name
-  tft.setTextSize(1);
-  tft.setTextColor(COLOR_TEXT_DIM);
-  tft.setCursor(10, 45);
-  tft.print(tuningModes[tuningMode].name);
+// ===== UI HELPER FUNCTIONS =====
 
-  int boxWidth = 90;
-  int boxHeight = 45;
-  int spacing = 15;
-  int startY = 60;
+void drawCenteredText(const char* text, int y, int size, uint16_t color) {
+  tft.setTextSize(size);
+  tft.setTextColor(color);
+  int16_t x1, y1;
+  uint16_t w, h;
+  tft.getTextBounds(text, 0, 0, &x1, &y1, &w, &h);
+  tft.setCursor((320 - w) / 2, y);
+  tft.print(text);
+}
 
-  bool autoSelected = isAutoMode;
-  tft.fillRoundRect(115, startY, 90, 35, 6, autoSelected ? COLOR_PRIMARY : COLOR_CARD);
-  tft.setTextSize(2);
-  tft.setTextColor(autoSelected ? COLOR_BG : COLOR_TEXT);
-  tft.setCursor(135, startY + 10);
-  tft.print("AUTO");
+// ===== OFF-SCREEN CANVAS =====
+// With UI_CANVAS the meter, note/frequency block and status line are composed
+// in RAM (PSRAM when present) and pushed as one windowed SPI transfer, so the
+// panel never shows a half-erased widget. If a canvas can't be allocated that
+// widget falls back to drawing straight to the panel.
+#ifndef UI_CANVAS
+#define UI_CANVAS 1
+#endif
+
+struct CanvasRegion {
+  GFXcanvas16* canvas;  // nullptr = draw directly to tft
+  int16_t x, y;         // Screen position of the canvas origin
+};
 
-  startY = 110;
-  for (int i = 0; i < 6; i++) {
-    int col = i % 3;
-    int row = i / 3;
-    int x = 25 + col * (boxWidth + spacing);
-    int y = startY + row * (boxHeight + spacing);
+CanvasRegion meterRegion = {nullptr, 0, 0};
+CanvasRegion noteRegion = {nullptr, 20, 85};
+CanvasRegion statusRegion = {nullptr, 0, 0};
+
+GFXcanvas16* allocCanvas(uint16_t w, uint16_t h) {
+#if UI_CANVAS
+  GFXcanvas16* c = new GFXcanvas16(w, h);
+  if (c && c->getBuffer()) return c;
+  delete c;
+#endif
+  return nullptr;
+}
 
-    bool selected = (!isAutoMode && selectedString == i);
+void initCanvases() {
+  meterRegion.canvas = allocCanvas(280, 40);
+  noteRegion.canvas = allocCanvas(280, 75);
+  statusRegion.canvas = allocCanvas(320, 20);
+}
 
-    tft.fillRoundRect(x, y, boxWidth, boxHeight, 6, selected ? COLOR_PRIMARY : COLOR_CARD);
+Adafruit_GFX& regionTarget(const CanvasRegion* r) {
+  if (r && r->canvas) return *r->canvas;
+  return tft;
+}
 
-    tft.setTextSize(2);
-    tft.setTextColor(selected ? COLOR_BG : COLOR_TEXT);
-    tft.setCursor(x + 20, y + 8);
-    // Use note names from current tuning mode
-    tft.print(tuningModes[tuningMode].noteNames[i]);
+// Offset to subtract from screen coordinates when drawing into the region
+int16_t regionOX(const CanvasRegion* r) { return (r && r->canvas) ? r->x : 0; }
+int16_t regionOY(const CanvasRegion* r) { return (r && r->canvas) ? r->y : 0; }
 
-    tft.setTextSize(1);
-    tft.setTextColor(selected ? COLOR_BG : COLOR_TEXT_DIM);
-    tft.setCursor(x + 20, y + 30);
-    tft.print((int)tuningModes[tuningMode].freqs[i]);
-    tft.print(" Hz");
+void clearRegion(CanvasRegion &r) {
+  if (r.canvas) r.canvas->fillScreen(COLOR_BG);
+}
+
+// Pushes the screen rect (x, y, w, h) of a region's canvas in one address
+// window, as a single transfer when it spans whole canvas rows. Plain
+// drawing has already hit the panel, so this is a no-op then.
+void flushRegion(const CanvasRegion &r, int x, int y, int w, int h) {
+  if (!r.canvas) return;
+  int cw = r.canvas->width();
+  int ch = r.canvas->height();
+  int x0 = max(x, (int)r.x), y0 = max(y, (int)r.y);
+  int x1 = min(x + w, r.x + cw), y1 = min(y + h, r.y + ch);
+  if (x1 <= x0 || y1 <= y0) return;
+
+  uint16_t* buf = r.canvas->getBuffer();
+  tft.startWrite();
+  tft.setAddrWindow(x0, y0, x1 - x0, y1 - y0);
+  if (x1 - x0 == cw) {
+    tft.writePixels(buf + (y0 - r.y) * cw, (uint32_t)cw * (y1 - y0));
+  } else {
+    for (int row = y0; row < y1; row++) {
+      tft.writePixels(buf + (row - r.y) * cw + (x0 - r.x), x1 - x0);
+    }
   }
+  tft.endWrite();
+}
 
-  tft.setTextSize(1);
-  tft.setTextColor(COLOR_TEXT_DIM);
-  tft.setCursor(60, 225);
-  tft.print("SELECT: cycle  |  TOGGLE: confirm");
+// Writes a canvas as a binary PPM (P6) so screens can be captured over serial
+void dumpCanvasPPM(GFXcanvas16* c, Print &out) {
+  out.printf("P6\n%d %d\n255\n", c->width(), c->height());
+  uint16_t* buf = c->getBuffer();
+  for (int i = 0; i < c->width() * c->height(); i++) {
+    uint16_t v = buf[i];
+    uint8_t rgb[3] = {
+      (uint8_t)(((v >> 11) & 0x1F) * 255 / 31),
+      (uint8_t)(((v >> 5) & 0x3F) * 255 / 63),
+      (uint8_t)((v & 0x1F) * 255 / 31)
+    };
+    out.write(rgb, 3);
+  }
 }
 
-void drawModeSelectScreen() {
-  tft.fillScreen(COLOR_BG);
+// ===== RETAINED UI STATE =====
+// The tuning and auto-tune screens keep the last-drawn state of every
+// changing widget and only push the regions that differ. Full-screen draws
+// call uiInvalidate() so the next update starts from scratch.
 
-  drawCenteredText("TUNING MODE", 20, 2, COLOR_PRIMARY);
+struct TextWidget {
+  char text[32];
+  uint8_t size;
+  uint16_t color;
+  int16_t x, y;
+  uint16_t w, h;
+  bool drawn;
+  CanvasRegion* region;
+};
 
-  int boxHeight = 40;
-  int spacing = 10;
-  int startY = 60;
+struct UiState {
+  int stringNum;      // Highlighted string box, -2 = boxes not drawn
+  int overlay;        // Limit warning overlay, see limitOverlayState()
+  bool meterDrawn;
+  int meterY;
+  int needleX;
+  uint16_t needleColor;
+};
 
-  for (int i = 0; i < 4; i++) {
-    int y = startY + i * (boxHeight + spacing);
-    bool selected = (tuningMode == i);
+UiState ui;
+TextWidget uiNote = {"", 0, 0, 0, 0, 0, 0, false, &noteRegion};
+TextWidget uiFreq = {"", 0, 0, 0, 0, 0, 0, false, &noteRegion};
+TextWidget uiStatus = {"", 0, 0, 0, 0, 0, 0, false, &statusRegion};
+uint32_t uiPixelsPushed = 0;  // Pixels the last display update sent to the panel
+
+void uiInvalidate() {
+  ui.stringNum = -2;
+  ui.overlay = 0;
+  ui.meterDrawn = false;
+  uiNote.drawn = false;
+  uiFreq.drawn = false;
+  uiStatus.drawn = false;
+  clearRegion(noteRegion);
+  clearRegion(statusRegion);
+}
 
-    tft.fillRoundRect(30, y, 260, boxHeight, 6, selected ? COLOR_PRIMARY : COLOR_CARD);
+// Centered text that only repaints when its content changes; the previous
+// text's bounding box is cleared rather than the whole line
+void updateCenteredText(TextWidget &tw, const char* text, int y, int size, uint16_t color) {
+  if (tw.drawn && tw.y == y && tw.size == size && tw.color == color &&
+      strcmp(tw.text, text) == 0) {
+    return;
+  }
 
-    tft.setTextSize(2);
-    tft.setTextColor(selected ? COLOR_BG : COLOR_TEXT);
-    tft.setCursor(50, y + 12);
-    tft.print(tuningModes[i].name);
+  Adafruit_GFX& g = regionTarget(tw.region);
+  int16_t ox = regionOX(tw.region), oy = regionOY(tw.region);
+  bool hadOld = tw.drawn && tw.w > 0;
+  int16_t oldX = tw.x, oldY = tw.y;
+  uint16_t oldW = tw.w, oldH = tw.h;
+
+  if (hadOld) {
+    g.fillRect(oldX - ox, oldY - oy, oldW, oldH, COLOR_BG);
   }
 
-  tft.setTextSize(1);
-  tft.setTextColor(COLOR_TEXT_DIM);
-  tft.setCursor(60, 225);
-  tft.print("SELECT: cycle  |  TOGGLE: confirm");
-}
+  int16_t x1, y1;
+  uint16_t w = 0, h = 0;
+  if (text[0]) {
+    g.setTextSize(size);
+    g.setTextColor(color);
+    g.getTextBounds(text, 0, 0, &x1, &y1, &w, &h);
+    g.setCursor((320 - w) / 2 - ox, y - oy);
+    g.print(text);
+  }
 
-void drawSuccessAnimation() {
-  if (!showSuccessAnimation) return;
+  strncpy(tw.text, text, sizeof(tw.text) - 1);
+  tw.text[sizeof(tw.text) - 1] = '\0';
+  tw.size = size;
+  tw.color = color;
+  tw.x = (320 - w) / 2;
+  tw.y = y;
+  tw.w = w;
+  tw.h = h;
+  tw.drawn = true;
+
+  if (tw.region && tw.region->canvas) {
+    // Old and new text leave in the same transfer
+    int fx0 = w ? tw.x : oldX, fy0 = w ? tw.y : oldY;
+    int fx1 = w ? tw.x + w : oldX, fy1 = w ? tw.y + h : oldY;
+    if (hadOld) {
+      fx0 = min(fx0, (int)oldX);
+      fy0 = min(fy0, (int)oldY);
+      fx1 = max(fx1, oldX + oldW);
+      fy1 = max(fy1, oldY + oldH);
+    }
+    flushRegion(*tw.region, fx0, fy0, fx1 - fx0, fy1 - fy0);
+  }
+}
 
-  int centerX = 160;
-  int centerY = 120;
+// 0 = no overlay, 1/2 = limit hit (tighten/loosen), 3 = servo at center
+int limitOverlayState() {
+  if (!(servoLimitReached && waitingForConfirm)) return 0;
+  if (servoReturningToCenter) return 3;
+  return needsTightenRoom ? 1 : 2;
+}
 
-  int size = 40 + (successAnimationFrame % 20);
-  tft.fillCircle(centerX, centerY, size, COLOR_SUCCESS);
+// ===== CENTS METER =====
 
-  tft.drawLine(centerX - 15, centerY, centerX - 5, centerY + 15, COLOR_TEXT);
-  tft.drawLine(centerX - 5, centerY + 15, centerX + 20, centerY - 15, COLOR_TEXT);
-  tft.drawLine(centerX - 14, centerY, centerX - 5, centerY + 14, COLOR_TEXT);
-  tft.drawLine(centerX - 5, centerY + 14, centerX + 19, centerY - 15, COLOR_TEXT);
+const int METER_WIDTH = 280;
+const int METER_HEIGHT = 40;
+const int METER_X = (320 - METER_WIDTH) / 2;
+const int METER_CENTER_X = METER_X + METER_WIDTH / 2;
+const int NEEDLE_RADIUS = 13;
 
-  successAnimationFrame++;
+int meterNeedleX(int cents) {
+  int c = constrain(cents, -50, 50);
+  return METER_CENTER_X + map(c, -50, 50, -METER_WIDTH/2 + 15, METER_WIDTH/2 - 15);
 }
 
-// ===== BUTTON HANDLING =====
+uint16_t meterNeedleColor(int cents) {
+  uint16_t color = COLOR_SUCCESS;
+  if (abs(cents) > TUNE_TOLERANCE && abs(cents) <= 15) color = COLOR_WARNING;
+  else if (abs(cents) > 15) color = COLOR_DANGER;
+  return color;
+}
 
-void initButtons() {
-  pinMode(BTN_TOGGLE, INPUT_PULLUP);
-  pinMode(BTN_SELECT, INPUT_PULLUP);
+int meterTolerancePixels() {
+  return map(TUNE_TOLERANCE, 0, 50, 0, METER_WIDTH / 2);
 }
 
-int readButtonPress(int buttonIndex, int pin) {
-  bool currentState = digitalRead(pin);
-  int result = 0;
+void drawMeterNeedle(int y, int x, uint16_t color) {
+  Adafruit_GFX& g = regionTarget(&meterRegion);
+  int16_t ox = regionOX(&meterRegion), oy = regionOY(&meterRegion);
+  g.fillCircle(x - ox, y + METER_HEIGHT/2 - oy, NEEDLE_RADIUS - 1, color);
+  g.drawCircle(x - ox, y + METER_HEIGHT/2 - oy, NEEDLE_RADIUS, COLOR_TEXT);
+}
 
-  if (currentState == LOW && lastButtonState[buttonIndex] == HIGH) {
-    buttonPressStart[buttonIndex] = millis();
-    buttonLongPressTriggered[buttonIndex] = false;
+// Repaints the meter background under a needle centred at x. The needle's
+// box never reaches the card's rounded corners, so plain rects are enough.
+void eraseMeterNeedle(int y, int x) {
+  Adafruit_GFX& g = regionTarget(&meterRegion);
+  int16_t ox = regionOX(&meterRegion), oy = regionOY(&meterRegion);
+  int bx = x - NEEDLE_RADIUS;
+  int by = y + METER_HEIGHT/2 - NEEDLE_RADIUS;
+  int bw = 2 * NEEDLE_RADIUS + 1;
+  int bh = 2 * NEEDLE_RADIUS + 1;
+  g.fillRect(bx - ox, by - oy, bw, bh, COLOR_CARD);
+
+  if (METER_CENTER_X >= bx && METER_CENTER_X < bx + bw) {
+    int ly0 = max(y + 8, by);
+    int ly1 = min(y + METER_HEIGHT - 8, by + bh);
+    if (ly1 > ly0) g.drawFastVLine(METER_CENTER_X - ox, ly0 - oy, ly1 - ly0, COLOR_TEXT_DIM);
   }
 
-  if (currentState == HIGH && lastButtonState[buttonIndex] == LOW) {
-    unsigned long duration = millis() - buttonPressStart[buttonIndex];
+  int tol = meterTolerancePixels();
+  int tx0 = max(METER_CENTER_X - tol, bx);
+  int tx1 = min(METER_CENTER_X + tol, bx + bw);
+  int ty0 = max(y + 4, by);
+  int ty1 = min(y + METER_HEIGHT - 4, by + bh);
+  if (tx1 > tx0 && ty1 > ty0) g.fillRect(tx0 - ox, ty0 - oy, tx1 - tx0, ty1 - ty0, 0x0320);
+}
+
+void drawCentsMeter(int y, int cents) {
+  meterRegion.x = METER_X;
+  meterRegion.y = y;
+  clearRegion(meterRegion);
+
+  Adafruit_GFX& g = regionTarget(&meterRegion);
+  int16_t ox = regionOX(&meterRegion), oy = regionOY(&meterRegion);
+  g.fillRoundRect(METER_X - ox, y - oy, METER_WIDTH, METER_HEIGHT, 6, COLOR_CARD);
+  g.drawFastVLine(METER_CENTER_X - ox, y + 8 - oy, METER_HEIGHT - 16, COLOR_TEXT_DIM);
 
-    if (!buttonLongPressTriggered[buttonIndex]) {
-      if (duration >= 2000) result = 3;
-      else if (duration >= 800) result = 2;
-      else if (duration >= 50) result = 1;
-    }
+  int tolerancePixels = meterTolerancePixels();
+  g.fillRect(METER_CENTER_X - tolerancePixels - ox, y + 4 - oy, tolerancePixels * 2, METER_HEIGHT - 8, 0x0320);
+
+  ui.meterDrawn = true;
+  ui.meterY = y;
+  ui.needleX = meterNeedleX(cents);
+  ui.needleColor = meterNeedleColor(cents);
+  drawMeterNeedle(y, ui.needleX, ui.needleColor);
+
+  flushRegion(meterRegion, METER_X, y, METER_WIDTH, METER_HEIGHT);
+}
+
+// Moves the needle only; draws the whole meter the first time
+void updateCentsMeter(int y, int cents) {
+  if (!ui.meterDrawn || ui.meterY != y) {
+    drawCentsMeter(y, cents);
+    return;
   }
 
-  if (currentState == LOW && !buttonLongPressTriggered[buttonIndex]) {
-    unsigned long duration = millis() - buttonPressStart[buttonIndex];
+  int x = meterNeedleX(cents);
+  uint16_t color = meterNeedleColor(cents);
+  if (x == ui.needleX && color == ui.needleColor) return;
 
-    if (duration >= 2000) {
-      buttonLongPressTriggered[buttonIndex] = true;
-      result = 3;
-    } else if (duration >= 800) {
-      buttonLongPressTriggered[buttonIndex] = true;
-      result = 2;
-    }
+  eraseMeterNeedle(y, ui.needleX);
+  drawMeterNeedle(y, x, color);
+
+  if (meterRegion.canvas) {
+    // One window spanning the old and new needle
+    int x0 = min(x, ui.needleX) - NEEDLE_RADIUS;
+    int x1 = max(x, ui.needleX) + NEEDLE_RADIUS + 1;
+    flushRegion(meterRegion, x0, y + METER_HEIGHT/2 - NEEDLE_RADIUS, x1 - x0, 2 * NEEDLE_RADIUS + 1);
   }
 
-  lastButtonState[buttonIndex] = currentState;
-  return result;
+  ui.needleX = x;
+  ui.needleColor = color;
 }
 
-void handleButtons() {
-  int toggleAction = readButtonPress(0, BTN_TOGGLE);
-  int selectAction = readButtonPress(1, BTN_SELECT);
+// ===== STRING INDICATOR =====
 
-  if (toggleAction > 0) {
-    if (toggleAction == 3) {
-      currentState = STATE_OFF;
-      tft.fillScreen(COLOR_BG);
-      if (servoAttached) {
-        servoPos = SERVO_CENTER;
-        tunerServo.write(servoPos);
-        delay(200);
-        tunerServo.detach();
-        servoAttached = false;
-      }
+void drawStringBox(int i, bool isSelected) {
+  int y = 45;
+  int boxWidth = 45;
+  int spacing = 5;
+  int totalWidth = 6 * boxWidth + 5 * spacing;
+  int startX = (320 - totalWidth) / 2;
+  int x = startX + i * (boxWidth + spacing);
 
-    } else if (toggleAction == 2) {
-      if (currentState == STATE_STANDBY) {
-        currentState = STATE_AUTO_TUNE_ALL;
-        autoTuneInProgress = true;
-        autoTuneCurrentString = 0;
-        autoTuneStringStartTime = millis();
-        currentTuneStartTime = millis();
-        hadSignal = false;
-        wasInTune = false;
-        inTuneStartTime = 0;
-        waitingForConfirm = true;  // Wait for SELECT before moving servo
-        if (!servoAttached) {
-          tunerServo.attach(SERVO_PIN, 500, 2500);
-          servoAttached = true;
-        }
-        drawAutoTuneAllScreen();
-      }
+  if (isSelected) {
+    tft.fillRoundRect(x, y, boxWidth, 30, 4, COLOR_PRIMARY);
+    tft.setTextColor(COLOR_BG);
+  } else {
+    tft.fillRoundRect(x, y, boxWidth, 30, 4, COLOR_CARD);
+    tft.setTextColor(COLOR_TEXT_DIM);
+  }
 
-    } else if (toggleAction == 1) {
-      if (currentState == STATE_OFF) {
-        currentState = STATE_STANDBY;
-        drawStandbyScreen();
+  tft.setTextSize(1);
+  int16_t x1, y1;
+  uint16_t w, h;
+  // Use note names from current tuning mode
+  tft.getTextBounds(tuningModes[tuningMode].noteNames[i], 0, 0, &x1, &y1, &w, &h);
+  tft.setCursor(x + (boxWidth - w) / 2, y + 10);
+  tft.print(tuningModes[tuningMode].noteNames[i]);
+}
 
-      } else if (currentState == STATE_STANDBY) {
-        currentState = STATE_TUNING;
-        drawTuningScreen();
-        currentTuneStartTime = millis();
-        hadSignal = false;
-        wasInTune = false;
-        inTuneStartTime = 0;
-        waitingForConfirm = true;  // Wait for SELECT before moving servo
-        if (!servoAttached) {
-          tunerServo.attach(SERVO_PIN, 500, 2500);
-          servoAttached = true;
+void drawStringIndicator(int stringNum) {
+  for (int i = 0; i < 6; i++) {
+    drawStringBox(i, stringNum == i);
+  }
+  ui.stringNum = stringNum;
+}
+
+// Repaints only the boxes whose highlight changed
+void updateStringIndicator(int stringNum) {
+  if (ui.stringNum == -2) {
+    drawStringIndicator(stringNum);
+    return;
+  }
+  if (stringNum == ui.stringNum) return;
+
+  if (ui.stringNum >= 0) drawStringBox(ui.stringNum, false);
+  if (stringNum >= 0) drawStringBox(stringNum, true);
+  ui.stringNum = stringNum;
+}
+
+// ===== UI SCREENS =====
+
+void drawStandbyScreen() {
+  tft.fillScreen(COLOR_BG);
+
+  drawCenteredText("GUITAR TUNER", 30, 3, COLOR_PRIMARY);
+
+  tft.fillRoundRect(20, 80, 280, 50, 8, COLOR_CARD);
+  tft.setTextSize(1);
+  tft.setTextColor(COLOR_TEXT_DIM);
+  tft.setCursor(30, 90);
+  tft.print("MODE");
+  tft.setTextSize(2);
+  tft.setTextColor(COLOR_TEXT);
+  tft.setCursor(30, 105);
+  tft.print(tuningModes[tuningMode].name);
+
+  tft.setTextSize(1);
+  tft.setTextColor(COLOR_TEXT_DIM);
+  tft.setCursor(180, 90);
+  tft.print("STRING");
+  tft.setTextSize(2);
+  tft.setTextColor(COLOR_PRIMARY);
+  tft.setCursor(180, 105);
+  if (isAutoMode) tft.print("AUTO");
+  else tft.print(tuningModes[tuningMode].noteNames[selectedString]);
+
+  tft.fillRoundRect(20, 150, 280, 70, 8, COLOR_CARD);
+  tft.setTextSize(1);
+  tft.setTextColor(COLOR_TEXT);
+  tft.setCursor(35, 165);
+  tft.print("TOGGLE: Start Tuning");
+  tft.setCursor(35, 180);
+  tft.print("SELECT: Choose String");
+  tft.setTextColor(COLOR_TEXT_DIM);
+  tft.setCursor(35, 200);
+  tft.print("Long press for more options");
+}
+
+void drawTuningScreen() {
+  tft.fillScreen(COLOR_BG);
+  statusRegion.y = 222;
+  uiInvalidate();
+
+  tft.setTextSize(1);
+  tft.setTextColor(COLOR_TEXT_DIM);
+  tft.setCursor(10, 10);
+  tft.print(tuningModes[tuningMode].name);
+
+  tft.setTextColor(COLOR_SUCCESS);
+  tft.setCursor(260, 10);
+  tft.print("TUNING");
+
+  drawStringIndicator(-1);
+}
+
+void updateTuningDisplay(float freq, const String& note, int cents, int stringNum) {
+  updateStringIndicator(stringNum);
+
+  int overlay = limitOverlayState();
+  if (overlay != ui.overlay) {
+    if (overlay) {
+      // Show limit warning overlay
+      tft.fillRect(20, 85, 280, 75, COLOR_DANGER);
+      if (overlay != 3) {
+        // Step 1: Just hit limit
+        drawCenteredText("SERVO LIMIT!", 95, 2, COLOR_TEXT);
+        if (overlay == 1) {
+          drawCenteredText("Need more room to TIGHTEN", 120, 1, COLOR_TEXT);
+        } else {
+          drawCenteredText("Need more room to LOOSEN", 120, 1, COLOR_TEXT);
+        }
+      } else {
+        // Step 2: Servo at center, waiting to resume
+        drawCenteredText("REPOSITION MOTOR", 95, 2, COLOR_TEXT);
+        drawCenteredText("Motor at center position", 120, 1, COLOR_TEXT);
+      }
+    } else {
+      tft.fillRect(20, 85, 280, 75, COLOR_BG);
+    }
+    ui.overlay = overlay;
+    uiNote.drawn = false;  // Covered or wiped along with the overlay
+    uiFreq.drawn = false;
+    clearRegion(noteRegion);
+  }
+
+  if (!overlay) {
+    if (freq > 0) {
+      char freqStr[16];
+      sprintf(freqStr, "%d Hz", (int)freq);
+      updateCenteredText(uiNote, note.c_str(), 90, 5, COLOR_TEXT);
+      updateCenteredText(uiFreq, freqStr, 140, 2, COLOR_TEXT_DIM);
+    } else {
+      updateCenteredText(uiNote, "---", 100, 4, COLOR_TEXT_DIM);
+      updateCenteredText(uiFreq, "", 140, 2, COLOR_TEXT_DIM);
+    }
+  }
+
+  updateCentsMeter(175, cents);
+
+  if (overlay == 1 || overlay == 2) {
+    updateCenteredText(uiStatus, "Press SELECT to reposition", 222, 2, COLOR_WARNING);
+  } else if (overlay == 3) {
+    updateCenteredText(uiStatus, "Press SELECT to resume", 222, 2, COLOR_WARNING);
+  } else if (waitingForConfirm) {
+    updateCenteredText(uiStatus, "Press SELECT to start", 222, 2, COLOR_WARNING);
+  } else if (freq <= 0) {
+    updateCenteredText(uiStatus, "Play a string", 222, 2, COLOR_TEXT_DIM);
+  } else if (abs(cents) <= TUNE_TOLERANCE) {
+    updateCenteredText(uiStatus, "IN TUNE", 222, 2, COLOR_SUCCESS);
+  } else {
+    char statusStr[20];
+    sprintf(statusStr, "%s%d cents", cents > 0 ? "+" : "", cents);
+    uint16_t color = abs(cents) > 15 ? COLOR_DANGER : COLOR_WARNING;
+    updateCenteredText(uiStatus, statusStr, 222, 2, color);
+  }
+}
+
+void drawAutoTuneBoxes() {
+  int boxSize = 40;
+  int spacing = 10;
+  int totalWidth = 6 * boxSize + 5 * spacing;
+  int startX = (320 - totalWidth) / 2;
+  int y = 70;
+
+  for (int i = 0; i < 6; i++) {
+    int x = startX + i * (boxSize + spacing);
+
+    uint16_t bgColor = COLOR_CARD;
+    uint16_t textColor = COLOR_TEXT_DIM;
+
+    if (i < autoTuneCurrentString || (polyResultValid && polyResult.inTune[i])) {
+      bgColor = COLOR_SUCCESS;
+      textColor = COLOR_BG;
+    } else if (i == autoTuneCurrentString) {
+      bgColor = COLOR_WARNING;
+      textColor = COLOR_BG;
+    }
+
+    tft.fillRoundRect(x, y, boxSize, boxSize, 6, bgColor);
+    tft.setTextSize(1);
+    tft.setTextColor(textColor);
+    int16_t x1, y1;
+    uint16_t w, h;
+    tft.getTextBounds(tuningModes[tuningMode].noteNames[i], 0, 0, &x1, &y1, &w, &h);
+    tft.setCursor(x + (boxSize - w) / 2, y + (boxSize - h) / 2);
+    tft.print(tuningModes[tuningMode].noteNames[i]);
+  }
+}
+
+// Current string's note name and target frequency
+void drawAutoTuneTarget() {
+  if (autoTuneCurrentString < 6) {
+    tft.setTextSize(4);
+    tft.setTextColor(COLOR_WARNING);
+    const char* noteName = tuningModes[tuningMode].noteNames[autoTuneCurrentString];
+    tft.setCursor(80, 135);
+    tft.print(noteName);
+
+    tft.setTextSize(2);
+    tft.setTextColor(COLOR_TEXT_DIM);
+    tft.setCursor(180, 145);
+    tft.print((int)tuningModes[tuningMode].freqs[autoTuneCurrentString]);
+    tft.print(" Hz");
+  }
+}
+
+void drawAutoTuneAllScreen() {
+  tft.fillScreen(COLOR_BG);
+  statusRegion.y = 192;
+  uiInvalidate();
+
+  drawCenteredText("AUTO TUNE", 20, 3, COLOR_PRIMARY);
+  
+  // Show tuning mode name
+  tft.setTextSize(1);
+  tft.setTextColor(COLOR_TEXT_DIM);
+  tft.setCursor(10, 50);
+  tft.print(tuningModes[tuningMode].name);
+
+  drawAutoTuneBoxes();
+  drawAutoTuneTarget();
+  drawCentsMeter(210, 0);
+}
+
+void updateAutoTuneDisplay(float freq, int cents) {
+
+  // String boxes and target only change with autoTuneCurrentString, which
+  // redraws the whole screen; here we only track the limit overlay over them
+  int overlay = limitOverlayState();
+  if (overlay != ui.overlay) {
+    if (overlay) {
+      tft.fillRect(0, 130, 320, 60, COLOR_DANGER);
+      if (overlay != 3) {
+        drawCenteredText("SERVO LIMIT!", 135, 2, COLOR_TEXT);
+        if (overlay == 1) {
+          drawCenteredText("Need more room to TIGHTEN", 155, 1, COLOR_TEXT);
+        } else {
+          drawCenteredText("Need more room to LOOSEN", 155, 1, COLOR_TEXT);
+        }
+      } else {
+        drawCenteredText("REPOSITION MOTOR", 135, 2, COLOR_TEXT);
+        drawCenteredText("Motor at center position", 155, 1, COLOR_TEXT);
+      }
+    } else {
+      tft.fillRect(0, 130, 320, 60, COLOR_BG);
+      drawAutoTuneTarget();
+    }
+    ui.overlay = overlay;
+  }
+
+  updateCentsMeter(210, freq > 0 ? cents : 0);
+
+  if (overlay == 1 || overlay == 2) {
+    updateCenteredText(uiStatus, "Press SELECT to reposition", 192, 2, COLOR_WARNING);
+  } else if (overlay == 3) {
+    updateCenteredText(uiStatus, "Press SELECT to resume", 192, 2, COLOR_WARNING);
+  } else if (waitingForConfirm) {
+    updateCenteredText(uiStatus, "Press SELECT to start", 192, 2, COLOR_WARNING);
+  } else if (freq > 0) {
+    char buf[32];
+    sprintf(buf, "%d Hz (%s%d)", (int)freq, cents > 0 ? "+" : "", cents);
+    updateCenteredText(uiStatus, buf, 192, 2, COLOR_TEXT);
+  } else {
+    updateCenteredText(uiStatus, "Play string", 192, 2, COLOR_TEXT_DIM);
+  }
+}
+
+void drawStringSelectScreen() {
+  tft.fillScreen(COLOR_BG);
+
+  drawCenteredText("SELECT STRING", 20, 2, COLOR_PRIMARY);
+  
+  // Show tuning mode name
+  tft.setTextSize(1);
+  tft.setTextColor(COLOR_TEXT_DIM);
+  tft.setCursor(10, 45);
+  tft.print(tuningModes[tuningMode].name);
+
+  int boxWidth = 90;
+  int boxHeight = 45;
+  int spacing = 15;
+  int startY = 60;
+
+  bool autoSelected = isAutoMode;
+  tft.fillRoundRect(115, startY, 90, 35, 6, autoSelected ? COLOR_PRIMARY : COLOR_CARD);
+  tft.setTextSize(2);
+  tft.setTextColor(autoSelected ? COLOR_BG : COLOR_TEXT);
+  tft.setCursor(135, startY + 10);
+  tft.print("AUTO");
+
+  startY = 110;
+  for (int i = 0; i < 6; i++) {
+    int col = i % 3;
+    int row = i / 3;
+    int x = 25 + col * (boxWidth + spacing);
+    int y = startY + row * (boxHeight + spacing);
+
+    bool selected = (!isAutoMode && selectedString == i);
+
+    tft.fillRoundRect(x, y, boxWidth, boxHeight, 6, selected ? COLOR_PRIMARY : COLOR_CARD);
+
+    tft.setTextSize(2);
+    tft.setTextColor(selected ? COLOR_BG : COLOR_TEXT);
+    tft.setCursor(x + 20, y + 8);
+    // Use note names from current tuning mode
+    tft.print(tuningModes[tuningMode].noteNames[i]);
+
+    tft.setTextSize(1);
+    tft.setTextColor(selected ? COLOR_BG : COLOR_TEXT_DIM);
+    tft.setCursor(x + 20, y + 30);
+    tft.print((int)tuningModes[tuningMode].freqs[i]);
+    tft.print(" Hz");
+  }
+
+  tft.setTextSize(1);
+  tft.setTextColor(COLOR_TEXT_DIM);
+  tft.setCursor(60, 225);
+  tft.print("SELECT: cycle  |  TOGGLE: confirm");
+}
+
+void drawModeSelectScreen() {
+  tft.fillScreen(COLOR_BG);
+
+  drawCenteredText("TUNING MODE", 20, 2, COLOR_PRIMARY);
+
+  tft.setTextSize(1);
+  tft.setTextColor(COLOR_TEXT_DIM);
+  tft.setCursor(10, 45);
+  tft.print("ENGINE: ");
+  tft.print(PITCH_ENGINE_NAMES[pitchEngine]);
+  tft.print("  (hold SELECT)");
+
+  int boxHeight = 40;
+  int spacing = 10;
+  int startY = 60;
+
+  for (int i = 0; i < 4; i++) {
+    int y = startY + i * (boxHeight + spacing);
+    bool selected = (tuningMode == i);
+
+    tft.fillRoundRect(30, y, 260, boxHeight, 6, selected ? COLOR_PRIMARY : COLOR_CARD);
+
+    tft.setTextSize(2);
+    tft.setTextColor(selected ? COLOR_BG : COLOR_TEXT);
+    tft.setCursor(50, y + 12);
+    tft.print(tuningModes[i].name);
+  }
+
+  tft.setTextSize(1);
+  tft.setTextColor(COLOR_TEXT_DIM);
+  tft.setCursor(60, 225);
+  tft.print("SELECT: cycle  |  TOGGLE: confirm");
+}
+
+#if PROFILE
+// Per-stage timings in microseconds, from the same histograms as "prof"
+void drawProfileScreen() {
+  tft.fillScreen(COLOR_BG);
+
+  drawCenteredText("PROFILE (us)", 10, 2, COLOR_PRIMARY);
+
+  float perUs = halCyclesPerUs();
+  char line[64];
+  snprintf(line, sizeof(line), "%-11s %6s %6s %6s %6s %6s",
+           "stage", "count", "min", "mean", "p99", "max");
+  tft.setTextSize(1);
+  tft.setTextColor(COLOR_TEXT_DIM);
+  tft.setCursor(10, 40);
+  tft.print(line);
+
+  for (int i = 0; i < PROF_STAGE_COUNT; i++) {
+    const ProfileStat &p = profileStats[i];
+    float mean = p.count ? (float)p.totalCycles / p.count : 0.0f;
+    snprintf(line, sizeof(line), "%-11s %6lu %6.0f %6.0f %6.0f %6.0f",
+             PROFILE_STAGE_NAMES[i], (unsigned long)p.count, p.minCycles / perUs,
+             mean / perUs, profilePercentile(p, 0.99f) / perUs, p.maxCycles / perUs);
+    tft.setTextColor(p.count ? COLOR_TEXT : COLOR_TEXT_DIM);
+    tft.setCursor(10, 58 + i * 16);
+    tft.print(line);
+  }
+
+  tft.setTextColor(COLOR_TEXT_DIM);
+  tft.setCursor(28, 225);
+  tft.print("SELECT: refresh | hold: reset | TOGGLE: exit");
+}
+#endif
+
+void drawSuccessAnimation() {
+  if (!showSuccessAnimation) return;
+  if (controlMillis() - lastSuccessFrameTime < SUCCESS_FRAME_PERIOD) return;
+  lastSuccessFrameTime = controlMillis();
+
+  int centerX = 160;
+  int centerY = 120;
+
+  int size = 40 + (successAnimationFrame % 20);
+  tft.fillCircle(centerX, centerY, size, COLOR_SUCCESS);
+
+  tft.drawLine(centerX - 15, centerY, centerX - 5, centerY + 15, COLOR_TEXT);
+  tft.drawLine(centerX - 5, centerY + 15, centerX + 20, centerY - 15, COLOR_TEXT);
+  tft.drawLine(centerX - 14, centerY, centerX - 5, centerY + 14, COLOR_TEXT);
+  tft.drawLine(centerX - 5, centerY + 14, centerX + 19, centerY - 15, COLOR_TEXT);
+
+  successAnimationFrame++;
+}
+
+// ===== BUTTON HANDLING =====
+
+// Timestamped button event. Edges carry the level (1 pressed, 0 released),
+// classified presses the action (1 short, 2 long, 3 very long).
+struct ButtonEvent {
+  uint32_t ms;
+  uint8_t button;  // 0 TOGGLE, 1 SELECT
+  uint8_t value;
+};
+
+// Single-producer single-consumer queue. When full, events are dropped:
+// edges carry their level, so the classifier resyncs on the next one.
+class ButtonEventQueue {
+public:
+  bool IRAM_ATTR push(const ButtonEvent &e) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= SIZE) return false;
+    buf[h & (SIZE - 1)] = e;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(ButtonEvent &e) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) return false;
+    e = buf[t & (SIZE - 1)];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  static const uint32_t SIZE = 32;
+  ButtonEvent buf[SIZE];
+  std::atomic<uint32_t> head{0};
+  std::atomic<uint32_t> tail{0};
+};
+
+// Debounces one button and classifies its presses. It has no clock of its
+// own - edges come in with their timestamps and poll() is given the time -
+// so edge sequences can be replayed against it. A level counts once it has
+// held BUTTON_DEBOUNCE_MS and is dated to the first edge of its bounce
+// burst. Short and long presses are emitted on release; very long fires
+// while the button is still held, and that press's release is swallowed.
+class ButtonClassifier {
+public:
+  // An edge that comes after the current burst has settled starts a new
+  // one; polling at 't' first settles the old burst even when the edges
+  // were queued behind a stall. Returns what that poll emitted.
+  int edge(bool level, unsigned long t) {
+    int action = poll(t);
+    if (!settling) {
+      settling = true;
+      burstAt = t;
+    }
+    rawPressed = level;
+    lastEdgeAt = t;
+    return action;
+  }
+
+  // 0 none, 1 short, 2 long, 3 very long
+  int poll(unsigned long now) {
+    if (settling && now - lastEdgeAt >= BUTTON_DEBOUNCE_MS) {
+      settling = false;
+      if (rawPressed != pressed) {
+        pressed = rawPressed;
+        if (pressed) {
+          pressedAt = burstAt;
+          veryLongSent = false;
+        } else if (!veryLongSent) {
+          return classify(burstAt - pressedAt);
+        }
+      }
+    }
+    if (pressed && !settling && !veryLongSent && now - pressedAt >= BUTTON_VERY_LONG_MS) {
+      veryLongSent = true;
+      return 3;
+    }
+    return 0;
+  }
+
+  // Milliseconds until poll() may have something to say, -1 when idle
+  long msUntilDue(unsigned long now) const {
+    unsigned long due;
+    if (settling) {
+      due = lastEdgeAt + BUTTON_DEBOUNCE_MS;
+    } else if (pressed && !veryLongSent) {
+      due = pressedAt + BUTTON_VERY_LONG_MS;
+    } else {
+      return -1;
+    }
+    long left = (long)(due - now);
+    return left > 0 ? left : 0;
+  }
+
+private:
+  static int classify(unsigned long duration) {
+    if (duration >= BUTTON_VERY_LONG_MS) return 3;
+    if (duration >= BUTTON_LONG_MS) return 2;
+    if (duration >= BUTTON_CLICK_MS) return 1;
+    return 0;
+  }
+
+  bool pressed = false;     // Debounced level
+  bool rawPressed = false;  // Level after the newest edge
+  bool settling = false;    // Edges seen since the level was last accepted
+  bool veryLongSent = false;
+  unsigned long burstAt = 0, lastEdgeAt = 0, pressedAt = 0;
+};
+
+ButtonEventQueue buttonEdges;    // Edge interrupts -> button task
+ButtonEventQueue buttonPresses;  // Button task -> loop()
+ButtonClassifier buttonClassifier[2];
+TaskHandle_t buttonTaskHandle = nullptr;
+
+// Both edge interrupts go through the one GPIO interrupt handler, so they
+// never run concurrently and buttonEdges keeps a single producer
+void IRAM_ATTR pushButtonEdge(uint8_t button, int pin) {
+  buttonEdges.push(ButtonEvent{(uint32_t)millis(), button, (uint8_t)(digitalRead(pin) == LOW)});
+  if (buttonTaskHandle) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(buttonTaskHandle, &woken);
+    portYIELD_FROM_ISR(woken);
+  }
+}
+
+void IRAM_ATTR onToggleEdge() {
+  pushButtonEdge(0, BTN_TOGGLE);
+}
+
+void IRAM_ATTR onSelectEdge() {
+  pushButtonEdge(1, BTN_SELECT);
+}
+
+// Feeds queued edges to the classifiers and queues finished presses.
+// Returns the ms until a classifier needs another look, -1 when idle.
+long serviceButtons() {
+  ButtonEvent e;
+  while (buttonEdges.pop(e)) {
+    int action = buttonClassifier[e.button].edge(e.value, e.ms);
+    if (action) buttonPresses.push(ButtonEvent{e.ms, e.button, (uint8_t)action});
+  }
+
+  unsigned long now = millis();
+  long wait = -1;
+  for (uint8_t b = 0; b < 2; b++) {
+    int action = buttonClassifier[b].poll(now);
+    if (action) buttonPresses.push(ButtonEvent{(uint32_t)now, b, (uint8_t)action});
+    long due = buttonClassifier[b].msUntilDue(now);
+    if (due >= 0 && (wait < 0 || due < wait)) wait = due;
+  }
+  return wait;
+}
+
+// Sleeps until an edge arrives or a debounce/very-long deadline is due, so
+// press timing doesn't depend on how long loop() or a DSP frame takes
+void buttonTask(void*) {
+  while (true) {
+    long wait = serviceButtons();
+    ulTaskNotifyTake(pdTRUE, wait < 0 ? portMAX_DELAY : pdMS_TO_TICKS(wait) + 1);
+  }
+}
+
+void initButtons() {
+  pinMode(BTN_TOGGLE, INPUT_PULLUP);
+  pinMode(BTN_SELECT, INPUT_PULLUP);
+  // Above the DSP task, so a press is classified within a tick of its deadline
+  if (xTaskCreatePinnedToCore(buttonTask, "buttons", 2048, nullptr, 3, &buttonTaskHandle, 0) != pdPASS) {
+    buttonTaskHandle = nullptr;
+  }
+  attachInterrupt(digitalPinToInterrupt(BTN_TOGGLE), onToggleEdge, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(BTN_SELECT), onSelectEdge, CHANGE);
+}
+
+// Acts on classified presses (1 short, 2 long, 3 very long, 0 none); also
+// driven directly by the simulator's button script
+void handleButtonActions(int toggleAction, int selectAction) {
+  if (toggleAction > 0) {
+    if (toggleAction == 3) {
+      currentState = STATE_OFF;
+      tft.fillScreen(COLOR_BG);
+      if (servoAttached) {
+        servoPos = SERVO_CENTER;
+        tunerServo.write(servoPos);
+        delay(200);
+        tunerServo.detach();
+        servoAttached = false;
+      }
+
+    } else if (toggleAction == 2) {
+      if (currentState == STATE_STANDBY) {
+        currentState = STATE_AUTO_TUNE_ALL;
+        autoTuneInProgress = true;
+        autoTuneCurrentString = 0;
+        polyResultValid = false;  // Strum all strings to skip the ones in tune
+        autoTuneStringStartTime = controlMillis();
+        currentTuneStartTime = controlMillis();
+        wasInTune = false;
+        inTuneStartTime = 0;
+        waitingForConfirm = true;  // Wait for SELECT before moving servo
+        if (!servoAttached && !servoMuted) {
+          tunerServo.attach(SERVO_PIN, 500, 2500);
+          servoAttached = true;
+        }
+        drawAutoTuneAllScreen();
+      }
+
+    } else if (toggleAction == 1) {
+      if (currentState == STATE_OFF) {
+        currentState = STATE_STANDBY;
+        drawStandbyScreen();
+
+      } else if (currentState == STATE_STANDBY) {
+        currentState = STATE_TUNING;
+        drawTuningScreen();
+        currentTuneStartTime = controlMillis();
+        wasInTune = false;
+        inTuneStartTime = 0;
+        waitingForConfirm = true;  // Wait for SELECT before moving servo
+        if (!servoAttached && !servoMuted) {
+          tunerServo.attach(SERVO_PIN, 500, 2500);
+          servoAttached = true;
+        }
+
+      } else if (currentState == STATE_TUNING || currentState == STATE_AUTO_TUNE_ALL) {
+        currentState = STATE_STANDBY;
+        autoTuneInProgress = false;
+        servoPos = SERVO_CENTER;
+        targetServoPos = SERVO_CENTER;
+        wasInTune = false;
+        inTuneStartTime = 0;
+        servoLimitReached = false;
+        servoReturningToCenter = false;
+        useWideDetection = false;
+        if (servoAttached) {
+          tunerServo.write(servoPos);
+          delay(200);
+          tunerServo.detach();
+          servoAttached = false;
+        }
+        drawStandbyScreen();
+
+      } else if (currentState == STATE_STRING_SELECT || currentState == STATE_MODE_SELECT ||
+                 currentState == STATE_PROFILE) {
+        currentState = STATE_STANDBY;
+        drawStandbyScreen();
+
+      } else {
+        currentState = STATE_STANDBY;
+        drawStandbyScreen();
+      }
+    }
+  }
+
+  if (selectAction > 0) {
+    if (selectAction == 2) {
+      if (currentState == STATE_STANDBY) {
+        currentState = STATE_MODE_SELECT;
+        drawModeSelectScreen();
+      } else if (currentState == STATE_MODE_SELECT) {
+        pitchEngine = (pitchEngine + 1) % ENGINE_COUNT;
+        Serial.printf("Pitch engine: %s\n", PITCH_ENGINE_NAMES[pitchEngine]);
+        drawModeSelectScreen();
+#if PROFILE
+      } else if (currentState == STATE_STRING_SELECT) {
+        currentState = STATE_PROFILE;
+        drawProfileScreen();
+      } else if (currentState == STATE_PROFILE) {
+        profileReset();
+        drawProfileScreen();
+#endif
+      }
+
+    } else if (selectAction == 1) {
+      // If tuning and waiting for confirmation, handle the flow
+      if ((currentState == STATE_TUNING || currentState == STATE_AUTO_TUNE_ALL) && waitingForConfirm) {
+        if (servoLimitReached && !servoReturningToCenter) {
+          // Step 1: Limit reached, first SELECT press -> move servo to center
+          servoReturningToCenter = true;
+          servoPos = SERVO_CENTER;
+          if (!servoMuted) tunerServo.write(servoPos);
+          targetServoPos = SERVO_CENTER;
+          trackerReset();
+          wasInTune = false;
+          Serial.println("SELECT pressed - servo returning to center, reposition motor then press SELECT again");
+        } else if (servoLimitReached && servoReturningToCenter) {
+          // Step 2: Servo at center, second SELECT press -> resume tuning
+          servoLimitReached = false;
+          servoReturningToCenter = false;
+          waitingForConfirm = false;
+          trackerReset();
+          wasInTune = false;
+          useWideDetection = true;  // Use wider detection until we get stable signal
+          Serial.println("SELECT pressed - resuming tuning with wide detection");
+        } else {
+          // Normal start (not from limit)
+          waitingForConfirm = false;
+          servoLimitReached = false;
+          servoReturningToCenter = false;
+          trackerReset();
+          wasInTune = false;
+          Serial.println("SELECT pressed - servo enabled");
+        }
+      } else if (currentState == STATE_STANDBY) {
+        currentState = STATE_STRING_SELECT;
+        drawStringSelectScreen();
+
+      } else if (currentState == STATE_STRING_SELECT) {
+        if (isAutoMode) {
+          isAutoMode = false;
+          selectedString = 0;
+        } else {
+          selectedString++;
+          if (selectedString > 5) {
+            isAutoMode = true;
+            selectedString = -1;
+          }
+        }
+        drawStringSelectScreen();
+
+      } else if (currentState == STATE_MODE_SELECT) {
+        tuningMode = (tuningMode + 1) % NUM_TUNINGS;
+        drawModeSelectScreen();
+
+#if PROFILE
+      } else if (currentState == STATE_PROFILE) {
+        drawProfileScreen();
+#endif
+      }
+    }
+  }
+}
+
+void handleButtons() {
+  if (!buttonTaskHandle) serviceButtons();  // No task: classify from loop()
+  ButtonEvent e;
+  while (buttonPresses.pop(e)) {
+    handleButtonActions(e.button == 0 ? e.value : 0, e.button == 1 ? e.value : 0);
+  }
+}
+
+// ===== PITCH HELPERS =====
+
+// The string being tuned; -1 in auto mode, where the pitch picks it
+int tunedString() {
+  if (currentState == STATE_AUTO_TUNE_ALL && autoTuneInProgress) {
+    return autoTuneCurrentString;
+  }
+  return isAutoMode ? -1 : selectedString;
+}
+
+int identifyString(float f) {
+  if (f <= 0) return -1;
+  int s = tunedString();
+  if (s >= 0 || !isAutoMode) return s;
+
+  const float* bounds = tuningModes[tuningMode].upperBounds;
+  s = 0;
+  while (s < 5 && f >= bounds[s]) s++;
+  return s;
+}
+
+// identifyString() for the fixed-point path, from 1200*log2(period) in Q8
+int identifyStringPeriod(int32_t periodQ8) {
+  if (periodQ8 <= 0) return -1;
+  int s = tunedString();
+  if (s >= 0 || !isAutoMode) return s;
+  return stringForPeriodQ8(periodQ8, tuningMode);
+}
+
+// Note and cents for the display, against the string identifyString() picks
+void freqToNote(float f, String &name, int &cents) {
+  const char* n;
+  freqToNote(f, tuningMode, identifyString(f), n, cents);
+  name = n;
+}
+
+// freqToNote() for a known string, from the detector's Q15 period
+void lagToNote(int32_t lagQ15, int stringNum, String &name, int &cents) {
+  const char* n;
+  lagToNote(lagQ15, tuningMode, stringNum, n, cents);
+  name = n;
+}
+
+// The same from 1200*log2(period) in Q8, as the tracker gives it
+void periodToNote(int32_t periodQ8, int stringNum, String &name, int &cents) {
+  const char* n;
+  periodToNote(periodQ8, tuningMode, stringNum, n, cents);
+  name = n;
+}
+
+// ===== SERVO CONTROL =====
+
+void attachServoIfNeeded() {
+  if (!servoAttached) {
+    tunerServo.attach(SERVO_PIN, 500, 2500);
+    servoAttached = true;
+    delay(50);
+  }
+}
+
+void detachServoIfNeeded() {
+  if (servoAttached && currentState != STATE_TUNING && currentState != STATE_AUTO_TUNE_ALL) {
+    tunerServo.detach();
+    servoAttached = false;
+  }
+}
+
+// Servo travel the string has yet to follow at 'now', signed
+float servoPendingDeg(unsigned long now) {
+  return servoCtl.pendingDeg * expf(-(float)(now - servoCtl.moveAt) / servoCtl.pendingTauMs);
+}
+
+// Learns the string's cents-per-degree gain from two settled samples: the
+// tracked pitch change between them over the part of the servo travel in
+// between that the string has followed. Each settled sample becomes the
+// anchor for the next.
+void servoLearnGain(int stringNum) {
+  float pending = servoPendingDeg(tracker.lastAccept);
+  float followed = servoCtl.degSinceAnchor - pending;
+  float travel = max(abs(servoCtl.degSinceAnchor), SERVO_LEARN_MIN_DEG);
+  bool settled = fabsf(pending) <= SERVO_SETTLED_LEFT * travel &&
+                 tracker.confidence >= TRACK_CONFIDENT;
+  if (!settled) return;
+
+  if (servoCtl.anchored && abs(servoCtl.degSinceAnchor) >= SERVO_LEARN_MIN_DEG) {
+    float observed = (tracker.cents - servoCtl.anchorCents) / followed;
+    if (observed > 0.0f) {
+      float g = servoGain[stringNum] + SERVO_GAIN_ALPHA * (observed - servoGain[stringNum]);
+      servoGain[stringNum] = constrain(g, SERVO_GAIN_MIN, SERVO_GAIN_MAX);
+      TRACE(TRACE_SERVO_GAIN, servoGain[stringNum], stringNum);
+    }
+  }
+  servoCtl.anchored = true;
+  servoCtl.anchorCents = tracker.cents;
+  servoCtl.degSinceAnchor = 0;
+}
+
+// Moves by a fraction of what the learned gain says is needed. Decisions use
+// the predicted final pitch (tracked cents plus what the model says is still
+// to come of the last move); after a move it waits until a frame has come in
+// and the tracker has converged, so moves go at the tracker's pace. Returns
+// the signed move in degrees, 0 while settling.
+int adaptiveServoMove(int cents, int stringNum, unsigned long now) {
+  if (stringNum < 0 || stringNum > 5) return 0;
+
+  if (stringNum != servoCtl.stringNum) {
+    servoCtl.stringNum = stringNum;
+    servoCtl.awaitingSettle = false;
+    servoCtl.anchored = false;
+  }
+
+  servoLearnGain(stringNum);
+
+  float predicted = cents + trackerStepRemaining(tracker, now);
+
+  if (servoCtl.awaitingSettle) {
+    bool measured = (long)(tracker.lastAccept - servoCtl.moveAt) > 0;
+    if (!measured || tracker.p00 > SERVO_CONVERGED_CENTS * SERVO_CONVERGED_CENTS) return 0;
+    servoCtl.awaitingSettle = false;
+  }
+
+  if (fabsf(predicted) <= TUNE_TOLERANCE) return 0;  // Already on its way in
+
+  // Flat (negative cents) = tighten = positive move
+  int move = (int)lroundf(-predicted * SERVO_MOVE_FRACTION / servoGain[stringNum]);
+  if (move == 0) move = (predicted < 0) ? 1 : -1;
+  move = constrain(move, -SERVO_MAX_STEP, SERVO_MAX_STEP);
+
+  servoCtl.awaitingSettle = true;
+  trackerExpectStep(servoGain[stringNum] * move, now,
+                    SERVO_SETTLE_BASE_MS + SERVO_SETTLE_PER_DEG_MS * abs(move));
+  return move;
+}
+
+void updateServoFromCents(int cents, int stringNum) {
+  if (currentState != STATE_TUNING && currentState != STATE_AUTO_TUNE_ALL) return;
+  
+  // Don't move servo until user presses SELECT
+  if (waitingForConfirm) {
+    servoCtl.awaitingSettle = false;
+    servoCtl.anchored = false;  // The horn may be moved off the peg meanwhile
+    return;
+  }
+
+  unsigned long now = controlMillis();
+
+  // Settled samples come mostly while the string sits in tune
+  if (servoControlMode == SERVO_CTRL_ADAPTIVE && stringNum == servoCtl.stringNum) {
+    servoLearnGain(stringNum);
+  }
+
+  // In-tune detection with stability requirement; a confident track needs
+  // less time to prove it. Judged on where the pitch is heading, so a string
+  // passing through the zone mid-move doesn't count.
+  unsigned long inTuneWait = (tracker.confidence >= TRACK_CONFIDENT) ?
+                             IN_TUNE_DURATION_CONFIDENT : IN_TUNE_DURATION;
+  int settledCents = cents + (int)lroundf(trackerStepRemaining(tracker, now));
+  if (abs(cents) <= TUNE_TOLERANCE && abs(settledCents) <= TUNE_TOLERANCE) {
+    if (!wasInTune) {
+      inTuneStartTime = now;
+      wasInTune = true;
+      TRACE(TRACE_IN_TUNE_ENTER, 0.0f, cents);
+    } else if (now - inTuneStartTime >= inTuneWait) {
+      showSuccessAnimation = true;
+      successAnimationFrame = 0;
+      successAnimationStartTime = now;
+      wasInTune = false;
+      inTuneStartTime = 0;
+      TRACE(TRACE_IN_TUNE, (float)inTuneWait, cents);
+      frameRecorder.event(REC_EVENT_IN_TUNE, nullptr, 0);
+      lastCents = cents;
+      return;
+    }
+    // In zone, waiting for stability - don't move servo
+    return;
+  } else {
+    // Outside tune zone - reset
+    if (wasInTune) {
+      TRACE(TRACE_IN_TUNE_LEAVE, 0.0f, cents);
+    }
+    wasInTune = false;
+    inTuneStartTime = 0;
+  }
+
+  int step = 1;
+
+  if (servoControlMode == SERVO_CTRL_ADAPTIVE) {
+    int move = adaptiveServoMove(cents, stringNum, now);
+    if (move == 0) return;  // Still settling from the last move
+    step = abs(move);
+    targetServoPos = servoPos + move;
+  } else {
+    // Rate limiting
+    if (now - lastServoMove < SERVO_MOVE_PERIOD) return;
+
+    // Calculate step size based on how far off we are
+    int absCents = abs(cents);
+
+    if (absCents > 30) step = 4;
+    else if (absCents > 20) step = 3;
+    else if (absCents > 10) step = 2;
+    else step = 1;
+
+    // Flat (negative cents) = need to tighten = increase servo angle
+    // Sharp (positive cents) = need to loosen = decrease servo angle
+    if (cents < 0) {
+      targetServoPos = servoPos + step;
+    } else {
+      targetServoPos = servoPos - step;
+    }
+  }
+
+  targetServoPos = constrain(targetServoPos, SERVO_MIN, SERVO_MAX);
+
+  // Check if approaching servo limits
+  if (targetServoPos <= SERVO_SOFT_MIN || targetServoPos >= SERVO_SOFT_MAX) {
+    // We're at the limit and still need to move
+    servoLimitReached = true;
+    needsTightenRoom = (cents < 0);  // negative cents = need to tighten more
+    waitingForConfirm = true;  // Pause tuning
+    
+    TRACE(TRACE_SERVO_LIMIT, 0.0f, cents);
+    return;
+  }
+
+  if (targetServoPos != servoPos) {
+    if (!servoMuted) {
+      attachServoIfNeeded();
+      tunerServo.write(targetServoPos);
+      uint8_t angle[2] = {(uint8_t)targetServoPos, (uint8_t)(targetServoPos >> 8)};
+      frameRecorder.event(REC_EVENT_SERVO, angle, 2);
+    }
+    int moved = targetServoPos - servoPos;
+    servoPos = targetServoPos;
+    TRACE(TRACE_SERVO_MOVE, (float)moved, cents);
+    lastServoMove = now;
+    servoCtl.pendingDeg = servoPendingDeg(now) + moved;
+    servoCtl.pendingTauMs = SERVO_SETTLE_BASE_MS + SERVO_SETTLE_PER_DEG_MS * abs(moved) +
+                            SERVO_STRING_LAG_MS;
+    servoCtl.moveAt = now;
+    servoCtl.degSinceAnchor += moved;
+  }
+
+  lastCents = cents;
+}
+
+// Moves auto-tune to string s, or past it to the first string the last
+// polyphonic check didn't find in tune; finishes after the sixth
+void autoTuneGoTo(int s) {
+  while (s < 6 && polyResultValid && polyResult.inTune[s]) {
+    Serial.printf("Skipping %s - already in tune (%.1f cents)\n",
+                  tuningModes[tuningMode].noteNames[s], polyResult.cents[s]);
+    s++;
+  }
+  autoTuneCurrentString = s;
+
+  if (autoTuneCurrentString >= 6) {
+    currentState = STATE_STANDBY;
+    autoTuneInProgress = false;
+    if (servoAttached) {
+      servoPos = SERVO_CENTER;
+      tunerServo.write(servoPos);
+      delay(200);
+      tunerServo.detach();
+      servoAttached = false;
+    }
+    drawStandbyScreen();
+    Serial.println("AUTO TUNE ALL COMPLETE");
+  } else {
+    autoTuneStringStartTime = controlMillis();
+    currentTuneStartTime = controlMillis();
+    waitingForConfirm = true;  // Wait for SELECT before tuning next string
+    trackerReset();  // New string
+    drawAutoTuneAllScreen();
+    Serial.printf("Next string: %s - press SELECT when ready\n", tuningModes[tuningMode].noteNames[autoTuneCurrentString]);
+  }
+}
+
+void checkSuccessAnimationComplete() {
+  if (showSuccessAnimation && (controlMillis() - successAnimationStartTime >= SUCCESS_DISPLAY_TIME)) {
+    showSuccessAnimation = false;
+    successAnimationFrame = 0;
+    wasInTune = false;
+
+    if (currentState == STATE_AUTO_TUNE_ALL) {
+      autoTuneGoTo(autoTuneCurrentString + 1);
+    } else if (currentState == STATE_TUNING) {
+      waitingForConfirm = true;  // Wait for SELECT before tuning next string
+      trackerReset();  // New string
+      drawTuningScreen();
+      Serial.println("String tuned - press SELECT when ready for next");
+    }
+  }
+}
+
+// ===== PITCH PIPELINE =====
+
+// Target of the current mode, -1 in AUTO
+float targetFreq() {
+  if (currentState == STATE_AUTO_TUNE_ALL) {
+    return tuningModes[tuningMode].freqs[autoTuneCurrentString];
+  } else if (currentState == STATE_TUNING && !isAutoMode && selectedString >= 0) {
+    return tuningModes[tuningMode].freqs[selectedString];
+  }
+  return -1.0f;
+}
+
+// Takes one detector result through the range clamp, the tracker, strum
+// detection, note conversion and the servo. Shared by loop() and replay;
+// freq, note, cents and stringNum are what the display shows.
+void processPitch(float expected, float rawFreq, int32_t rawLagQ15,
+                  float &freq, String &note, int &cents, int &stringNum) {
+  // Raw signal, before the clamp and the tracker
+  bool hasRawSignal = (rawFreq > 0);
+  
+  freq = rawFreq;
+
+  // Relaxed clamp - skip if using wide detection
+  if (!useWideDetection && expected > 0 && freq > 0) {
+    // For auto-tune, be stricter - only accept frequencies within 50% of target
+    // This prevents detecting other strings
+    if (currentState == STATE_AUTO_TUNE_ALL) {
+      if (freq < expected * 0.5f || freq > expected * 1.5f) {
+        freq = 0.0f;
+        hasRawSignal = false;
+      }
+    } else {
+      // For manual mode, allow wider range
+      if (freq < expected * 0.25f || freq > expected * 2.2f) {
+        freq = 0.0f;
+        hasRawSignal = false;
+      }
+    }
+  }
+  
+  // Once we get a valid signal, switch back to narrow detection
+  if (useWideDetection && hasRawSignal) {
+    useWideDetection = false;
+    TRACE(TRACE_NARROW, rawFreq, 0);
+  }
+
+  // Outlier rejection and smoothing; the track also bridges short gaps
+  // (hasRawSignal stays false for those). The fixed-point path tracks the
+  // period and reads the note from periodQ8; freq is then only for the
+  // display and the trace.
+  bool tracked;
+  int32_t periodQ8 = 0;
+  if (useFixedPointPitch) {
+    tracked = trackerUpdateLag(freq > 0 ? rawLagQ15 : 0, controlMillis());
+    periodQ8 = trackerPeriodQ8();
+  } else {
+    tracked = trackerUpdate(freq, controlMillis());
+  }
+  freq = tracked ? trackerFreq() : 0.0f;
+
+  note = "--";
+  cents = 0;
+  stringNum = -1;
+
+  // New strum: reset in-tune state on the acquisition's onset
+  uint32_t onsetNow = sampleRing.onsetCount();
+  if (onsetNow != lastOnsetCount) {
+    lastOnsetCount = onsetNow;
+    TRACE(TRACE_ONSET, 0.0f, 0);
+    wasInTune = false;
+    inTuneStartTime = 0;
+  }
+
+  if (freq > 0) {
+    {
+      PROFILE_SCOPE(PROF_NOTE);
+      if (useFixedPointPitch && (stringNum = identifyStringPeriod(periodQ8)) >= 0) {
+        periodToNote(periodQ8, stringNum, note, cents);
+      } else {
+        stringNum = identifyString(freq);
+        freqToNote(freq, note, cents);
+      }
+    }
+
+    // Always let the servo try to correct whenever there is a track (even bridged)
+    {
+      PROFILE_SCOPE(PROF_SERVO);
+      updateServoFromCents(cents, stringNum);
+    }
+
+    TRACE(TRACE_TRACK, tracker.confidence, stringNum);
+    TRACE(hasRawSignal ? TRACE_FRAME : TRACE_FRAME_HELD, freq, cents);
+  }
+  // When freq == 0, just don't move the servo (no frequency to tune to)
+}
+
+// ===== BENCHMARK =====
+
+bool offlineSavedLog = true;
+
+// Hands the sample ring and DSP buffers to an offline run (bench, selftest):
+// stops the DSP task and live acquisition, and mutes detector debug prints
+void beginOfflineRun() {
+  pausePitchTask();
+  sampleSource->end();
+  offlineSavedLog = pitchDebugLog;
+  pitchDebugLog = false;
+  offlineRunActive = true;
+}
+
+void endOfflineRun(Print &out) {
+  offlineRunActive = false;
+  pitchDebugLog = offlineSavedLog;
+  trackerReset();
+  if (!sampleSource->begin(&sampleRing)) {
+    out.println("Failed to restart sample acquisition");
+  }
+}
+
+#if CORR_ENGINE == CORR_ENGINE_FFT
+const char* CORR_ENGINE_NAME = "fft";
+#elif CORR_ENGINE == CORR_ENGINE_SLIDING
+const char* CORR_ENGINE_NAME = "sliding";
+#else
+const char* CORR_ENGINE_NAME = "direct";
+#endif
+
+// On-device counterpart of host/bench/pitch_bench.cpp, for timings on the
+// ESP32-S3 itself. Times capture + detection per frame for every detector,
+// every string of every tuning, with the AUTO lag window and with the
+// string's own window.
+// Live acquisition is paused and the ring is fed the synthetic pluck instead,
+// so the sliding engine's incremental update is included. Prints one JSON
+// object so runs can be diffed between revisions.
+void runBenchmark(int frames, Print &out) {
+  beginOfflineRun();
+
+  int savedEngine = pitchEngine;
+  float savedFreq = syntheticSource.freq;
+  bool savedGate = useOnsetGate;
+  useOnsetGate = false;  // Time the detectors on every frame, not just post-onset ones
+  uint32_t n = 0;
+
+  out.printf("{\"corr_engine\":\"%s\",\"samples\":%d,\"hop\":%d,\"frames\":%d,\"results\":[",
+             CORR_ENGINE_NAME, SAMPLES, FRAME_HOP, frames);
+
+  bool first = true;
+  for (int e = 0; e < ENGINE_COUNT; e++) {
+    pitchEngine = e;
+    for (int t = 0; t < NUM_TUNINGS; t++) {
+      for (int s = 0; s < 6; s++) {
+        for (int w = 0; w < 2; w++) {
+          float expected = w ? tuningModes[t].freqs[s] : 0.0f;
+          syntheticSource.freq = tuningModes[t].freqs[s];
+
+          // Untimed warm-up frame: fills the window and rebuilds engine state
+          for (int i = 0; i < SAMPLES; i++) sampleRing.push(syntheticSource.sampleAt(n++));
+          captureSamples();
+
+          uint32_t totalUs = 0;
+          float freq = 0.0f;
+          for (int f = 0; f < frames; f++) {
+            for (int i = 0; i < FRAME_HOP; i++) sampleRing.push(syntheticSource.sampleAt(n++));
+            unsigned long t0 = halWallMicros();
+            captureSamples();
+            freq = detectPitch(expected);
+            totalUs += halWallMicros() - t0;
+          }
+
+          out.printf("%s{\"detector\":\"%s\",\"tuning\":\"%s\",\"string\":\"%s\","
+                     "\"window\":\"%s\",\"ns_per_frame\":%lu,\"freq\":%.2f}",
+                     first ? "" : ",", PITCH_ENGINE_NAMES[e], tuningModes[t].name,
+                     tuningModes[t].noteNames[s], w ? "string" : "auto",
+                     (unsigned long)((uint64_t)totalUs * 1000 / frames), freq);
+          first = false;
         }
+      }
+    }
+  }
 
-      } else if (currentState == STATE_TUNING || currentState == STATE_AUTO_TUNE_ALL) {
-        currentState = STATE_STANDBY;
-        autoTuneInProgress = false;
-        servoPos = SERVO_CENTER;
-        targetServoPos = SERVO_CENTER;
-        hadSignal = false;
-        wasInTune = false;
-        inTuneStartTime = 0;
-        servoLimitReached = false;
-        servoReturningToCenter = false;
-        useWideDetection = false;
-        if (servoAttached) {
-          tunerServo.write(servoPos);
-          delay(200);
-          tunerServo.detach();
-          servoAttached = false;
+  // Period -> note and cents alone: float log2f path vs the lag tables
+  const int convCalls = 1000;
+  const int32_t lagStepQ15 = ((int32_t)(SAMPLING_FREQ / F_MIN - SAMPLING_FREQ / F_MAX) << 15) / convCalls;
+  const int32_t lagStartQ15 = (int32_t)(SAMPLING_FREQ / F_MAX) << 15;
+  String note;
+  int cents;
+  unsigned long t0 = halWallMicros();
+  for (int i = 0; i < convCalls; i++) {
+    freqToNote(SAMPLING_FREQ * 32768.0f / (lagStartQ15 + i * lagStepQ15), note, cents);
+  }
+  uint32_t floatUs = halWallMicros() - t0;
+  t0 = halWallMicros();
+  for (int i = 0; i < convCalls; i++) {
+    lagToNote(lagStartQ15 + i * lagStepQ15, i % 6, note, cents);
+  }
+  uint32_t fixedUs = halWallMicros() - t0;
+
+  out.printf("],\"note_float_ns\":%lu,\"note_fixed_ns\":%lu}\n",
+             (unsigned long)((uint64_t)floatUs * 1000 / convCalls),
+             (unsigned long)((uint64_t)fixedUs * 1000 / convCalls));
+
+  pitchEngine = savedEngine;
+  syntheticSource.freq = savedFreq;
+  useOnsetGate = savedGate;
+  endOfflineRun(out);
+}
+
+// ===== SELF TEST =====
+
+PluckSynth pluckSynth;
+
+const int SELFTEST_OFFSETS[] = {-50, -25, 0, 25, 50};  // cents from each string
+const float SELFTEST_SECONDS = 1.0f;                   // Length of each pluck
+const int SELFTEST_LOCK_CENTS = 50;                    // Further off = wrong harmonic
+const int SELFTEST_PLUCK_HOPS = (int)(SELFTEST_SECONDS * SAMPLING_FREQ) / FRAME_HOP;
+
+struct SelfTestStats {
+  uint32_t frames, pitched, correct, gross, locked, missed;
+  float sumAbsCents, maxAbsCents;
+  uint32_t sumFramesToLock;
+  float maxFixedDev;         // Largest fixed-point vs float cents difference
+  float maxTrackedFixedDev;  // The same after the tracker
+  // Frame-to-frame change in cents between consecutive in-lock frames: the
+  // jitter the servo would see from the raw detector and from the tracker
+  uint32_t steps, trackedSteps, tracked, trackedGross;
+  float sumSqStep, sumSqTrackedStep;
+};
+
+// Runs one take through the current detector and adds it to st. The take
+// is SAMPLES samples of lead-in, which fill the window so the sound arrives
+// mid-stream, then 'hops' hops. "correct" frames are within
+// SELFTEST_LOCK_CENTS of 'truth'; other pitched frames count as
+// octave/harmonic errors. Frames to first valid pitch count hops from the
+// start to the first correct frame.
+// Every frame is detected in both float and fixed-point mode; stats use
+// 'fixed' and maxFixedDev is the worst disagreement in cents, measured
+// against string s of tuning t. Each mode's frames also go through a pitch
+// tracker of its own, from a fresh one per take, on a clock advancing one
+// hop per frame; maxTrackedFixedDev compares the two tracks.
+void selfTestTake(const int16_t* take, int hops, float truth, int t, int s, float expected,
+                  bool fixed, int16_t* frameCopy, SelfTestStats &st) {
+  float nominal = tuningModes[t].freqs[s];
+  for (int i = 0; i < SAMPLES; i++) sampleRing.push(take[i]);
+  take += SAMPLES;
+  captureSamples();
+  PitchTrackerState floatTrack = {}, fixedTrack = {};
+  float truthCents = 1200.0f * log2f(truth / nominal);
+  float prevErr = NAN, prevTrackErr = NAN;
+
+  int lockHop = -1;
+  for (int h = 0; h < hops; h++) {
+    for (int i = 0; i < FRAME_HOP; i++) sampleRing.push(*take++);
+    captureSamples();
+    memcpy(frameCopy, sampleBuffer, SAMPLES * sizeof(int16_t));
+    useFixedPointPitch = false;
+    float freqFloat = detectPitch(expected);
+    memcpy(sampleBuffer, frameCopy, SAMPLES * sizeof(int16_t));
+    useFixedPointPitch = true;
+    float freqFixed = detectPitch(expected);
+    int32_t lagFixed = detectedLagQ15;
+    float freq = fixed ? freqFixed : freqFloat;
+
+    if (freqFloat > 0.0f && freqFixed > 0.0f) {
+      float centsFloat = 1200.0f * log2f(freqFloat / nominal);
+      float centsFixed = centsFromLagQ15(detectedLagQ15, t, s) / 256.0f;
+      float dev = fabsf(centsFixed - centsFloat);
+      if (dev > st.maxFixedDev) st.maxFixedDev = dev;
+    }
+
+    unsigned long clockMs = (unsigned long)((uint64_t)(h + 1) * FRAME_HOP * 1000 /
+                                            (uint32_t)SAMPLING_FREQ);
+    bool floatTracked = trackerUpdate(freqFloat, clockMs, floatTrack);
+    bool fixedTracked = trackerUpdateLag(lagFixed, clockMs, fixedTrack);
+    float trackedFloat = 1200.0f * log2f(trackerFreq(floatTrack) / nominal);
+    float trackedFixed = (tuningModes[t].centsQ8[s] - trackerPeriodQ8(fixedTrack)) / 256.0f;
+    if (floatTracked && fixedTracked) {
+      float dev = fabsf(trackedFixed - trackedFloat);
+      if (dev > st.maxTrackedFixedDev) st.maxTrackedFixedDev = dev;
+    }
+
+    float trackErr = NAN;
+    if (fixed ? fixedTracked : floatTracked) {
+      trackErr = (fixed ? trackedFixed : trackedFloat) - truthCents;
+      st.tracked++;
+      if (fabsf(trackErr) > SELFTEST_LOCK_CENTS) {
+        st.trackedGross++;
+        trackErr = NAN;
+      } else if (!isnan(prevTrackErr)) {
+        st.trackedSteps++;
+        st.sumSqTrackedStep += (trackErr - prevTrackErr) * (trackErr - prevTrackErr);
+      }
+    }
+    prevTrackErr = trackErr;
+
+    st.frames++;
+    float signedErr = (freq > 0.0f) ? 1200.0f * log2f(freq / truth) : NAN;
+    float err = fabsf(signedErr);
+    bool inLock = freq > 0.0f && err <= SELFTEST_LOCK_CENTS;
+    if (inLock && !isnan(prevErr)) {
+      st.steps++;
+      st.sumSqStep += (signedErr - prevErr) * (signedErr - prevErr);
+    }
+    prevErr = inLock ? signedErr : NAN;
+
+    if (freq <= 0.0f) continue;
+    st.pitched++;
+    if (err > SELFTEST_LOCK_CENTS) {
+      st.gross++;
+      continue;
+    }
+    st.correct++;
+    st.sumAbsCents += err;
+    if (err > st.maxAbsCents) st.maxAbsCents = err;
+    if (lockHop < 0) lockHop = h + 1;
+  }
+
+  if (lockHop < 0) {
+    st.missed++;
+  } else {
+    st.locked++;
+    st.sumFramesToLock += lockHop;
+  }
+}
+
+// One "results" entry. *_jitter_cents is the RMS change between consecutive
+// in-lock frames without and with the tracker.
+void printSelfTestStats(const char* detector, bool stringWindow, const SelfTestStats &st,
+                        bool first, Print &out) {
+  out.printf("%s{\"detector\":\"%s\",\"window\":\"%s\",\"plucks\":%lu,\"frames\":%lu,"
+             "\"pitched\":%lu,\"mean_abs_cents\":%.2f,\"max_abs_cents\":%.2f,"
+             "\"octave_err_rate\":%.4f,\"mean_frames_to_first_valid\":%.2f,\"missed_plucks\":%lu,"
+             "\"fixed_max_dev_cents\":%.3f,\"tracked_fixed_max_dev_cents\":%.3f,"
+             "\"jitter_cents\":%.2f,\"tracked_frames\":%lu,"
+             "\"tracked_jitter_cents\":%.2f,\"tracked_gross_rate\":%.4f}",
+             first ? "" : ",", detector, stringWindow ? "string" : "auto",
+             (unsigned long)(st.locked + st.missed), (unsigned long)st.frames,
+             (unsigned long)st.pitched,
+             st.correct ? st.sumAbsCents / st.correct : 0.0f, st.maxAbsCents,
+             st.pitched ? (float)st.gross / st.pitched : 0.0f,
+             st.locked ? (float)st.sumFramesToLock / st.locked : 0.0f,
+             (unsigned long)st.missed, st.maxFixedDev, st.maxTrackedFixedDev,
+             st.steps ? sqrtf(st.sumSqStep / st.steps) : 0.0f, (unsigned long)st.tracked,
+             st.trackedSteps ? sqrtf(st.sumSqTrackedStep / st.trackedSteps) : 0.0f,
+             st.tracked ? (float)st.trackedGross / st.tracked : 0.0f);
+}
+
+// Plucks every string of the given tunings at each offset and runs each
+// detector on the result, once with the AUTO lag window and once aimed at the
+// nominal string. If 'results' is given it receives the stats too, indexed
+// [detector * 2 + window].
+void runSelfTest(int firstTuning, int lastTuning, Print &out, SelfTestStats* results = nullptr) {
+  const int takeLen = SAMPLES + SELFTEST_PLUCK_HOPS * FRAME_HOP;
+  int16_t* frameCopy = (int16_t*)malloc(SAMPLES * sizeof(int16_t));
+  int16_t* take = (int16_t*)malloc(takeLen * sizeof(int16_t));
+  if (!frameCopy || !take) {
+    free(frameCopy);
+    free(take);
+    out.println("selftest: out of memory");
+    return;
+  }
+  beginOfflineRun();
+
+  int savedEngine = pitchEngine;
+  bool savedFixed = useFixedPointPitch;
+  const int numOffsets = sizeof(SELFTEST_OFFSETS) / sizeof(SELFTEST_OFFSETS[0]);
+
+  out.printf("{\"corr_engine\":\"%s\",\"tunings\":[", CORR_ENGINE_NAME);
+  for (int t = firstTuning; t <= lastTuning; t++) {
+    out.printf("%s\"%s\"", t == firstTuning ? "" : ",", tuningModes[t].name);
+  }
+  out.print("],\"results\":[");
+
+  for (int e = 0; e < ENGINE_COUNT; e++) {
+    pitchEngine = e;
+    for (int w = 0; w < 2; w++) {
+      SelfTestStats st = {};
+      uint32_t seed = 12345;
+
+      for (int t = firstTuning; t <= lastTuning; t++) {
+        for (int s = 0; s < 6; s++) {
+          for (int o = 0; o < numOffsets; o++) {
+            float nominal = tuningModes[t].freqs[s];
+            float truth = nominal * powf(2.0f, SELFTEST_OFFSETS[o] / 1200.0f);
+            pluckSynth.pluck(truth, seed++);
+            for (int i = 0; i < SAMPLES; i++) take[i] = pluckSynth.quiet();
+            for (int i = SAMPLES; i < takeLen; i++) take[i] = pluckSynth.next();
+            selfTestTake(take, SELFTEST_PLUCK_HOPS, truth, t, s, w ? nominal : 0.0f, savedFixed,
+                         frameCopy, st);
+          }
         }
-        drawStandbyScreen();
+      }
+
+      printSelfTestStats(PITCH_ENGINE_NAMES[e], w, st, !(e || w), out);
+      if (results) results[e * 2 + w] = st;
+    }
+  }
+  out.println("]}");
+
+  pitchEngine = savedEngine;
+  useFixedPointPitch = savedFixed;
+  endOfflineRun(out);
+  free(frameCopy);
+  free(take);
+}
+
+// ===== WAV INPUT =====
+// Recordings for the self test and the WAV sample source, read from LittleFS on the device (host
+// builds get the same File API). The ADC is 12 bits, so
+// a recording is 16-bit PCM holding 12 significant bits, left-justified as
+// usual (WAVE_FORMAT_EXTENSIBLE files may say so with 12 valid bits). Any
+// 16-bit file reads the same way. Samples are taken back down to 12 bits and
+// offset to mid-scale like the ADC; of several channels the first is used.
+// The rate must be SAMPLING_FREQ: the detector's lag tables assume it.
+
+const uint16_t WAV_FORMAT_PCM = 1;
+const uint16_t WAV_FORMAT_EXTENSIBLE = 0xFFFE;
+const float WAV_MAX_SECONDS = 30.0f;  // Longest recording "selftest wav" loads
+
+class WavReader {
+public:
+  const char* error = nullptr;  // Why begin() failed
+  uint32_t sampleRate = 0;
+  uint16_t channels = 0;
+  uint16_t validBits = 0;
+  uint32_t frames = 0;  // Samples per channel
+
+  // Reads the header up to the sample data
+  bool begin(Stream &s) {
+    in = &s;
+    error = nullptr;
+    uint8_t b[16];
+    if (!readExact(b, 12) || memcmp(b, "RIFF", 4) || memcmp(b + 8, "WAVE", 4)) {
+      return fail("not a RIFF/WAVE file");
+    }
+    bool haveFormat = false;
+    while (true) {
+      if (!readExact(b, 8)) return fail(haveFormat ? "no data chunk" : "no fmt chunk");
+      uint32_t size = le32(b + 4);
+      if (!memcmp(b, "fmt ", 4)) {
+        if (size < 16 || !readExact(b, 16)) return fail("short fmt chunk");
+        uint16_t format = le16(b);
+        channels = le16(b + 2);
+        sampleRate = le32(b + 4);
+        uint16_t bits = le16(b + 14);
+        validBits = bits;
+        uint32_t rest = size - 16;
+        if (format == WAV_FORMAT_EXTENSIBLE && rest >= 24) {
+          uint8_t ext[24];
+          if (!readExact(ext, 24)) return fail("short fmt chunk");
+          rest -= 24;
+          if (le16(ext + 2)) validBits = le16(ext + 2);
+          format = le16(ext + 8);  // First two bytes of the subformat GUID
+        }
+        if (!skip(rest + (size & 1))) return fail("short fmt chunk");
+        if (format != WAV_FORMAT_PCM) return fail("not PCM");
+        if (bits != 16 || channels == 0) return fail("not 16-bit PCM");
+        if (validBits < 12 || validBits > 16) return fail("fewer than 12 valid bits");
+        if (sampleRate != (uint32_t)SAMPLING_FREQ) return fail("sample rate is not SAMPLING_FREQ");
+        haveFormat = true;
+      } else if (!memcmp(b, "data", 4)) {
+        if (!haveFormat) return fail("data before fmt");
+        frames = size / (2 * channels);
+        left = frames;
+        return true;
+      } else if (!skip(size + (size & 1))) {
+        return fail("truncated chunk");
+      }
+    }
+  }
+
+  // Next sample of the first channel as a 12-bit ADC count
+  bool next(int16_t &raw) {
+    if (!left) return false;
+    uint8_t b[2];
+    if (!readExact(b, 2) || !skip(2 * (channels - 1))) {
+      left = 0;
+      return false;
+    }
+    left--;
+    raw = (int16_t)((int16_t)le16(b) >> 4) + 2048;
+    return true;
+  }
+
+private:
+  bool fail(const char* why) {
+    error = why;
+    return false;
+  }
+
+  bool readExact(uint8_t* buf, size_t n) {
+    return in->readBytes((char*)buf, n) == n;
+  }
+
+  bool skip(uint32_t n) {
+    uint8_t b[16];
+    while (n) {
+      size_t k = min(n, (uint32_t)sizeof(b));
+      if (!readExact(b, k)) return false;
+      n -= k;
+    }
+    return true;
+  }
+
+  static uint16_t le16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+  static uint32_t le32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+  }
+
+  Stream* in = nullptr;
+  uint32_t left = 0;
+};
+
+// Plays a recording into the ring at the sample rate in place of the ADC,
+// from the top again at the end: the live path without a guitar
+// ("source wav <path>").
+class WavSource : public TaskSampleSource {
+public:
+  const char* error = nullptr;  // Why open() or begin() failed
+
+  // Checks that 'p' is a recording WavReader can play
+  bool open(const String &p) {
+    path = p;
+    bool ok = rewind();
+    file.close();
+    return ok;
+  }
+
+  bool begin(SampleRing* r) override {
+    ring = r;
+    if (!rewind()) return false;
+    start = micros();
+    produced = 0;
+    return startTask("wav", 3072, 5);
+  }
+
+  void end() override {
+    TaskSampleSource::end();
+    file.close();
+  }
+
+protected:
+  void poll() override {
+    uint32_t due = (uint32_t)((micros() - start) / SAMPLE_PERIOD_US);
+    int16_t raw;
+    for (; produced < due; produced++) {
+      if (!wav.next(raw) && !(rewind() && wav.next(raw))) {
+        produced = due;  // The file went away; play silence from here
+        break;
+      }
+      frameRecorder.sample(raw);
+      ring->push(raw);
+    }
+    vTaskDelay(1);
+  }
+
+private:
+  bool rewind() {
+    file.close();
+    if (!LittleFS.begin(true) || !(file = LittleFS.open(path.c_str(), "r"))) {
+      error = "can't open";
+      return false;
+    }
+    if (!wav.begin(file)) {
+      error = wav.error;
+      return false;
+    }
+    if (!wav.frames) {
+      error = "no samples";
+      return false;
+    }
+    return true;
+  }
 
-      } else if (currentState == STATE_STRING_SELECT || currentState == STATE_MODE_SELECT) {
-        currentState = STATE_STANDBY;
-        drawStandbyScreen();
+  String path;
+  File file;
+  WavReader wav;
+  unsigned long start = 0;
+  uint32_t produced = 0;
+};
 
-      } else {
-        currentState = STATE_STANDBY;
-        drawStandbyScreen();
-      }
+WavSource wavSource;
+
+// "source adc|synth <hz>|wav <path>": switches what feeds the ring
+void handleSourceCommand(const String &arg, Print &out) {
+  SampleSource* next = nullptr;
+  if (arg == "adc") {
+    next = &adcSource;
+  } else if (arg.startsWith("synth ") && arg.substring(6).toFloat() > 0.0f) {
+    syntheticSource.freq = arg.substring(6).toFloat();
+    next = &syntheticSource;
+  } else if (arg.startsWith("wav ")) {
+    if (!wavSource.open(arg.substring(4))) {
+      out.printf("source: %s: %s\n", arg.substring(4).c_str(), wavSource.error);
+      return;
     }
+    next = &wavSource;
+  } else {
+    out.println("source adc|synth <hz>|wav <path>");
+    return;
   }
+  beginOfflineRun();
+  sampleSource = next;
+  endOfflineRun(out);
+  out.printf("source: %s\n", arg.c_str());
+}
 
-  if (selectAction > 0) {
-    if (selectAction == 2) {
-      if (currentState == STATE_STANDBY) {
-        currentState = STATE_MODE_SELECT;
-        drawModeSelectScreen();
-      }
+// Runs a recording of one string through every detector, as runSelfTest()
+// does a pluck, against its true pitch 'truthHz'. The lag window and the
+// fixed-point comparison use the nearest string of the current tuning.
+// The first SAMPLES samples are the lead-in. 'results' as for runSelfTest().
+void runWavSelfTest(const char* path, float truthHz, Print &out, SelfTestStats* results = nullptr) {
+  File f;
+  if (!LittleFS.begin(true) || !(f = LittleFS.open(path, "r"))) {
+    out.printf("selftest wav: can't open %s\n", path);
+    return;
+  }
+  WavReader wav;
+  if (!wav.begin(f)) {
+    out.printf("selftest wav: %s: %s\n", path, wav.error);
+    return;
+  }
+  uint32_t len = min(wav.frames, (uint32_t)(WAV_MAX_SECONDS * SAMPLING_FREQ));
+  int hops = len > SAMPLES ? (len - SAMPLES) / FRAME_HOP : 0;
+  if (hops == 0) {
+    out.printf("selftest wav: %s is shorter than one frame\n", path);
+    return;
+  }
+  len = SAMPLES + hops * FRAME_HOP;
+  size_t bytes = len * sizeof(int16_t);
+  int16_t* take = (int16_t*)(psramFound() ? ps_malloc(bytes) : malloc(bytes));
+  int16_t* frameCopy = (int16_t*)malloc(SAMPLES * sizeof(int16_t));
+  if (!take || !frameCopy) {
+    free(take);
+    free(frameCopy);
+    out.println("selftest wav: out of memory");
+    return;
+  }
+  for (uint32_t i = 0; i < len; i++) wav.next(take[i]);
+  f.close();
+
+  int s = 0;
+  for (int i = 1; i < 6; i++) {
+    if (fabsf(log2f(truthHz / tuningModes[tuningMode].freqs[i])) <
+        fabsf(log2f(truthHz / tuningModes[tuningMode].freqs[s]))) {
+      s = i;
+    }
+  }
 
-    } else if (selectAction == 1) {
-      // If tuning and waiting for confirmation, handle the flow
-      if ((currentState == STATE_TUNING || currentState == STATE_AUTO_TUNE_ALL) && waitingForConfirm) {
-        if (servoLimitReached && !servoReturningToCenter) {
-          // Step 1: Limit reached, first SELECT press -> move servo to center
-          servoReturningToCenter = true;
-          servoPos = SERVO_CENTER;
-          tunerServo.write(servoPos);
-          targetServoPos = SERVO_CENTER;
-          lastValidFreq = 0;  // Reset held frequency
-          lastValidTime = 0;
-          hadSignal = false;
-          Serial.println("SELECT pressed - servo returning to center, reposition motor then press SELECT again");
-        } else if (servoLimitReached && servoReturningToCenter) {
-          // Step 2: Servo at center, second SELECT press -> resume tuning
-          servoLimitReached = false;
-          servoReturningToCenter = false;
-          waitingForConfirm = false;
-          lastValidFreq = 0;  // Reset held frequency
-          lastValidTime = 0;
-          hadSignal = false;
-          useWideDetection = true;  // Use wider detection until we get stable signal
-          Serial.println("SELECT pressed - resuming tuning with wide detection");
-        } else {
-          // Normal start (not from limit)
-          waitingForConfirm = false;
-          servoLimitReached = false;
-          servoReturningToCenter = false;
-          lastValidFreq = 0;  // Reset held frequency
-          lastValidTime = 0;
-          hadSignal = false;
-          Serial.println("SELECT pressed - servo enabled");
+  beginOfflineRun();
+  int savedEngine = pitchEngine;
+  bool savedFixed = useFixedPointPitch;
+  out.printf("{\"corr_engine\":\"%s\",\"file\":\"%s\",\"truth_hz\":%.2f,\"string\":\"%s\","
+             "\"seconds\":%.2f,\"results\":[",
+             CORR_ENGINE_NAME, path, truthHz, tuningModes[tuningMode].noteNames[s],
+             len / (float)SAMPLING_FREQ);
+  for (int e = 0; e < ENGINE_COUNT; e++) {
+    pitchEngine = e;
+    for (int w = 0; w < 2; w++) {
+      SelfTestStats st = {};
+      selfTestTake(take, hops, truthHz, tuningMode, s, w ? tuningModes[tuningMode].freqs[s] : 0.0f,
+                   savedFixed, frameCopy, st);
+      printSelfTestStats(PITCH_ENGINE_NAMES[e], w, st, !(e || w), out);
+      if (results) results[e * 2 + w] = st;
+    }
+  }
+  out.println("]}");
+
+  pitchEngine = savedEngine;
+  useFixedPointPitch = savedFixed;
+  endOfflineRun(out);
+  free(take);
+  free(frameCopy);
+}
+
+// Strums all six strings of every tuning, each detuned by a random amount
+// within +-POLY_SELFTEST_SPREAD cents and picked low to high
+// POLY_STRUM_STAGGER apart, and checks the polyphonic analysis against the
+// truth. in_tune_agree is how often its in-tune verdict is the right one;
+// false_skips counts strings called in tune that aren't, which auto-tune
+// would wrongly skip.
+const int POLY_SELFTEST_STRUMS = 10;
+const float POLY_SELFTEST_SPREAD = 40.0f;
+const int POLY_STRUM_STAGGER = (int)(0.008 * SAMPLING_FREQ);
+
+void runPolySelfTest(Print &out) {
+  PluckSynth* synth = new PluckSynth[6];
+  if (!initPolyBuffers()) {
+    out.println("selftest poly: out of memory");
+    delete[] synth;
+    return;
+  }
+  beginOfflineRun();
+  int savedTuning = tuningMode;
+  uint32_t rng = 777;
+  auto unit = [&rng]() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return (float)(rng >> 8) / 16777216.0f;
+  };
+
+  uint32_t strings = 0, detected = 0, agree = 0, falseSkips = 0;
+  float sumAbsCents = 0.0f, maxAbsCents = 0.0f;
+  unsigned long maxUs = 0;
+
+  for (int t = 0; t < NUM_TUNINGS; t++) {
+    tuningMode = t;
+    for (int k = 0; k < POLY_SELFTEST_STRUMS; k++) {
+      float offset[6];
+      for (int s = 0; s < 6; s++) {
+        offset[s] = POLY_SELFTEST_SPREAD * (2.0f * unit() - 1.0f);
+        synth[s].pluck(tuningModes[t].freqs[s] * powf(2.0f, offset[s] / 1200.0f), rng);
+        synth[s].amplitude = 250.0f + 250.0f * unit();
+        if (s) {
+          synth[s].dcOffset = 0.0f;  // String 0 carries the offset and noise
+          synth[s].noise = 0.0f;
         }
-      } else if (currentState == STATE_STANDBY) {
-        currentState = STATE_STRING_SELECT;
-        drawStringSelectScreen();
+      }
 
-      } else if (currentState == STATE_STRING_SELECT) {
-        if (isAutoMode) {
-          isAutoMode = false;
-          selectedString = 0;
-        } else {
-          selectedString++;
-          if (selectedString > 5) {
-            isAutoMode = true;
-            selectedString = -1;
+      for (int i = 0; i < SAMPLES; i++) sampleRing.push(synth[0].quiet());
+      polyArm();
+      bool done = false;
+      for (int n = 0; !done && n < 2 * POLY_SAMPLES; ) {
+        for (int i = 0; i < FRAME_HOP; i++, n++) {
+          int32_t v = synth[0].next();
+          for (int s = 1; s < 6; s++) {
+            if (n >= s * POLY_STRUM_STAGGER) v += synth[s].next();
           }
+          sampleRing.push((int16_t)constrain(v, -32768, 32767));
         }
-        drawStringSelectScreen();
-
-      } else if (currentState == STATE_MODE_SELECT) {
-        tuningMode = (tuningMode + 1) % 4;
-        drawModeSelectScreen();
+        done = polyStep();
+      }
+      if (!done) continue;
+
+      if (polyResult.analysisUs > maxUs) maxUs = polyResult.analysisUs;
+      for (int s = 0; s < 6; s++) {
+        strings++;
+        bool inTune = fabsf(offset[s]) <= TUNE_TOLERANCE;
+        if (polyResult.inTune[s] == inTune) agree++;
+        if (polyResult.inTune[s] && !inTune) falseSkips++;
+        if (!polyResult.present[s]) continue;
+        detected++;
+        float err = fabsf(polyResult.cents[s] - offset[s]);
+        sumAbsCents += err;
+        if (err > maxAbsCents) maxAbsCents = err;
       }
     }
   }
+
+  out.printf("{\"poly_samples\":%d,\"strums\":%d,\"strings\":%lu,\"detected_rate\":%.4f,"
+             "\"mean_abs_cents\":%.2f,\"max_abs_cents\":%.2f,\"in_tune_agree\":%.4f,"
+             "\"false_skips\":%lu,\"max_analysis_us\":%lu}\n",
+             POLY_SAMPLES, POLY_SELFTEST_STRUMS * NUM_TUNINGS, (unsigned long)strings,
+             strings ? (float)detected / strings : 0.0f,
+             detected ? sumAbsCents / detected : 0.0f, maxAbsCents,
+             strings ? (float)agree / strings : 0.0f, (unsigned long)falseSkips, maxUs);
+
+  tuningMode = savedTuning;
+  polyResultValid = false;
+  polyState = POLY_IDLE;
+  endOfflineRun(out);
+  delete[] synth;
 }
 
-// ===== PITCH HELPERS =====
+// ===== REPLAY =====
 
-int identifyString(float f) {
-  if (f <= 0) return -1;
+uint8_t lastRecordedState[5];
 
-  if (currentState == STATE_AUTO_TUNE_ALL && autoTuneInProgress) {
-    return autoTuneCurrentString;
+void snapshotControlState(uint8_t v[5]) {
+  v[0] = (uint8_t)currentState;
+  v[1] = (uint8_t)tuningMode;
+  v[2] = (uint8_t)(selectedString + 1);
+  v[3] = (uint8_t)autoTuneCurrentString;
+  v[4] = (waitingForConfirm ? REC_FLAG_WAITING : 0) | (isAutoMode ? REC_FLAG_AUTO_MODE : 0) |
+         (useWideDetection ? REC_FLAG_WIDE : 0) | (autoTuneInProgress ? REC_FLAG_AUTO_TUNE : 0);
+}
+
+void applyControlState(const uint8_t v[5]) {
+  currentState = (SystemState)v[0];
+  tuningMode = v[1];
+  selectedString = (int)v[2] - 1;
+  autoTuneCurrentString = v[3];
+  waitingForConfirm = v[4] & REC_FLAG_WAITING;
+  isAutoMode = v[4] & REC_FLAG_AUTO_MODE;
+  useWideDetection = v[4] & REC_FLAG_WIDE;
+  autoTuneInProgress = v[4] & REC_FLAG_AUTO_TUNE;
+}
+
+// Called every loop(): logs the control state when it changed (always when
+// 'force'), and the servo angle along with it
+void recordControlState(bool force) {
+  if (!frameRecorder.active()) return;
+  uint8_t v[5];
+  snapshotControlState(v);
+  if (!force && memcmp(v, lastRecordedState, sizeof(v)) == 0) return;
+  memcpy(lastRecordedState, v, sizeof(v));
+  frameRecorder.event(REC_EVENT_STATE, v, sizeof(v));
+  if (force) {
+    uint8_t angle[2] = {(uint8_t)servoPos, (uint8_t)(servoPos >> 8)};
+    frameRecorder.event(REC_EVENT_SERVO, angle, 2);
   }
+}
 
-  if (!isAutoMode) return selectedString;
+// Log image: header, sample bytes, events. The same layout is used on
+// LittleFS and for "rec dump", so a host build can replay a field capture.
+bool saveRecording(Print &out) {
+  RecordHeader h = {REC_MAGIC, (uint32_t)SAMPLING_FREQ, (uint32_t)frameRecorder.sampleBytes(),
+                    (uint32_t)frameRecorder.eventCount};
+  size_t n = out.write((const uint8_t*)&h, sizeof(h));
+  n += out.write(frameRecorder.bytes, h.sampleBytes);
+  n += out.write((const uint8_t*)frameRecorder.events, h.events * sizeof(RecordEvent));
+  return n == sizeof(h) + h.sampleBytes + h.events * sizeof(RecordEvent);
+}
 
-  int best = -1;
-  float bestDiff = 1e9;
-  float* targetFreqs = tuningModes[tuningMode].freqs;
+bool loadRecording(Stream &in) {
+  RecordHeader h;
+  if (in.readBytes((char*)&h, sizeof(h)) != sizeof(h)) return false;
+  if (h.magic != REC_MAGIC || h.sampleRate != (uint32_t)SAMPLING_FREQ ||
+      h.sampleBytes > REC_SAMPLE_BYTES || h.events > (uint32_t)REC_MAX_EVENTS) {
+    return false;
+  }
+  if (!frameRecorder.alloc()) return false;
+  frameRecorder.stop();
+  if (in.readBytes((char*)frameRecorder.bytes, h.sampleBytes) != h.sampleBytes) return false;
+  size_t evBytes = h.events * sizeof(RecordEvent);
+  if (in.readBytes((char*)frameRecorder.events, evBytes) != evBytes) return false;
+  frameRecorder.setLoaded(h.sampleBytes, h.events);
+  return true;
+}
 
-  for (int i = 0; i < 6; i++) {
-    float diff = fabsf(f - targetFreqs[i]);
-    if (diff < bestDiff) {
-      bestDiff = diff;
-      best = i;
+// Writes bytes as hex, 32 per line, for "rec dump"
+class HexPrint : public Print {
+public:
+  explicit HexPrint(Print &out) : out(out) {}
+  size_t write(uint8_t b) override {
+    out.printf("%02x", b);
+    if (++col == 32) {
+      out.println();
+      col = 0;
     }
+    return 1;
+  }
+  void finish() {
+    if (col) out.println();
+  }
+
+private:
+  Print &out;
+  int col = 0;
+};
+
+// Feeds the recorded samples through the ring, the detector and
+// processPitch() on a virtual clock, as fast as the detector allows. The
+// recorded control state is applied where it was logged; the servo is muted
+// and follows the recorded angle (the audio came from those moves), so the
+// replay's own decisions are counted against the recorded ones.
+void runReplay(Print &out) {
+  if (!frameRecorder.bytes || frameRecorder.sampleBytes() == 0) {
+    out.println("replay: nothing recorded");
+    return;
   }
+  frameRecorder.stop();
+  beginOfflineRun();
+
+  // Everything processPitch() and the buttons touch, put back afterwards
+  uint8_t savedState[5];
+  snapshotControlState(savedState);
+  int savedServo = servoPos, savedTarget = targetServoPos;
+  bool savedLimit = servoLimitReached, savedReturning = servoReturningToCenter;
+  ServoControllerState savedCtl = servoCtl;
+  float savedGain[6];
+  memcpy(savedGain, servoGain, sizeof(savedGain));
+
+  servoMuted = true;
+  useVirtualClock = true;
+  virtualClockMs = 0;
+  servoCtl = ServoControllerState{-1, false, 0, 0.0f, 1.0f, false, 0.0f, 0};
+  servoLimitReached = false;
+  wasInTune = false;
+  inTuneStartTime = 0;
+  showSuccessAnimation = false;
+  trackerReset();
+  // Same starting point every run, so a capture replays identically
+  sampleRing.reset();
+  lastWindowEnd = 0;
+  lastOnsetCount = 0;
+
+  RecordReader reader = {frameRecorder.bytes, frameRecorder.bytes + frameRecorder.sampleBytes(), 0};
+  int nextEvent = 0;
+  uint32_t n = 0, frames = 0, pitched = 0;
+  uint32_t moves = 0, recordedMoves = 0, inTune = 0, recordedInTune = 0;
+  int recordedServo = servoPos;
+  int16_t raw;
+  unsigned long t0 = halWallMicros();
+
+  while (reader.next(raw)) {
+    for (; nextEvent < frameRecorder.eventCount &&
+           frameRecorder.events[nextEvent].sample <= n; nextEvent++) {
+      const RecordEvent &e = frameRecorder.events[nextEvent];
+      if (e.type == REC_EVENT_STATE) {
+        bool wasWaiting = waitingForConfirm;
+        applyControlState(e.v);
+        if (wasWaiting && !waitingForConfirm) trackerReset();  // SELECT pressed
+      } else if (e.type == REC_EVENT_SERVO) {
+        int angle = e.v[0] | (e.v[1] << 8);
+        if (angle != recordedServo && nextEvent > 0) recordedMoves++;
+        recordedServo = angle;
+      } else if (e.type == REC_EVENT_IN_TUNE) {
+        recordedInTune++;
+      }
+    }
+    servoPos = recordedServo;
+
+    sampleRing.push(raw);
+    n++;
+    virtualClockMs = (unsigned long)((uint64_t)n * 1000 / (uint32_t)SAMPLING_FREQ);
+    if (!captureSamples()) continue;
+    if (currentState != STATE_TUNING && currentState != STATE_AUTO_TUNE_ALL) continue;
+    // The success screen holds off the detector, as in loop(); what comes
+    // after it is in the recorded state
+    if (showSuccessAnimation) {
+      if (controlMillis() - successAnimationStartTime < SUCCESS_DISPLAY_TIME) continue;
+      showSuccessAnimation = false;
+      wasInTune = false;
+    }
 
-  return best;
+    frames++;
+    float expected = targetFreq();
+    float rawFreq = detectPitch(useWideDetection ? -1.0f : expected);
+    int32_t rawLagQ15 = detectedLagQ15;
+    pitchLevel = signalLevel;
+    if (rawFreq > 0) pitched++;
+
+    float freq;
+    String note;
+    int cents, stringNum;
+    processPitch(expected, rawFreq, rawLagQ15, freq, note, cents, stringNum);
+    if (servoPos != recordedServo) moves++;
+    if (showSuccessAnimation) inTune++;
+  }
+  unsigned long elapsedUs = halWallMicros() - t0;
+
+  float seconds = n / (float)SAMPLING_FREQ;
+  out.printf("{\"samples\":%lu,\"seconds\":%.2f,\"events\":%d,\"frames\":%lu,\"pitched\":%lu,"
+             "\"servo_moves\":%lu,\"recorded_servo_moves\":%lu,\"in_tune\":%lu,"
+             "\"recorded_in_tune\":%lu,\"replay_ms\":%.1f,\"speedup\":%.1f}\n",
+             (unsigned long)n, seconds, frameRecorder.eventCount, (unsigned long)frames,
+             (unsigned long)pitched, (unsigned long)moves, (unsigned long)recordedMoves,
+             (unsigned long)inTune, (unsigned long)recordedInTune, elapsedUs / 1000.0f,
+             elapsedUs ? seconds * 1e6f / elapsedUs : 0.0f);
+
+  applyControlState(savedState);
+  servoPos = savedServo;
+  targetServoPos = savedTarget;
+  servoLimitReached = savedLimit;
+  servoReturningToCenter = savedReturning;
+  servoCtl = savedCtl;
+  memcpy(servoGain, savedGain, sizeof(savedGain));
+  wasInTune = false;
+  inTuneStartTime = 0;
+  showSuccessAnimation = false;
+  servoMuted = false;
+  useVirtualClock = false;
+  lastOnsetCount = sampleRing.onsetCount();
+  endOfflineRun(out);
 }
 
-void freqToNote(float f, String &name, int &cents) {
-  if (f <= 0) { name = "--"; cents = 0; return; }
-
-  float midi = 69.0f + 12.0f * log2f(f / 440.0f);
-  int noteNum = roundf(midi);
-  int idx = noteNum % 12;
-  if (idx < 0) idx += 12;
-  name = NOTE_NAMES[idx];
-
-  int stringNum = identifyString(f);
-  if (stringNum >= 0) {
-    float targetFreq = tuningModes[tuningMode].freqs[stringNum];
-    cents = roundf(1200.0f * log2f(f / targetFreq));
+void handleRecordCommand(const String &arg, Print &out) {
+  if (arg == "start") {
+    if (!frameRecorder.start()) {
+      out.println("rec: out of memory");
+      return;
+    }
+    recordControlState(true);
+    out.println("rec: recording");
+  } else if (arg == "stop") {
+    frameRecorder.stop();
+    out.printf("rec: %lu samples, %u bytes, %d events%s\n",
+               (unsigned long)frameRecorder.sampleCount(), (unsigned)frameRecorder.sampleBytes(),
+               frameRecorder.eventCount, frameRecorder.overflowed() ? " (buffer full)" : "");
+  } else if (arg == "save") {
+    frameRecorder.stop();
+    File f;
+    bool ok = frameRecorder.bytes && LittleFS.begin(true) && (f = LittleFS.open(REC_PATH, "w"));
+    if (ok) {
+      ok = saveRecording(f);
+      f.close();
+    }
+    out.println(ok ? "rec: saved" : "rec: save failed");
+  } else if (arg == "load") {
+    File f;
+    bool ok = LittleFS.begin(true) && (f = LittleFS.open(REC_PATH, "r"));
+    if (ok) {
+      ok = loadRecording(f);
+      f.close();
+    }
+    out.println(ok ? "rec: loaded" : "rec: load failed");
+  } else if (arg == "dump") {
+    if (!frameRecorder.bytes) {
+      out.println("rec: nothing recorded");
+      return;
+    }
+    frameRecorder.stop();
+    out.println("rec: begin");
+    HexPrint hex(out);
+    saveRecording(hex);
+    hex.finish();
+    out.println("rec: end");
   } else {
-    float fNote = 440.0f * powf(2.0f, (noteNum - 69) / 12.0f);
-    cents = roundf(1200.0f * log2f(f / fNote));
+    out.println("rec: start|stop|save|load|dump");
   }
 }
 
-// ===== SERVO CONTROL =====
+// ===== SYSTEM SIMULATOR =====
+
+// Runs auto-tune-all end to end on the virtual clock against a model of the
+// guitar: the button script stands in for the user, a string-tension model
+// turns the servo angle into pitch, and an additive tone feeds the ring as
+// the piezo would (sim_model.h; host/sim/tuner_sim.cpp plays the same
+// scenarios through setup() and loop() on Linux). The servo is muted and the display only shows the screen
+// changes, so a run takes seconds; the report (time-to-tune and servo
+// travel per string) lets controller and detector changes be compared on
+// the same seeded scenarios.
+const unsigned long SIM_TICK_MS = 10;           // One controlStep() per tick
+const unsigned long SIM_SELECT_DELAY = 500;     // User presses SELECT this long after the prompt
+const unsigned long SIM_PLUCK_DELAY = 100;      // ...and plucks this long after SELECT
+const unsigned long SIM_REPLUCK_PERIOD = 3000;  // Re-plucks while the servo works
+const unsigned long SIM_RECENTER_DELAY = 1000;  // Repositioning the motor at the limit
+
+void controlStep();
+
+struct SimResult {
+  float detune, gain;
+  bool tuned;
+  unsigned long tuneMs;  // SELECT to the success screen
+  int travel;            // Degrees, recenters excluded
+  int moves, limits;
+  float finalCents;      // True error the string settles at after the last move
+};
 
-void attachServoIfNeeded() {
-  if (!servoAttached) {
-    tunerServo.attach(SERVO_PIN, 500, 2500);
-    servoAttached = true;
-    delay(50);
+// Auto-tunes all six strings of the current tuning once. Strings get a
+// random detune (+-60 cents), gain (3-8 c/deg) and lag from 'seed'. Returns
+// the virtual run time in ms.
+unsigned long simulateAutoTune(uint32_t seed, SimResult results[6]) {
+  SimRng rng(seed);
+  SimString strings[6];
+  simDrawStrings(rng, tuningModes[tuningMode].freqs, strings);
+  for (int s = 0; s < 6; s++) {
+    results[s] = SimResult{strings[s].detune, strings[s].gain, false, 0, 0, 0, 0, 0.0f};
   }
-}
+  SimTone tone;
+  tone.rng = rng.state;
+
+  // Controller state a fresh power-up would have
+  currentState = STATE_STANDBY;
+  servoPos = targetServoPos = SERVO_CENTER;
+  servoLimitReached = servoReturningToCenter = false;
+  useWideDetection = false;
+  showSuccessAnimation = false;
+  servoCtl = ServoControllerState{-1, false, 0, 0.0f, 1.0f, false, 0.0f, 0};
+  for (int s = 0; s < 6; s++) servoGain[s] = SERVO_GAIN_INIT;
+  trackerReset();
+  sampleRing.reset();
+  lastWindowEnd = 0;
+  lastOnsetCount = 0;
+
+  uint32_t n = 0;
+  int cur = -1;
+  bool wasWaiting = false;
+  unsigned long selectDue = 0, pluckDue = 0, lastPluck = 0;
+  unsigned long stringStart = 0, selectAt = 0;
+  int lastServo = servoPos;
+  const unsigned long limitMs = 200 + 6 * (AUTO_TUNE_TIMEOUT + 4000);
+
+  for (unsigned long now = 0; now < limitMs; now += SIM_TICK_MS) {
+    virtualClockMs = now;
+
+    // --- Button script ---
+    if (now == 200) handleButtonActions(2, 0);  // Long TOGGLE: auto-tune all
+    if (now > 200 && currentState != STATE_AUTO_TUNE_ALL) break;
 
-void detachServoIfNeeded() {
-  if (servoAttached && currentState != STATE_TUNING && currentState != STATE_AUTO_TUNE_ALL) {
-    tunerServo.detach();
-    servoAttached = false;
-  }
-}
+    if (currentState == STATE_AUTO_TUNE_ALL) {
+      int s = autoTuneCurrentString;
+      if (s != cur) {
+        cur = s;
+        strings[s].engage(servoPos);
+        stringStart = now;
+        selectAt = 0;
+        selectDue = now + SIM_SELECT_DELAY;
+        wasWaiting = true;
+      }
+      if (waitingForConfirm && !wasWaiting && !showSuccessAnimation) {
+        selectDue = now + SIM_SELECT_DELAY;  // Stopped at the servo limit
+      }
 
-void updateServoFromCents(int cents) {
-  if (currentState != STATE_TUNING && currentState != STATE_AUTO_TUNE_ALL) return;
-  
-  // Don't move servo until user presses SELECT
-  if (waitingForConfirm) return;
+      if (selectDue && now >= selectDue) {
+        bool recenter = servoLimitReached && !servoReturningToCenter;
+        int before = servoPos;
+        handleButtonActions(0, 1);
+        strings[s].shift(servoPos - before);
+        lastServo = servoPos;
+        if (recenter) {
+          results[s].limits++;
+          selectDue = now + SIM_RECENTER_DELAY;
+        } else {
+          selectDue = 0;
+          pluckDue = now + SIM_PLUCK_DELAY;
+          if (!selectAt) selectAt = now;
+        }
+      }
 
-  unsigned long now = millis();
+      if (pluckDue && now >= pluckDue) {
+        tone.pluck();
+        lastPluck = now;
+        pluckDue = 0;
+      } else if (!waitingForConfirm && !showSuccessAnimation && selectAt &&
+                 now - lastPluck >= SIM_REPLUCK_PERIOD) {
+        tone.pluck();
+        lastPluck = now;
+      }
 
-  // In-tune detection with stability requirement
-  if (abs(cents) <= TUNE_TOLERANCE) {
-    if (!wasInTune) {
-      inTuneStartTime = now;
-      wasInTune = true;
-      Serial.println("Entered in tune zone...");
-    } else if (now - inTuneStartTime >= IN_TUNE_DURATION) {
-      showSuccessAnimation = true;
-      successAnimationFrame = 0;
-      successAnimationStartTime = now;
-      wasInTune = false;
-      inTuneStartTime = 0;
-      Serial.printf("IN TUNE (held for %lums at %d cents)\n", IN_TUNE_DURATION, cents);
-      lastCents = cents;
-      return;
+      if (showSuccessAnimation && !results[s].tuned) {
+        results[s].tuned = true;
+        results[s].tuneMs = now - selectAt;
+        results[s].finalCents = strings[s].settledCents(servoPos);
+      }
+
+      // The firmware leaves a stuck string to the user; the script gives up
+      if (!results[s].tuned && now - stringStart >= AUTO_TUNE_TIMEOUT) {
+        results[s].finalCents = strings[s].settledCents(servoPos);
+        autoTuneGoTo(s + 1);
+        continue;
+      }
+      wasWaiting = waitingForConfirm;
     }
-    // In zone, waiting for stability - don't move servo
-    return;
-  } else {
-    // Outside tune zone - reset
-    if (wasInTune) {
-      Serial.println("Left in tune zone, resetting");
+
+    // --- Plant and signal for this tick ---
+    float hz = 0.0f;
+    if (cur >= 0) {
+      SimString &str = strings[cur];
+      str.follow(servoPos, (float)SIM_TICK_MS);
+      hz = str.hz();
     }
-    wasInTune = false;
-    inTuneStartTime = 0;
-  }
+    uint32_t end = (uint32_t)((uint64_t)(now + SIM_TICK_MS) * (uint32_t)SAMPLING_FREQ / 1000);
+    for (; n < end; n++) sampleRing.push(tone.next(hz));
+    virtualClockMs = now + SIM_TICK_MS;
 
-  // Rate limiting
-  if (now - lastServoMove < SERVO_MOVE_PERIOD) return;
+    controlStep();
 
-  // Calculate step size based on how far off we are
-  int step = 1;
-  int absCents = abs(cents);
+    if (cur >= 0 && servoPos != lastServo) {
+      results[cur].travel += abs(servoPos - lastServo);
+      results[cur].moves++;
+      lastServo = servoPos;
+    }
+  }
+  return virtualClockMs;
+}
 
-  if (absCents > 30) step = 4;
-  else if (absCents > 20) step = 3;
-  else if (absCents > 10) step = 2;
-  else step = 1;
+// Totals over the runs of one "sim" report
+struct SimTotals {
+  int runs, tuned, failed, travel;
+  float tuneMs, absCents;
+  double virtualMs;
+};
 
-  // Flat (negative cents) = need to tighten = increase servo angle
-  // Sharp (positive cents) = need to loosen = decrease servo angle
-  if (cents < 0) {
-    targetServoPos = servoPos + step;
-  } else {
-    targetServoPos = servoPos - step;
+// One JSON line for run 'run' of 'ms' virtual ms, added into 'totals'
+void printSimRun(int run, unsigned long ms, const SimResult res[6], SimTotals &totals, Print &out) {
+  totals.runs++;
+  totals.virtualMs += ms;
+  out.printf("{\"run\":%d,\"virtual_s\":%.1f,\"strings\":[", run, ms / 1000.0f);
+  for (int s = 0; s < 6; s++) {
+    out.printf("%s{\"string\":\"%s\",\"detune\":%.1f,\"gain\":%.2f,\"tuned\":%s,"
+               "\"tune_ms\":%lu,\"travel\":%d,\"moves\":%d,\"limits\":%d,\"final_cents\":%.1f}",
+               s ? "," : "", tuningModes[tuningMode].noteNames[s], res[s].detune, res[s].gain,
+               res[s].tuned ? "true" : "false", res[s].tuneMs, res[s].travel, res[s].moves,
+               res[s].limits, res[s].finalCents);
+    totals.travel += res[s].travel;
+    if (res[s].tuned) {
+      totals.tuned++;
+      totals.tuneMs += res[s].tuneMs;
+      totals.absCents += fabsf(res[s].finalCents);
+    } else {
+      totals.failed++;
+    }
   }
+  out.println("]}");
+}
 
-  targetServoPos = constrain(targetServoPos, SERVO_MIN, SERVO_MAX);
+// The summary line; 'elapsedUs' is the real time the runs took
+void printSimSummary(const SimTotals &t, unsigned long elapsedUs, Print &out) {
+  out.printf("{\"runs\":%d,\"servo_mode\":\"%s\",\"tuned\":%d,\"failed\":%d,\"mean_tune_ms\":%.0f,"
+             "\"mean_travel\":%.1f,\"mean_abs_cents\":%.2f,\"virtual_s\":%.1f,\"wall_ms\":%.1f,"
+             "\"speedup\":%.1f}\n",
+             t.runs, servoControlMode == SERVO_CTRL_ADAPTIVE ? "adaptive" : "step", t.tuned,
+             t.failed, t.tuned ? t.tuneMs / t.tuned : 0.0f,
+             t.runs ? (float)t.travel / (6 * t.runs) : 0.0f, t.tuned ? t.absCents / t.tuned : 0.0f,
+             t.virtualMs / 1000.0, elapsedUs / 1000.0f,
+             elapsedUs ? t.virtualMs * 1000.0 / elapsedUs : 0.0);
+}
 
-  // Check if approaching servo limits
-  if (targetServoPos <= SERVO_SOFT_MIN || targetServoPos >= SERVO_SOFT_MAX) {
-    // We're at the limit and still need to move
-    servoLimitReached = true;
-    needsTightenRoom = (cents < 0);  // negative cents = need to tighten more
-    waitingForConfirm = true;  // Pause tuning
-    
-    Serial.printf("SERVO LIMIT REACHED - need to %s more, press SELECT to reposition\n", 
-                  needsTightenRoom ? "tighten" : "loosen");
+// "sim [runs]": one JSON line per run, then a summary. Starts from standby;
+// the servo gains learned so far and the live state are put back afterwards.
+void runSimulation(int runs, Print &out) {
+  if (currentState != STATE_STANDBY) {
+    out.println("sim: go to standby first");
     return;
   }
-
-  if (targetServoPos != servoPos) {
-    attachServoIfNeeded();
-    tunerServo.write(targetServoPos);
-    Serial.printf("Servo: %d -> %d (cents: %d, step: %d)\n",
-                  servoPos, targetServoPos, cents, step);
-    servoPos = targetServoPos;
-    lastServoMove = now;
+  frameRecorder.stop();
+  beginOfflineRun();
+
+  uint8_t savedState[5];
+  snapshotControlState(savedState);
+  ServoControllerState savedCtl = servoCtl;
+  float savedGain[6];
+  memcpy(savedGain, servoGain, sizeof(savedGain));
+  servoMuted = true;
+  useVirtualClock = true;
+
+  SimTotals totals = {0, 0, 0, 0, 0.0f, 0.0f, 0.0};
+  unsigned long t0 = halWallMicros();
+  for (int r = 0; r < runs; r++) {
+    SimResult res[6];
+    unsigned long ms = simulateAutoTune(1000 + r, res);
+    printSimRun(r, ms, res, totals, out);
   }
-
-  lastCents = cents;
+  printSimSummary(totals, halWallMicros() - t0, out);
+
+  applyControlState(savedState);
+  currentState = STATE_STANDBY;
+  servoPos = targetServoPos = SERVO_CENTER;
+  servoLimitReached = servoReturningToCenter = false;
+  useWideDetection = false;
+  showSuccessAnimation = false;
+  servoCtl = savedCtl;
+  memcpy(servoGain, savedGain, sizeof(savedGain));
+  wasInTune = false;
+  inTuneStartTime = 0;
+  polyState = POLY_IDLE;
+  servoMuted = false;
+  useVirtualClock = false;
+  lastOnsetCount = sampleRing.onsetCount();
+  drawStandbyScreen();
+  endOfflineRun(out);
 }
 
-void checkSuccessAnimationComplete() {
-  if (showSuccessAnimation && (millis() - successAnimationStartTime >= SUCCESS_DISPLAY_TIME)) {
-    showSuccessAnimation = false;
-    successAnimationFrame = 0;
-    wasInTune = false;
-    hadSignal = false;
+// ===== SERIAL COMMANDS =====
 
-    if (currentState == STATE_AUTO_TUNE_ALL) {
-      autoTuneCurrentString++;
+void handleSerialCommands() {
+  if (!Serial.available()) return;
 
-      if (autoTuneCurrentString >= 6) {
-        currentState = STATE_STANDBY;
-        autoTuneInProgress = false;
-        if (servoAttached) {
-          servoPos = SERVO_CENTER;
-          tunerServo.write(servoPos);
-          delay(200);
-          tunerServo.detach();
-          servoAttached = false;
-        }
-        drawStandbyScreen();
-        Serial.println("AUTO TUNE ALL COMPLETE");
-      } else {
-        autoTuneStringStartTime = millis();
-        currentTuneStartTime = millis();
-        waitingForConfirm = true;  // Wait for SELECT before tuning next string
-        lastValidFreq = 0;  // Reset held frequency for new string
-        lastValidTime = 0;  // Reset hold timer
-        drawAutoTuneAllScreen();
-        Serial.printf("Next string: %s - press SELECT when ready\n", tuningModes[tuningMode].noteNames[autoTuneCurrentString]);
-      }
-    } else if (currentState == STATE_TUNING) {
-      waitingForConfirm = true;  // Wait for SELECT before tuning next string
-      lastValidFreq = 0;  // Reset held frequency for new string
-      lastValidTime = 0;  // Reset hold timer
-      drawTuningScreen();
-      Serial.println("String tuned - press SELECT when ready for next");
+  String cmd = Serial.readStringUntil('\n');
+  cmd.trim();
+
+  if (cmd.startsWith("ppm ")) {
+    String which = cmd.substring(4);
+    CanvasRegion* r = nullptr;
+    if (which == "meter") r = &meterRegion;
+    else if (which == "note") r = &noteRegion;
+    else if (which == "status") r = &statusRegion;
+    if (r && r->canvas) {
+      dumpCanvasPPM(r->canvas, Serial);
+    } else {
+      Serial.println("ppm: no such canvas (meter|note|status)");
+    }
+  } else if (cmd == "bench" || cmd.startsWith("bench ")) {
+    int frames = (cmd.length() > 6) ? cmd.substring(6).toInt() : 20;
+    runBenchmark(max(frames, 1), Serial);
+  } else if (cmd == "selftest") {
+    runSelfTest(tuningMode, tuningMode, Serial);
+  } else if (cmd == "selftest all") {
+    runSelfTest(0, NUM_TUNINGS - 1, Serial);
+  } else if (cmd == "selftest poly") {
+    runPolySelfTest(Serial);
+  } else if (cmd.startsWith("selftest wav ")) {
+    // selftest wav <path> <true pitch in Hz>
+    String arg = cmd.substring(13);
+    int sp = arg.indexOf(' ');
+    float hz = sp > 0 ? arg.substring(sp + 1).toFloat() : 0.0f;
+    if (hz > 0.0f) {
+      runWavSelfTest(arg.substring(0, sp).c_str(), hz, Serial);
+    } else {
+      Serial.println("selftest wav <path> <hz>");
+    }
+  } else if (cmd.startsWith("rec")) {
+    handleRecordCommand(cmd.length() > 4 ? cmd.substring(4) : String(), Serial);
+  } else if (cmd.startsWith("source")) {
+    handleSourceCommand(cmd.length() > 7 ? cmd.substring(7) : String(), Serial);
+  } else if (cmd == "replay") {
+    runReplay(Serial);
+  } else if (cmd == "sim" || cmd.startsWith("sim ")) {
+    int runs = (cmd.length() > 4) ? cmd.substring(4).toInt() : 1;
+    runSimulation(max(runs, 1), Serial);
+  } else if (cmd == "prof" || cmd == "prof reset") {
+#if PROFILE
+    if (cmd == "prof") printProfile(Serial);
+    else profileReset();
+#else
+    Serial.println("profiling disabled");
+#endif
+  } else if (cmd == "trace off") {
+    traceOutput = TRACE_OUT_OFF;
+  } else if (cmd == "trace text") {
+    traceOutput = TRACE_OUT_TEXT;
+  } else if (cmd == "trace csv") {
+    traceOutput = TRACE_OUT_CSV;
+    Serial.println("us,event,servo,cents,value,level");
+  } else if (cmd == "trace bin") {
+    traceOutput = TRACE_OUT_BIN;
+  } else if (cmd == "poly") {
+    if (polyArm()) {
+      polyRequested = true;
+      Serial.println("poly: strum all strings");
+    } else {
+      Serial.println("poly: out of memory");
     }
   }
 }
@@ -1079,9 +4127,28 @@ void setup() {
     while (1) delay(1000);
   }
 
+  if (!initCorrelationEngine()) {
+    Serial.println("Correlation engine allocation failed");
+    while (1) delay(1000);
+  }
+
   analogReadResolution(12);
   analogSetAttenuation(ADC_6db);
 
+  if (!sampleSource->begin(&sampleRing)) {
+    Serial.println("Sample acquisition failed to start");
+    while (1) delay(1000);
+  }
+
+  if (!startDspTask()) {
+    Serial.println("DSP task failed to start");
+    while (1) delay(1000);
+  }
+
+  if (!startTraceTask()) {
+    Serial.println("Trace task failed to start");
+  }
+
   SPI.begin(TFT_CLK, -1, TFT_MOSI, TFT_CS);
   delay(100);
 
@@ -1093,6 +4160,7 @@ void setup() {
   tft.sendCommand(ST77XX_MADCTL, &madctl, 1);
 
   tft.fillScreen(COLOR_BG);
+  initCanvases();
 
   pinMode(TFT_BL, OUTPUT);
   digitalWrite(TFT_BL, HIGH);
@@ -1114,108 +4182,82 @@ void setup() {
 
 void loop() {
   handleButtons();
+  handleSerialCommands();
+  controlStep();
+}
 
-  if (currentState == STATE_TUNING || currentState == STATE_AUTO_TUNE_ALL) {
-    attachServoIfNeeded();
-    checkSuccessAnimationComplete();
-
-    if (!showSuccessAnimation) {
-      float expected = -1.0f;
-      if (currentState == STATE_AUTO_TUNE_ALL) {
-        expected = tuningModes[tuningMode].freqs[autoTuneCurrentString];
-      } else if (currentState == STATE_TUNING && !isAutoMode && selectedString >= 0) {
-        expected = tuningModes[tuningMode].freqs[selectedString];
-      }
-      
-      // After limit reset, use wide detection (no expected) until we get signal
-      float detectExpected = expected;
-      if (useWideDetection) {
-        detectExpected = -1.0f;  // Auto-detect any frequency
-      }
-
-      captureSamples();
-      float rawFreq = detectPitchAutocorrelation(detectExpected);
-      
-      // Track raw signal for strum detection (before hold logic)
-      bool hasRawSignal = (rawFreq > 0);
-      
-      float freq = rawFreq;
-
-      // Relaxed clamp - skip if using wide detection
-      if (!useWideDetection && expected > 0 && freq > 0) {
-        // For auto-tune, be stricter - only accept frequencies within 50% of target
-        // This prevents detecting other strings
-        if (currentState == STATE_AUTO_TUNE_ALL) {
-          if (freq < expected * 0.5f || freq > expected * 1.5f) {
-            freq = 0.0f;
-            hasRawSignal = false;
-          }
-        } else {
-          // For manual mode, allow wider range
-          if (freq < expected * 0.25f || freq > expected * 2.2f) {
-            freq = 0.0f;
-            hasRawSignal = false;
-          }
-        }
-      }
-      
-      // Once we get a valid signal, switch back to narrow detection
-      if (useWideDetection && hasRawSignal) {
-        useWideDetection = false;
-        Serial.println("Got signal - switching back to narrow detection");
-      }
-
-      // Hold logic for display smoothing only
-      if (freq > 0) {
-        lastValidFreq = freq;
-        lastValidTime = millis();
-      } else if (millis() - lastValidTime < HOLD_TIME) {
-        freq = lastValidFreq;
-        // Note: hasRawSignal stays false here - this is key!
-      }
-
-      String note = "--";
-      int cents = 0;
-      int stringNum = -1;
-
-      // Detect new strum based on RAW signal for state reset
-      if (hasRawSignal && !hadSignal) {
-        Serial.println(">>> NEW STRUM DETECTED - resetting state <<<");
-        wasInTune = false;
-        inTuneStartTime = 0;
+// Everything loop() does after the buttons. Offline runs (the simulator)
+// call it on the virtual clock: the display, servo hardware and loop delay
+// are skipped and pitch is detected inline.
+void controlStep() {
+  // Polyphonic check: while auto-tune waits for SELECT, a strum of all
+  // strings skips the ones already in tune
+  bool autoTuneWaiting = currentState == STATE_AUTO_TUNE_ALL && autoTuneInProgress &&
+                         waitingForConfirm && !showSuccessAnimation;
+  if (autoTuneWaiting) {
+    if (polyState == POLY_IDLE) polyArm();
+  } else if (!polyRequested) {
+    polyState = POLY_IDLE;
+  }
+  recordControlState(false);
+
+  if (polyStep()) {
+    polyRequested = false;
+    if (!offlineRunActive) printPolyResult(Serial);
+    if (autoTuneWaiting) {
+      if (polyResult.inTune[autoTuneCurrentString]) {
+        autoTuneGoTo(autoTuneCurrentString);
+      } else {
+        drawAutoTuneBoxes();
       }
-      hadSignal = hasRawSignal;
-
-      if (freq > 0) {
-        freqToNote(freq, note, cents);
-        stringNum = identifyString(freq);
+    }
+  }
 
-        // Always let the servo try to correct whenever we have a frequency (even held)
-        updateServoFromCents(cents);
+  if (currentState == STATE_TUNING || currentState == STATE_AUTO_TUNE_ALL) {
+    if (!servoMuted) attachServoIfNeeded();
+    checkSuccessAnimationComplete();
 
-        static unsigned long lastPrint = 0;
-        if (millis() - lastPrint > 200) {
-          Serial.printf("Freq: %.1f Hz | String: %d | Cents: %d | Signal: %.0f | Raw: %s\n",
-                        freq, stringNum, cents, signalLevel, hasRawSignal ? "YES" : "held");
-          lastPrint = millis();
+    float expected = targetFreq();
+
+    // After limit reset, use wide detection (no expected) until we get signal
+    float detectExpected = useWideDetection ? -1.0f : expected;
+
+    // Only process when a fresh pitch estimate is available;
+    // buttons and the servo keep running in the meantime.
+    float rawFreq = 0.0f;
+    int32_t rawLagQ15 = 0;
+    if (!showSuccessAnimation && fetchPitch(detectExpected, rawFreq, rawLagQ15, pitchLevel)) {
+      float freq;
+      String note;
+      int cents, stringNum;
+      processPitch(expected, rawFreq, rawLagQ15, freq, note, cents, stringNum);
+      if (offlineRunActive) return;
+
+      {
+        PROFILE_SCOPE(PROF_DISPLAY);
+        uint32_t sentBefore = tft.pixelCount();
+        if (currentState == STATE_TUNING) {
+          updateTuningDisplay(freq, note, cents, stringNum);
+        } else if (currentState == STATE_AUTO_TUNE_ALL) {
+          updateAutoTuneDisplay(freq, cents);
         }
+        uiPixelsPushed = tft.pixelCount() - sentBefore;
       }
-      // When freq == 0, just don't move the servo (no frequency to tune to)
-
-      if (currentState == STATE_TUNING) {
-        updateTuningDisplay(freq, note, cents, stringNum);
-      } else if (currentState == STATE_AUTO_TUNE_ALL) {
-        updateAutoTuneDisplay(freq, cents);
-      }
+      TRACE(TRACE_DISPLAY, (float)uiPixelsPushed, 0);
     }
 
+    if (offlineRunActive) return;
     if (showSuccessAnimation) {
       drawSuccessAnimation();
     }
 
-    delay(10);
+    {
+      PROFILE_SCOPE(PROF_LOOP_DELAY);
+      delay(10);
+    }
     yield();
-  } else {
+  } else if (!offlineRunActive) {
+    stopPitchTask();
     detachServoIfNeeded();
     delay(20);
     yield();
@@ -0,0 +1,156 @@
+// Host benchmark for the pitch detectors, the counterpart of the sketch's
+// "bench" command. Times capture + detection per frame for every detector,
+// every string of every tuning, with the AUTO lag window and with the
+// string's own window, plus period -> note and cents on the float and lag
+// table paths. The direct engine's AUTOCORR also runs AUTO without the
+// coarse-to-fine search ("auto_full_scan"), the exhaustive scan it
+// replaces. Built once per CORR_ENGINE (pitch_bench_direct, _fft,
+// _sliding); --benchmark_format=json gives ns per frame as real_time.
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "pitch_dsp.h"
+
+namespace {
+
+#if CORR_ENGINE == CORR_ENGINE_FFT
+const char* const CORR_ENGINE_NAME = "fft";
+#elif CORR_ENGINE == CORR_ENGINE_SLIDING
+const char* const CORR_ENGINE_NAME = "sliding";
+#else
+const char* const CORR_ENGINE_NAME = "direct";
+#endif
+
+// Feeds the synthetic pluck into the ring as the acquisition would. The
+// pluck repeats every second, so one second of it is computed up front and
+// the untimed part of each iteration stays short.
+struct PluckFeed {
+  std::vector<int16_t> period;
+  uint32_t n = 0;
+
+  explicit PluckFeed(float freq) : period((uint32_t)SAMPLING_FREQ) {
+    for (uint32_t i = 0; i < period.size(); i++) period[i] = syntheticSample(freq, i);
+  }
+
+  void push(int count) {
+    for (int i = 0; i < count; i++) sampleRing.push(period[n++ % period.size()]);
+  }
+};
+
+// Fresh ring and engine state, one full window already captured
+void startFeed(PluckFeed &feed) {
+  sampleRing.reset();
+  lastWindowEnd = 0;
+  feed.push(SAMPLES);
+  captureSamples();
+}
+
+// Only capture + detection are timed; pushing the hop into the ring stands
+// in for the acquisition task and is left out, as on the device
+void BM_Detect(benchmark::State &state, int engine, int tuning, int string, bool stringWindow,
+               bool coarse) {
+  pitchEngine = engine;
+  useCoarseSearch = coarse;
+  useOnsetGate = false;  // Time the detectors on every frame, not just post-onset ones
+  float truth = tuningModes[tuning].freqs[string];
+  float expected = stringWindow ? truth : 0.0f;
+  PluckFeed feed(truth);
+  startFeed(feed);
+
+  int64_t pitched = 0, octaveErrors = 0;
+  for (auto _ : state) {
+    feed.push(FRAME_HOP);
+    auto t0 = std::chrono::steady_clock::now();
+    captureSamples();
+    float freq = detectPitch(expected);
+    benchmark::DoNotOptimize(freq);
+    auto t1 = std::chrono::steady_clock::now();
+    state.SetIterationTime(std::chrono::duration<double>(t1 - t0).count());
+    if (freq > 0.0f) {
+      pitched++;
+      if (fabsf(1200.0f * log2f(freq / truth)) > 50.0f) octaveErrors++;
+    }
+  }
+  // Sanity check on what was timed: share of frames with a pitch, and of
+  // those, the share more than 50 cents from the truth
+  state.counters["pitched"] = benchmark::Counter((double)pitched, benchmark::Counter::kAvgIterations);
+  state.counters["octave_err"] = pitched ? (double)octaveErrors / pitched : 0.0;
+}
+
+// Periods spread evenly over F_MAX..F_MIN, as the detector would report them
+std::vector<int32_t> notePeriods() {
+  const int count = 1000;
+  const int32_t startQ15 = (int32_t)(SAMPLING_FREQ / F_MAX) << 15;
+  const int32_t stepQ15 =
+      ((int32_t)(SAMPLING_FREQ / F_MIN - SAMPLING_FREQ / F_MAX) << 15) / count;
+  std::vector<int32_t> lags(count);
+  for (int i = 0; i < count; i++) lags[i] = startQ15 + i * stepQ15;
+  return lags;
+}
+
+void BM_NoteFloat(benchmark::State &state) {
+  std::vector<int32_t> lags = notePeriods();
+  const char* name;
+  int cents;
+  size_t i = 0;
+  for (auto _ : state) {
+    float freq = SAMPLING_FREQ * 32768.0f / lags[i];
+    freqToNote(freq, 0, (int)(i % 6), name, cents);
+    benchmark::DoNotOptimize(cents);
+    if (++i == lags.size()) i = 0;
+  }
+}
+
+void BM_NoteFixed(benchmark::State &state) {
+  std::vector<int32_t> lags = notePeriods();
+  const char* name;
+  int cents;
+  size_t i = 0;
+  for (auto _ : state) {
+    lagToNote(lags[i], 0, (int)(i % 6), name, cents);
+    benchmark::DoNotOptimize(cents);
+    if (++i == lags.size()) i = 0;
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  static int16_t frame[SAMPLES];
+  sampleBuffer = frame;
+  if (!initCorrelationEngine()) return 1;
+
+  benchmark::AddCustomContext("corr_engine", CORR_ENGINE_NAME);
+  benchmark::AddCustomContext("samples", std::to_string(SAMPLES));
+  benchmark::AddCustomContext("hop", std::to_string(FRAME_HOP));
+
+  for (int e = 0; e < ENGINE_COUNT; e++) {
+    for (int t = 0; t < NUM_TUNINGS; t++) {
+      for (int s = 0; s < 6; s++) {
+        for (int w = 0; w < 3; w++) {
+          // The full scan only differs from "auto" where the coarse search runs
+          if (w == 2 && (CORR_ENGINE != CORR_ENGINE_DIRECT || e != ENGINE_AUTOCORR)) continue;
+          static const char* const WINDOWS[] = {"auto", "string", "auto_full_scan"};
+          std::string name = std::string("detect/") + PITCH_ENGINE_NAMES[e] + "/" +
+                             tuningModes[t].name + "/" + tuningModes[t].noteNames[s] + "/" +
+                             WINDOWS[w];
+          benchmark::RegisterBenchmark(name.c_str(), BM_Detect, e, t, s, w == 1, w != 2)
+              ->UseManualTime()
+              ->MinTime(0.1)
+              ->Unit(benchmark::kNanosecond);
+        }
+      }
+    }
+  }
+  benchmark::RegisterBenchmark("note/float", BM_NoteFloat);
+  benchmark::RegisterBenchmark("note/fixed", BM_NoteFixed);
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,371 @@
+// Adafruit_GFX.h for host builds. The primitives follow the library's
+// algorithms (Bresenham lines, midpoint circles, rounded rects built from
+// circle quadrants) and its startWrite()/write*() call structure.
+#include "Adafruit_GFX.h"
+
+#include <utility>
+
+Adafruit_GFX::Adafruit_GFX(int16_t w, int16_t h) : WIDTH(w), HEIGHT(h), _width(w), _height(h) {}
+
+void Adafruit_GFX::writePixel(int16_t x, int16_t y, uint16_t color) {
+  drawPixel(x, y, color);
+}
+
+void Adafruit_GFX::writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  fillRect(x, y, w, h, color);
+}
+
+void Adafruit_GFX::writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+  drawFastVLine(x, y, h, color);
+}
+
+void Adafruit_GFX::writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+  drawFastHLine(x, y, w, color);
+}
+
+void Adafruit_GFX::writeLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+  bool steep = abs(y1 - y0) > abs(x1 - x0);
+  if (steep) {
+    std::swap(x0, y0);
+    std::swap(x1, y1);
+  }
+  if (x0 > x1) {
+    std::swap(x0, x1);
+    std::swap(y0, y1);
+  }
+  int16_t dx = x1 - x0, dy = abs(y1 - y0);
+  int16_t err = dx / 2;
+  int16_t ystep = y0 < y1 ? 1 : -1;
+  for (; x0 <= x1; x0++) {
+    if (steep) writePixel(y0, x0, color);
+    else writePixel(x0, y0, color);
+    err -= dy;
+    if (err < 0) {
+      y0 += ystep;
+      err += dx;
+    }
+  }
+}
+
+void Adafruit_GFX::setRotation(uint8_t r) {
+  rotation = r & 3;
+  _width = (rotation & 1) ? HEIGHT : WIDTH;
+  _height = (rotation & 1) ? WIDTH : HEIGHT;
+}
+
+void Adafruit_GFX::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+  startWrite();
+  writeLine(x, y, x, y + h - 1, color);
+  endWrite();
+}
+
+void Adafruit_GFX::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+  startWrite();
+  writeLine(x, y, x + w - 1, y, color);
+  endWrite();
+}
+
+void Adafruit_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  startWrite();
+  for (int16_t i = x; i < x + w; i++) writeFastVLine(i, y, h, color);
+  endWrite();
+}
+
+void Adafruit_GFX::fillScreen(uint16_t color) {
+  fillRect(0, 0, _width, _height, color);
+}
+
+void Adafruit_GFX::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+  if (x0 == x1) {
+    if (y0 > y1) std::swap(y0, y1);
+    drawFastVLine(x0, y0, y1 - y0 + 1, color);
+  } else if (y0 == y1) {
+    if (x0 > x1) std::swap(x0, x1);
+    drawFastHLine(x0, y0, x1 - x0 + 1, color);
+  } else {
+    startWrite();
+    writeLine(x0, y0, x1, y1, color);
+    endWrite();
+  }
+}
+
+void Adafruit_GFX::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  startWrite();
+  writeFastHLine(x, y, w, color);
+  writeFastHLine(x, y + h - 1, w, color);
+  writeFastVLine(x, y, h, color);
+  writeFastVLine(x + w - 1, y, h, color);
+  endWrite();
+}
+
+void Adafruit_GFX::drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
+  int16_t f = 1 - r, ddF_x = 1, ddF_y = -2 * r, x = 0, y = r;
+  startWrite();
+  writePixel(x0, y0 + r, color);
+  writePixel(x0, y0 - r, color);
+  writePixel(x0 + r, y0, color);
+  writePixel(x0 - r, y0, color);
+  while (x < y) {
+    if (f >= 0) {
+      y--;
+      ddF_y += 2;
+      f += ddF_y;
+    }
+    x++;
+    ddF_x += 2;
+    f += ddF_x;
+    writePixel(x0 + x, y0 + y, color);
+    writePixel(x0 - x, y0 + y, color);
+    writePixel(x0 + x, y0 - y, color);
+    writePixel(x0 - x, y0 - y, color);
+    writePixel(x0 + y, y0 + x, color);
+    writePixel(x0 - y, y0 + x, color);
+    writePixel(x0 + y, y0 - x, color);
+    writePixel(x0 - y, y0 - x, color);
+  }
+  endWrite();
+}
+
+void Adafruit_GFX::drawCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t corners,
+                                    uint16_t color) {
+  int16_t f = 1 - r, ddF_x = 1, ddF_y = -2 * r, x = 0, y = r;
+  while (x < y) {
+    if (f >= 0) {
+      y--;
+      ddF_y += 2;
+      f += ddF_y;
+    }
+    x++;
+    ddF_x += 2;
+    f += ddF_x;
+    if (corners & 0x4) {
+      writePixel(x0 + x, y0 + y, color);
+      writePixel(x0 + y, y0 + x, color);
+    }
+    if (corners & 0x2) {
+      writePixel(x0 + x, y0 - y, color);
+      writePixel(x0 + y, y0 - x, color);
+    }
+    if (corners & 0x8) {
+      writePixel(x0 - y, y0 + x, color);
+      writePixel(x0 - x, y0 + y, color);
+    }
+    if (corners & 0x1) {
+      writePixel(x0 - y, y0 - x, color);
+      writePixel(x0 - x, y0 - y, color);
+    }
+  }
+}
+
+void Adafruit_GFX::fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
+  startWrite();
+  writeFastVLine(x0, y0 - r, 2 * r + 1, color);
+  fillCircleHelper(x0, y0, r, 3, 0, color);
+  endWrite();
+}
+
+void Adafruit_GFX::fillCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t corners,
+                                    int16_t delta, uint16_t color) {
+  int16_t f = 1 - r, ddF_x = 1, ddF_y = -2 * r, x = 0, y = r;
+  int16_t px = x, py = y;
+  delta++;  // Avoid some +1's in the loop
+  while (x < y) {
+    if (f >= 0) {
+      y--;
+      ddF_y += 2;
+      f += ddF_y;
+    }
+    x++;
+    ddF_x += 2;
+    f += ddF_x;
+    // These checks avoid double-drawing certain lines
+    if (x < (y + 1)) {
+      if (corners & 1) writeFastVLine(x0 + x, y0 - y, 2 * y + delta, color);
+      if (corners & 2) writeFastVLine(x0 - x, y0 - y, 2 * y + delta, color);
+    }
+    if (y != py) {
+      if (corners & 1) writeFastVLine(x0 + py, y0 - px, 2 * px + delta, color);
+      if (corners & 2) writeFastVLine(x0 - py, y0 - px, 2 * px + delta, color);
+      py = y;
+    }
+    px = x;
+  }
+}
+
+void Adafruit_GFX::drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r,
+                                 uint16_t color) {
+  int16_t maxRadius = ((w < h) ? w : h) / 2;
+  if (r > maxRadius) r = maxRadius;
+  startWrite();
+  writeFastHLine(x + r, y, w - 2 * r, color);
+  writeFastHLine(x + r, y + h - 1, w - 2 * r, color);
+  writeFastVLine(x, y + r, h - 2 * r, color);
+  writeFastVLine(x + w - 1, y + r, h - 2 * r, color);
+  drawCircleHelper(x + r, y + r, r, 1, color);
+  drawCircleHelper(x + w - r - 1, y + r, r, 2, color);
+  drawCircleHelper(x + w - r - 1, y + h - r - 1, r, 4, color);
+  drawCircleHelper(x + r, y + h - r - 1, r, 8, color);
+  endWrite();
+}
+
+void Adafruit_GFX::fillRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r,
+                                 uint16_t color) {
+  int16_t maxRadius = ((w < h) ? w : h) / 2;
+  if (r > maxRadius) r = maxRadius;
+  startWrite();
+  writeFillRect(x + r, y, w - 2 * r, h, color);
+  fillCircleHelper(x + w - r - 1, y + r, r, 1, h - 2 * r - 1, color);
+  fillCircleHelper(x + r, y + r, r, 2, h - 2 * r - 1, color);
+  endWrite();
+}
+
+void Adafruit_GFX::drawRGBBitmap(int16_t x, int16_t y, const uint16_t* bitmap, int16_t w,
+                                 int16_t h) {
+  startWrite();
+  for (int16_t j = 0; j < h; j++) {
+    for (int16_t i = 0; i < w; i++) writePixel(x + i, y + j, bitmap[j * w + i]);
+  }
+  endWrite();
+}
+
+// Column 'i' (0-4) of the stand-in glyph for 'c', bit 0 = top row
+static uint8_t glyphColumn(unsigned char c, int i) {
+  if (c == ' ') return 0;
+  uint32_t h = (c * 5u + i + 1) * 2654435761u;
+  return (uint8_t)((h >> 24) & 0x7F);
+}
+
+void Adafruit_GFX::drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg,
+                            uint8_t sizeX, uint8_t sizeY) {
+  if (x >= _width || y >= _height || (x + 6 * sizeX - 1) < 0 || (y + 8 * sizeY - 1) < 0) return;
+  startWrite();
+  for (int8_t i = 0; i < 5; i++) {
+    uint8_t line = glyphColumn(c, i);
+    for (int8_t j = 0; j < 8; j++, line >>= 1) {
+      if (line & 1) {
+        if (sizeX == 1 && sizeY == 1) writePixel(x + i, y + j, color);
+        else writeFillRect(x + i * sizeX, y + j * sizeY, sizeX, sizeY, color);
+      } else if (bg != color) {
+        if (sizeX == 1 && sizeY == 1) writePixel(x + i, y + j, bg);
+        else writeFillRect(x + i * sizeX, y + j * sizeY, sizeX, sizeY, bg);
+      }
+    }
+  }
+  if (bg != color) {
+    if (sizeX == 1 && sizeY == 1) writeFastVLine(x + 5, y, 8, bg);
+    else writeFillRect(x + 5 * sizeX, y, sizeX, 8 * sizeY, bg);
+  }
+  endWrite();
+}
+
+size_t Adafruit_GFX::write(uint8_t c) {
+  if (c == '\n') {
+    cursor_x = 0;
+    cursor_y += textsize_y * 8;
+  } else if (c != '\r') {
+    if (wrap && (cursor_x + textsize_x * 6) > _width) {
+      cursor_x = 0;
+      cursor_y += textsize_y * 8;
+    }
+    drawChar(cursor_x, cursor_y, c, textcolor, textbgcolor, textsize_x, textsize_y);
+    cursor_x += textsize_x * 6;
+  }
+  return 1;
+}
+
+void Adafruit_GFX::getTextBounds(const char* str, int16_t x, int16_t y, int16_t* x1, int16_t* y1,
+                                 uint16_t* w, uint16_t* h) {
+  int16_t minx = _width, miny = _height, maxx = -1, maxy = -1;
+  *x1 = x;
+  *y1 = y;
+  *w = *h = 0;
+  for (; *str; str++) {
+    char c = *str;
+    if (c == '\n') {
+      x = 0;
+      y += textsize_y * 8;
+    } else if (c != '\r') {
+      if (wrap && (x + textsize_x * 6 > _width)) {
+        x = 0;
+        y += textsize_y * 8;
+      }
+      int16_t x2 = x + textsize_x * 6 - 1, y2 = y + textsize_y * 8 - 1;
+      if (x2 > maxx) maxx = x2;
+      if (y2 > maxy) maxy = y2;
+      if (x < minx) minx = x;
+      if (y < miny) miny = y;
+      x += textsize_x * 6;
+    }
+  }
+  if (maxx >= minx) {
+    *x1 = minx;
+    *w = maxx - minx + 1;
+  }
+  if (maxy >= miny) {
+    *y1 = miny;
+    *h = maxy - miny + 1;
+  }
+}
+
+// ===== GFXcanvas16 =====
+
+GFXcanvas16::GFXcanvas16(uint16_t w, uint16_t h) : Adafruit_GFX(w, h), buffer((size_t)w * h, 0) {}
+
+void GFXcanvas16::drawPixel(int16_t x, int16_t y, uint16_t color) {
+  if (x < 0 || y < 0 || x >= _width || y >= _height) return;
+  int16_t t;
+  switch (rotation) {
+    case 1:
+      t = x;
+      x = WIDTH - 1 - y;
+      y = t;
+      break;
+    case 2:
+      x = WIDTH - 1 - x;
+      y = HEIGHT - 1 - y;
+      break;
+    case 3:
+      t = x;
+      x = y;
+      y = HEIGHT - 1 - t;
+      break;
+  }
+  buffer[(size_t)y * WIDTH + x] = color;
+}
+
+uint16_t GFXcanvas16::getPixel(int16_t x, int16_t y) const {
+  if (x < 0 || y < 0 || x >= _width || y >= _height || rotation) return 0;
+  return buffer[(size_t)y * WIDTH + x];
+}
+
+void GFXcanvas16::fillScreen(uint16_t color) {
+  std::fill(buffer.begin(), buffer.end(), color);
+}
+
+void GFXcanvas16::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+  if (rotation) {
+    Adafruit_GFX::drawFastVLine(x, y, h, color);
+    return;
+  }
+  if (h < 0) {
+    y += h + 1;
+    h = -h;
+  }
+  if (x < 0 || x >= _width) return;
+  int16_t y0 = std::max<int16_t>(y, 0), y1 = std::min<int16_t>(y + h, _height);
+  for (int16_t j = y0; j < y1; j++) buffer[(size_t)j * WIDTH + x] = color;
+}
+
+void GFXcanvas16::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+  if (rotation) {
+    Adafruit_GFX::drawFastHLine(x, y, w, color);
+    return;
+  }
+  if (w < 0) {
+    x += w + 1;
+    w = -w;
+  }
+  if (y < 0 || y >= _height) return;
+  int16_t x0 = std::max<int16_t>(x, 0), x1 = std::min<int16_t>(x + w, _width);
+  for (int16_t i = x0; i < x1; i++) buffer[(size_t)y * WIDTH + i] = color;
+}
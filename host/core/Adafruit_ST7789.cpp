@@ -0,0 +1,127 @@
+// Adafruit_ST7789.h for host builds: SPITFT drawing lands in a framebuffer
+#include "Adafruit_ST7789.h"
+
+// Screen coordinates (in range) to an index into the unrotated frame
+size_t Adafruit_SPITFT::panelIndex(int16_t x, int16_t y) const {
+  int16_t t;
+  switch (rotation) {
+    case 1:
+      t = x;
+      x = WIDTH - 1 - y;
+      y = t;
+      break;
+    case 2:
+      x = WIDTH - 1 - x;
+      y = HEIGHT - 1 - y;
+      break;
+    case 3:
+      t = x;
+      x = y;
+      y = HEIGHT - 1 - t;
+      break;
+  }
+  return (size_t)y * WIDTH + x;
+}
+
+void Adafruit_SPITFT::setPanelPixel(int16_t x, int16_t y, uint16_t color) {
+  if (x < 0 || y < 0 || x >= _width || y >= _height) return;
+  frame[panelIndex(x, y)] = color;
+}
+
+uint16_t Adafruit_SPITFT::hostPixel(int16_t x, int16_t y) const {
+  if (x < 0 || y < 0 || x >= _width || y >= _height) return 0;
+  return frame[panelIndex(x, y)];
+}
+
+void Adafruit_SPITFT::setAddrWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+  winX = x;
+  winY = y;
+  winW = w;
+  winH = h;
+  winPos = 0;
+}
+
+void Adafruit_SPITFT::writePixels(uint16_t* colors, uint32_t len, bool block, bool bigEndian) {
+  for (uint32_t i = 0; i < len; i++) {
+    uint16_t c = bigEndian ? (uint16_t)((colors[i] >> 8) | (colors[i] << 8)) : colors[i];
+    if (winW > 0 && winH > 0) {
+      setPanelPixel(winX + winPos % winW, winY + (winPos / winW) % winH, c);
+      winPos++;
+    }
+  }
+  pixelsSent += len;
+}
+
+void Adafruit_SPITFT::writeColor(uint16_t color, uint32_t len) {
+  for (uint32_t i = 0; i < len; i++) writePixels(&color, 1);
+}
+
+void Adafruit_SPITFT::sendCommand(uint8_t command, const uint8_t* data, uint8_t len) {
+  lastCommand = command;
+}
+
+// As in the library, the drawing entry points below don't call each other:
+// each clips and sends its own window, so a subclass overriding them sees
+// every pixel exactly once
+void Adafruit_SPITFT::drawPixel(int16_t x, int16_t y, uint16_t color) {
+  if (x < 0 || y < 0 || x >= _width || y >= _height) return;
+  setAddrWindow(x, y, 1, 1);
+  writePixels(&color, 1);
+}
+
+void Adafruit_SPITFT::writePixel(int16_t x, int16_t y, uint16_t color) {
+  if (x < 0 || y < 0 || x >= _width || y >= _height) return;
+  setAddrWindow(x, y, 1, 1);
+  writePixels(&color, 1);
+}
+
+// Clips, then sends the rect as one window, as the library does
+void Adafruit_SPITFT::fillClipped(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  if (w < 0) {
+    x += w + 1;
+    w = -w;
+  }
+  if (h < 0) {
+    y += h + 1;
+    h = -h;
+  }
+  int16_t x0 = std::max<int16_t>(x, 0), y0 = std::max<int16_t>(y, 0);
+  int16_t x1 = std::min<int16_t>(x + w, _width), y1 = std::min<int16_t>(y + h, _height);
+  if (x1 <= x0 || y1 <= y0) return;
+  setAddrWindow(x0, y0, x1 - x0, y1 - y0);
+  writeColor(color, (uint32_t)(x1 - x0) * (y1 - y0));
+}
+
+void Adafruit_SPITFT::writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  fillClipped(x, y, w, h, color);
+}
+
+void Adafruit_SPITFT::writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+  fillClipped(x, y, w, 1, color);
+}
+
+void Adafruit_SPITFT::writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+  fillClipped(x, y, 1, h, color);
+}
+
+void Adafruit_SPITFT::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  fillClipped(x, y, w, h, color);
+}
+
+void Adafruit_SPITFT::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+  fillClipped(x, y, w, 1, color);
+}
+
+void Adafruit_SPITFT::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+  fillClipped(x, y, 1, h, color);
+}
+
+void Adafruit_ST7789::init(uint16_t width, uint16_t height, uint8_t spiMode) {
+  std::fill(frame.begin(), frame.end(), 0);
+  setRotation(0);
+}
+
+void Adafruit_ST7789::setRotation(uint8_t m) {
+  Adafruit_GFX::setRotation(m);
+  lastCommand = ST77XX_MADCTL;
+}
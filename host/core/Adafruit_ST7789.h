@@ -0,0 +1,76 @@
+// Host stand-in for Adafruit_ST7789 and the Adafruit_SPITFT layer under it.
+// Instead of an SPI bus there is a framebuffer in screen (rotated)
+// coordinates, with address-window semantics for writePixels(). The
+// framebuffer, the count of pixels sent and the last command are public to
+// host programs through the host*() accessors. Which members are virtual
+// follows the library, so subclasses see the same hooks.
+#pragma once
+
+#include "Adafruit_GFX.h"
+
+#define ST77XX_MADCTL 0x36
+#define ST77XX_MADCTL_MY 0x80
+#define ST77XX_MADCTL_MX 0x40
+#define ST77XX_MADCTL_MV 0x20
+#define ST77XX_MADCTL_ML 0x10
+#define ST77XX_MADCTL_RGB 0x00
+
+#define ST77XX_BLACK 0x0000
+#define ST77XX_WHITE 0xFFFF
+#define ST77XX_RED 0xF800
+#define ST77XX_GREEN 0x07E0
+#define ST77XX_BLUE 0x001F
+
+class Adafruit_SPITFT : public Adafruit_GFX {
+public:
+  Adafruit_SPITFT(uint16_t w, uint16_t h) : Adafruit_GFX(w, h), frame((size_t)w * h, 0) {}
+
+  virtual void setAddrWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+
+  void startWrite() override {}
+  void endWrite() override {}
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override;
+  void writePixel(int16_t x, int16_t y, uint16_t color) override;
+  void writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override;
+  void writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override;
+  void writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override;
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override;
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override;
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override;
+  void invertDisplay(bool i) override { inverted = i; }
+
+  // Pixels go to the current address window, row by row, wrapping
+  void writePixels(uint16_t* colors, uint32_t len, bool block = true, bool bigEndian = false);
+  void writeColor(uint16_t color, uint32_t len);
+  void sendCommand(uint8_t command, const uint8_t* data = nullptr, uint8_t len = 0);
+
+  static uint16_t color565(uint8_t r, uint8_t g, uint8_t b) {
+    return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+  }
+
+  // Host side: what the panel shows, in screen coordinates
+  uint16_t hostPixel(int16_t x, int16_t y) const;
+  uint64_t hostPixelsSent() const { return pixelsSent; }
+  uint8_t hostLastCommand() const { return lastCommand; }
+  bool hostInverted() const { return inverted; }
+
+protected:
+  size_t panelIndex(int16_t x, int16_t y) const;
+  void setPanelPixel(int16_t x, int16_t y, uint16_t color);
+  void fillClipped(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+
+  std::vector<uint16_t> frame;  // Unrotated, WIDTH x HEIGHT
+  int16_t winX = 0, winY = 0, winW = 0, winH = 0;
+  int32_t winPos = 0;
+  uint64_t pixelsSent = 0;
+  uint8_t lastCommand = 0;
+  bool inverted = false;
+};
+
+class Adafruit_ST7789 : public Adafruit_SPITFT {
+public:
+  Adafruit_ST7789(int8_t cs, int8_t dc, int8_t rst) : Adafruit_SPITFT(240, 320) {}
+
+  void init(uint16_t width = 240, uint16_t height = 320, uint8_t spiMode = 0);
+  void setRotation(uint8_t m) override;
+};
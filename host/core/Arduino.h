@@ -0,0 +1,270 @@
+// Host stand-in for the ESP32 Arduino core: enough of Arduino.h, esp32-hal
+// and FreeRTOS for the sketch to build and run unchanged on Linux.
+//
+// Time is the virtual clock in hal_host.cpp. FreeRTOS tasks are std::threads
+// run one at a time, highest priority first, each until it blocks, and only
+// while the sketch's thread (setup()/loop()) waits in delay() or in one of
+// the host* calls below - so a run is deterministic and as fast as the code
+// allows. Timer alarms fire in step with the clock. Pins, the ADC and the
+// serial port are driven from the host program through the host* functions
+// at the end of this file.
+//
+// ARDUINO is deliberately not defined: hal.h and the DSP modules take their
+// host branches.
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string>
+
+#include "hal.h"
+
+#define ESP_ARDUINO_VERSION_MAJOR 3
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+enum adc_attenuation_t { ADC_0db, ADC_2_5db, ADC_6db, ADC_11db };
+
+// ===== TIME =====
+inline unsigned long millis() { return halMillis(); }
+inline unsigned long micros() { return halMicros(); }
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+// ===== PINS =====
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t level);
+uint16_t analogRead(uint8_t pin);
+void analogReadResolution(uint8_t bits);
+void analogSetAttenuation(adc_attenuation_t attenuation);
+inline int digitalPinToInterrupt(int pin) { return pin; }
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode);
+void detachInterrupt(uint8_t pin);
+
+// ===== STRING =====
+class String {
+public:
+  String(const char* s = "") : s(s ? s : "") {}
+  String(const std::string &s) : s(s) {}
+  explicit String(char c) : s(1, c) {}
+  explicit String(int v) : s(std::to_string(v)) {}
+  explicit String(long v) : s(std::to_string(v)) {}
+  explicit String(unsigned long v) : s(std::to_string(v)) {}
+
+  const char* c_str() const { return s.c_str(); }
+  unsigned int length() const { return (unsigned int)s.size(); }
+  char operator[](unsigned int i) const { return i < s.size() ? s[i] : 0; }
+  bool operator==(const String &o) const { return s == o.s; }
+  bool operator==(const char* o) const { return s == o; }
+  bool operator!=(const String &o) const { return s != o.s; }
+  bool operator!=(const char* o) const { return s != o; }
+  String &operator+=(const String &o) { s += o.s; return *this; }
+  String &operator+=(const char* o) { s += o; return *this; }
+  String &operator+=(char c) { s += c; return *this; }
+  friend String operator+(String a, const String &b) { return a += b; }
+
+  bool startsWith(const String &prefix) const { return s.compare(0, prefix.s.size(), prefix.s) == 0; }
+  bool endsWith(const String &suffix) const {
+    return s.size() >= suffix.s.size() &&
+           s.compare(s.size() - suffix.s.size(), suffix.s.size(), suffix.s) == 0;
+  }
+  int indexOf(char c) const {
+    size_t i = s.find(c);
+    return i == std::string::npos ? -1 : (int)i;
+  }
+  String substring(unsigned int from) const { return from < s.size() ? s.substr(from) : ""; }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from >= s.size() || to <= from) return "";
+    return s.substr(from, to - from);
+  }
+  void trim() {
+    size_t a = s.find_first_not_of(" \t\r\n");
+    size_t b = s.find_last_not_of(" \t\r\n");
+    s = a == std::string::npos ? "" : s.substr(a, b - a + 1);
+  }
+  long toInt() const { return strtol(s.c_str(), nullptr, 10); }
+  float toFloat() const { return strtof(s.c_str(), nullptr); }
+
+private:
+  std::string s;
+};
+
+// ===== PRINT / STREAM =====
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buf, size_t n) {
+    size_t done = 0;
+    while (done < n && write(buf[done])) done++;
+    return done;
+  }
+  size_t write(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+  virtual int availableForWrite() { return 0; }
+  virtual void flush() {}
+
+  size_t print(const char* s) { return write(s); }
+  size_t print(const String &s) { return write(s.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v) { return printf("%d", v); }
+  size_t print(unsigned int v) { return printf("%u", v); }
+  size_t print(long v) { return printf("%ld", v); }
+  size_t print(unsigned long v) { return printf("%lu", v); }
+  size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+
+  size_t println() { return write("\r\n"); }
+  template <typename T> size_t println(const T &v) { return print(v) + println(); }
+  size_t println(double v, int digits) { return print(v, digits) + println(); }
+
+  size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+    char small[128];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(small, sizeof(small), fmt, args);
+    va_end(args);
+    if (n < 0) return 0;
+    if ((size_t)n < sizeof(small)) return write((const uint8_t*)small, n);
+    std::string big(n + 1, '\0');
+    va_start(args, fmt);
+    vsnprintf(&big[0], big.size(), fmt, args);
+    va_end(args);
+    return write((const uint8_t*)big.data(), n);
+  }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  // No timeout on the host: everything a stream will deliver is already there
+  size_t readBytes(char* buf, size_t n) {
+    size_t done = 0;
+    for (; done < n; done++) {
+      int c = read();
+      if (c < 0) break;
+      buf[done] = (char)c;
+    }
+    return done;
+  }
+  size_t readBytes(uint8_t* buf, size_t n) { return readBytes((char*)buf, n); }
+
+  String readStringUntil(char terminator) {
+    std::string s;
+    for (int c = read(); c >= 0 && c != terminator; c = read()) s += (char)c;
+    return s;
+  }
+};
+
+// Output goes to hostSerialOutput's file (stdout by default) and/or capture
+// string; input is whatever hostSerialInput() queued
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long baud) {}
+  void end() {}
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* buf, size_t n) override;
+  using Print::write;
+  int availableForWrite() override { return 4096; }
+  int available() override;
+  int read() override;
+  int peek() override;
+  operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+// ===== ESP =====
+class EspClass {
+public:
+  uint32_t getCycleCount() { return halCycles(); }
+  uint32_t getFreeHeap() { return 256 * 1024; }
+  uint32_t getFreePsram() { return 8 * 1024 * 1024; }
+};
+
+extern EspClass ESP;
+
+inline uint32_t getCpuFrequencyMhz() { return 240; }
+inline bool psramFound() { return true; }
+inline void* ps_malloc(size_t n) { return malloc(n); }
+
+// ===== FREERTOS =====
+typedef struct HostTask* TaskHandle_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY 0xFFFFFFFFu
+#define portTICK_PERIOD_MS 1
+#define configTICK_RATE_HZ 1000
+#define configMAX_PRIORITIES 25
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portYIELD_FROM_ISR(woken) ((void)(woken))
+
+BaseType_t xTaskCreatePinnedToCore(void (*fn)(void*), const char* name, uint32_t stackDepth,
+                                   void* arg, UBaseType_t priority, TaskHandle_t* handle,
+                                   BaseType_t core);
+inline BaseType_t xTaskCreate(void (*fn)(void*), const char* name, uint32_t stackDepth,
+                              void* arg, UBaseType_t priority, TaskHandle_t* handle) {
+  return xTaskCreatePinnedToCore(fn, name, stackDepth, arg, priority, handle, 0);
+}
+// A task deleting itself never returns. Deleting another task takes effect
+// when that task next blocks; the sketch's thread waits for it.
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* woken);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+BaseType_t xPortGetCoreID();
+
+// ===== HARDWARE TIMERS (3.x API) =====
+struct hw_timer_t;
+hw_timer_t* timerBegin(uint32_t frequency);
+void timerEnd(hw_timer_t* timer);
+void timerAttachInterrupt(hw_timer_t* timer, void (*isr)());
+void timerDetachInterrupt(hw_timer_t* timer);
+void timerAlarm(hw_timer_t* timer, uint64_t alarmValue, bool autoreload, uint64_t reloadCount);
+
+// ===== HOST CONTROL =====
+// Sets an input pin's level as a driven signal would, firing its interrupt
+// on a matching edge, then lets the woken tasks run
+void hostSetPin(uint8_t pin, int level);
+// Level the sketch last wrote to an output pin
+int hostPinLevel(uint8_t pin);
+// analogRead() source; the default reads mid-scale
+void hostSetAnalogSource(uint16_t (*source)(uint8_t pin));
+// Makes every 'every'-th continuous-ADC conversion come from another
+// channel, as a stray conversion would; 0 turns it off
+void hostSetAdcStrays(uint32_t every);
+// Queues text for Serial to read
+void hostSerialInput(const char* text);
+// Where Serial output goes: 'file' (nullptr drops it) and, when non-null,
+// appended to 'capture'
+void hostSerialOutput(FILE* file, std::string* capture = nullptr);
+// The virtual clock, without the 32-bit wrap of micros()
+uint64_t hostClockNowUs();
+// Stops every task (at its next blocking point) and waits for them
+void hostStopTasks();
@@ -0,0 +1,55 @@
+// Host stand-in for ESP32Servo. write() follows the library: values below
+// the minimum pulse width are angles, clamped to 0-180 and mapped onto the
+// attach() pulse range; larger values are microseconds. The host reads back
+// what the servo was last told and whether it is powered.
+#pragma once
+
+#include "Arduino.h"
+
+#define MIN_PULSE_WIDTH 500
+#define MAX_PULSE_WIDTH 2500
+
+class ESP32PWM {
+public:
+  static void allocateTimer(int timer) {}
+};
+
+class Servo {
+public:
+  int attach(int pin, int minUs = MIN_PULSE_WIDTH, int maxUs = MAX_PULSE_WIDTH) {
+    this->pin = pin;
+    this->minUs = minUs;
+    this->maxUs = maxUs;
+    attachCount++;
+    return 0;
+  }
+  void detach() { pin = -1; }
+  bool attached() const { return pin >= 0; }
+  void setPeriodHertz(int hz) {}
+
+  void write(int value) {
+    if (value < MIN_PULSE_WIDTH) {
+      value = constrain(value, 0, 180);
+      angle = value;
+      value = map(value, 0, 180, minUs, maxUs);
+    } else {
+      angle = map(value, minUs, maxUs, 0, 180);
+    }
+    pulseUs = value;
+    writeCount++;
+  }
+  void writeMicroseconds(int us) { write(max(us, MIN_PULSE_WIDTH)); }
+  int read() const { return angle; }
+  int readMicroseconds() const { return pulseUs; }
+
+  // Host side
+  int hostWrites() const { return writeCount; }
+  int hostAttaches() const { return attachCount; }
+
+private:
+  int pin = -1;
+  int minUs = MIN_PULSE_WIDTH, maxUs = MAX_PULSE_WIDTH;
+  int angle = 90;
+  int pulseUs = 1500;
+  int writeCount = 0, attachCount = 0;
+};
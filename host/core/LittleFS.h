@@ -0,0 +1,56 @@
+// Host stand-in for LittleFS: files live in memory for the life of the
+// process. Host programs put fixtures in and take results out through
+// hostFiles().
+#pragma once
+
+#include "Arduino.h"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+class File : public Stream {
+public:
+  File() {}
+  File(std::shared_ptr<std::vector<uint8_t>> data, bool writable)
+      : data(std::move(data)), writable(writable) {}
+
+  explicit operator bool() const { return data != nullptr; }
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* buf, size_t n) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t read(uint8_t* buf, size_t n) { return readBytes(buf, n); }
+  bool seek(uint32_t pos);
+  size_t position() const { return pos; }
+  size_t size() const { return data ? data->size() : 0; }
+  void close() { data.reset(); }
+
+private:
+  std::shared_ptr<std::vector<uint8_t>> data;
+  bool writable = false;
+  size_t pos = 0;
+};
+
+class LittleFSFS {
+public:
+  bool begin(bool formatOnFail = false, const char* basePath = "/littlefs", uint8_t maxOpenFiles = 10,
+             const char* partitionLabel = "spiffs") {
+    return true;
+  }
+  void end() {}
+  // "r" reads an existing file; "w" truncates or creates; "a" appends
+  File open(const char* path, const char* mode = "r");
+  File open(const String &path, const char* mode = "r") { return open(path.c_str(), mode); }
+  bool exists(const char* path) const { return files.count(path) != 0; }
+  bool remove(const char* path) { return files.erase(path) != 0; }
+
+  std::map<std::string, std::shared_ptr<std::vector<uint8_t>>> &hostFiles() { return files; }
+
+private:
+  std::map<std::string, std::shared_ptr<std::vector<uint8_t>>> files;
+};
+
+extern LittleFSFS LittleFS;
@@ -0,0 +1,582 @@
+// Arduino.h for host builds: pins, Serial, the continuous ADC and the
+// FreeRTOS/timer scheduler that runs the sketch's tasks against the
+// virtual clock.
+//
+// The sketch's own thread is the driver. Whenever it waits (delay(), a task
+// notify or delete, hostSetPin()) the runnable tasks get the one "core" in
+// turn: highest priority first, ties in creation order, each until it
+// blocks. Clock moves stop at every timer alarm and task deadline on the
+// way, so nothing sees time jump past its wake-up.
+#include "Arduino.h"
+#include "esp_adc/adc_continuous.h"
+
+#include <algorithm>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+// ===== SCHEDULER =====
+
+namespace {
+
+const uint64_t NEVER = UINT64_MAX;
+
+// Thrown inside a task to unwind it when it is deleted
+struct HostTaskExit {};
+
+}  // namespace
+
+struct HostTask {
+  std::string name;
+  void (*fn)(void*);
+  void* arg;
+  UBaseType_t priority;
+  std::thread thread;
+  std::condition_variable cv;
+  bool granted = false;      // Holds the core
+  bool started = false;
+  bool blocked = false;
+  bool wakeOnNotify = false;
+  uint64_t wakeAtUs = NEVER;
+  uint32_t notifyCount = 0;
+  bool exitRequested = false;
+  bool finished = false;
+};
+
+struct hw_timer_t {
+  uint32_t frequency;
+  void (*isr)();
+  uint64_t periodUs;
+  uint64_t alarmAtUs;
+  bool autoreload;
+  bool enabled;
+};
+
+namespace {
+
+struct Scheduler {
+  std::mutex mutex;
+  std::condition_variable turnDone;
+  std::vector<HostTask*> tasks;  // Creation order
+  std::vector<hw_timer_t*> timers;
+  bool exitHookInstalled = false;
+};
+
+Scheduler &scheduler() {
+  static Scheduler s;
+  return s;
+}
+
+thread_local HostTask* currentTask = nullptr;
+thread_local bool inIsr = false;
+
+// Only the sketch's thread, outside an ISR, drives the scheduler
+bool isDriver() {
+  return !currentTask && !inIsr;
+}
+
+bool runnable(const HostTask* t, uint64_t now) {
+  if (t->finished) return false;
+  if (!t->started || t->exitRequested) return true;
+  return t->blocked && ((t->wakeOnNotify && t->notifyCount) || now >= t->wakeAtUs);
+}
+
+// Gives the core to each runnable task in turn until none is left, then
+// reaps the ones that finished. Called with the lock held.
+void runReady(std::unique_lock<std::mutex> &lock) {
+  Scheduler &s = scheduler();
+  while (true) {
+    uint64_t now = hostClockNowUs();
+    HostTask* next = nullptr;
+    for (HostTask* t : s.tasks) {
+      if (runnable(t, now) && (!next || t->priority > next->priority)) next = t;
+    }
+    if (!next) break;
+    next->granted = true;
+    next->cv.notify_one();
+    s.turnDone.wait(lock, [next] { return !next->granted; });
+  }
+  for (auto it = s.tasks.begin(); it != s.tasks.end();) {
+    HostTask* t = *it;
+    if (t->finished) {
+      t->thread.join();
+      delete t;
+      it = s.tasks.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+// Task side: gives up the core until woken by the deadline or, when
+// 'onNotify', a notification. Unwinds the task if it was deleted meanwhile.
+void blockTask(std::unique_lock<std::mutex> &lock, HostTask* t, uint64_t wakeAtUs, bool onNotify) {
+  t->blocked = true;
+  t->wakeAtUs = wakeAtUs;
+  t->wakeOnNotify = onNotify;
+  t->granted = false;
+  scheduler().turnDone.notify_all();
+  t->cv.wait(lock, [t] { return t->granted; });
+  t->blocked = false;
+  if (t->exitRequested) throw HostTaskExit();
+}
+
+void taskMain(HostTask* t) {
+  currentTask = t;
+  {
+    std::unique_lock<std::mutex> lock(scheduler().mutex);
+    t->cv.wait(lock, [t] { return t->granted; });
+    t->started = true;
+  }
+  try {
+    if (!t->exitRequested) t->fn(t->arg);
+  } catch (const HostTaskExit &) {
+  }
+  std::lock_guard<std::mutex> lock(scheduler().mutex);
+  t->finished = true;
+  t->granted = false;
+  scheduler().turnDone.notify_all();
+}
+
+// Moves the clock to 'targetUs', stopping at every timer alarm and task
+// deadline on the way to fire the alarm and run whoever is due
+void advanceTo(uint64_t targetUs) {
+  Scheduler &s = scheduler();
+  std::unique_lock<std::mutex> lock(s.mutex);
+  runReady(lock);
+  while (true) {
+    uint64_t now = hostClockNowUs();
+    uint64_t next = targetUs;
+    for (hw_timer_t* tm : s.timers) {
+      if (tm->enabled && tm->isr) next = std::min(next, tm->alarmAtUs);
+    }
+    for (HostTask* t : s.tasks) {
+      if (t->blocked && t->wakeAtUs > now) next = std::min(next, t->wakeAtUs);
+    }
+    if (next > now) halAdvanceUs(next - now);
+    now = std::max(now, next);
+
+    std::vector<void (*)()> due;
+    for (hw_timer_t* tm : s.timers) {
+      if (!tm->enabled || !tm->isr || tm->alarmAtUs > now) continue;
+      due.push_back(tm->isr);
+      if (tm->autoreload) tm->alarmAtUs += tm->periodUs;
+      else tm->enabled = false;
+    }
+    if (!due.empty()) {
+      lock.unlock();
+      inIsr = true;
+      for (auto isr : due) isr();
+      inIsr = false;
+      lock.lock();
+    }
+    runReady(lock);
+    if (now >= targetUs) break;
+  }
+}
+
+void settle() {
+  std::unique_lock<std::mutex> lock(scheduler().mutex);
+  runReady(lock);
+}
+
+}  // namespace
+
+void hostStopTasks() {
+  Scheduler &s = scheduler();
+  std::unique_lock<std::mutex> lock(s.mutex);
+  for (HostTask* t : s.tasks) t->exitRequested = true;
+  runReady(lock);
+}
+
+BaseType_t xTaskCreatePinnedToCore(void (*fn)(void*), const char* name, uint32_t stackDepth,
+                                   void* arg, UBaseType_t priority, TaskHandle_t* handle,
+                                   BaseType_t core) {
+  Scheduler &s = scheduler();
+  HostTask* t = new HostTask;
+  t->name = name;
+  t->fn = fn;
+  t->arg = arg;
+  t->priority = priority;
+  {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (!s.exitHookInstalled) {
+      // Tasks block forever on the device; stop them before statics go away
+      atexit(hostStopTasks);
+      s.exitHookInstalled = true;
+    }
+    s.tasks.push_back(t);
+    t->thread = std::thread(taskMain, t);
+  }
+  if (handle) *handle = t;
+  if (isDriver()) settle();  // Runs the new task up to its first wait
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  if (!task || task == currentTask) {
+    if (!currentTask) abort();
+    throw HostTaskExit();
+  }
+  {
+    std::lock_guard<std::mutex> lock(scheduler().mutex);
+    task->exitRequested = true;
+  }
+  if (isDriver()) settle();
+}
+
+void vTaskDelay(TickType_t ticks) {
+  HostTask* t = currentTask;
+  if (!t) {
+    delay(ticks);
+    return;
+  }
+  std::unique_lock<std::mutex> lock(scheduler().mutex);
+  blockTask(lock, t, hostClockNowUs() + (uint64_t)ticks * 1000, false);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+  HostTask* t = currentTask;
+  if (!t) abort();
+  std::unique_lock<std::mutex> lock(scheduler().mutex);
+  if (!t->notifyCount && ticks) {
+    uint64_t wakeAt = ticks == portMAX_DELAY ? NEVER : hostClockNowUs() + (uint64_t)ticks * 1000;
+    blockTask(lock, t, wakeAt, true);
+  }
+  uint32_t count = t->notifyCount;
+  if (clearOnExit) t->notifyCount = 0;
+  else if (count) t->notifyCount--;
+  return count;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  {
+    std::lock_guard<std::mutex> lock(scheduler().mutex);
+    task->notifyCount++;
+  }
+  if (isDriver()) settle();
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* woken) {
+  xTaskNotifyGive(task);
+  if (woken) *woken = pdTRUE;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return currentTask;
+}
+
+BaseType_t xPortGetCoreID() {
+  return currentTask ? 0 : 1;
+}
+
+// ===== TIME =====
+
+void delay(uint32_t ms) {
+  if (currentTask) {
+    vTaskDelay(ms);
+  } else {
+    advanceTo(hostClockNowUs() + (uint64_t)ms * 1000);
+  }
+}
+
+void delayMicroseconds(uint32_t us) {
+  if (isDriver()) advanceTo(hostClockNowUs() + us);
+}
+
+void yield() {
+  if (isDriver()) settle();
+}
+
+// ===== HARDWARE TIMERS =====
+
+hw_timer_t* timerBegin(uint32_t frequency) {
+  hw_timer_t* tm = new hw_timer_t{frequency, nullptr, 0, 0, false, false};
+  std::lock_guard<std::mutex> lock(scheduler().mutex);
+  scheduler().timers.push_back(tm);
+  return tm;
+}
+
+void timerEnd(hw_timer_t* timer) {
+  std::lock_guard<std::mutex> lock(scheduler().mutex);
+  auto &timers = scheduler().timers;
+  timers.erase(std::remove(timers.begin(), timers.end(), timer), timers.end());
+  delete timer;
+}
+
+void timerAttachInterrupt(hw_timer_t* timer, void (*isr)()) {
+  std::lock_guard<std::mutex> lock(scheduler().mutex);
+  timer->isr = isr;
+}
+
+void timerDetachInterrupt(hw_timer_t* timer) {
+  std::lock_guard<std::mutex> lock(scheduler().mutex);
+  timer->isr = nullptr;
+}
+
+void timerAlarm(hw_timer_t* timer, uint64_t alarmValue, bool autoreload, uint64_t reloadCount) {
+  std::lock_guard<std::mutex> lock(scheduler().mutex);
+  timer->periodUs = std::max<uint64_t>(1, alarmValue * 1000000 / timer->frequency);
+  timer->alarmAtUs = hostClockNowUs() + timer->periodUs;
+  timer->autoreload = autoreload;
+  timer->enabled = true;
+}
+
+// ===== PINS =====
+
+namespace {
+
+const int PIN_COUNT = 64;
+
+struct PinState {
+  uint8_t mode = INPUT;
+  int level = LOW;
+  void (*isr)() = nullptr;
+  int isrMode = 0;
+};
+
+PinState pins[PIN_COUNT];
+
+uint16_t midScale(uint8_t) {
+  return 2048;
+}
+
+uint16_t (*analogSource)(uint8_t) = midScale;
+
+}  // namespace
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin >= PIN_COUNT) return;
+  pins[pin].mode = mode;
+  if (mode == INPUT_PULLUP) pins[pin].level = HIGH;
+}
+
+int digitalRead(uint8_t pin) {
+  return pin < PIN_COUNT ? pins[pin].level : LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+  if (pin < PIN_COUNT) pins[pin].level = level ? HIGH : LOW;
+}
+
+uint16_t analogRead(uint8_t pin) {
+  return analogSource(pin);
+}
+
+void analogReadResolution(uint8_t bits) {}
+void analogSetAttenuation(adc_attenuation_t attenuation) {}
+
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode) {
+  if (pin >= PIN_COUNT) return;
+  pins[pin].isr = isr;
+  pins[pin].isrMode = mode;
+}
+
+void detachInterrupt(uint8_t pin) {
+  if (pin < PIN_COUNT) pins[pin].isr = nullptr;
+}
+
+void hostSetPin(uint8_t pin, int level) {
+  if (pin >= PIN_COUNT) return;
+  PinState &p = pins[pin];
+  level = level ? HIGH : LOW;
+  if (level == p.level) return;
+  p.level = level;
+  bool fire = p.isr && (p.isrMode == CHANGE || (p.isrMode == RISING && level == HIGH) ||
+                        (p.isrMode == FALLING && level == LOW));
+  if (fire) {
+    inIsr = true;
+    p.isr();
+    inIsr = false;
+  }
+  settle();
+}
+
+int hostPinLevel(uint8_t pin) {
+  return digitalRead(pin);
+}
+
+void hostSetAnalogSource(uint16_t (*source)(uint8_t pin)) {
+  analogSource = source ? source : midScale;
+}
+
+// ===== CONTINUOUS ADC =====
+
+struct adc_continuous_ctx_t {
+  uint32_t frameBytes;
+  uint32_t poolBytes;
+  uint32_t freqHz;
+  uint8_t channel;
+  bool configured;
+  bool running;
+  uint64_t startUs;
+  uint64_t taken;  // Conversions handed out or dropped since the start
+};
+
+namespace {
+
+// Sleeps the calling task, or runs the clock when it is the sketch's thread
+void sleepUntilUs(uint64_t wakeAtUs) {
+  HostTask* t = currentTask;
+  if (!t) {
+    advanceTo(wakeAtUs);
+    return;
+  }
+  std::unique_lock<std::mutex> lock(scheduler().mutex);
+  blockTask(lock, t, wakeAtUs, false);
+}
+
+uint32_t adcStrayEvery = 0;
+
+uint64_t conversionsDone(const adc_continuous_ctx_t* h) {
+  return (hostClockNowUs() - h->startUs) * h->freqHz / 1000000;
+}
+
+}  // namespace
+
+void hostSetAdcStrays(uint32_t every) {
+  adcStrayEvery = every;
+}
+
+esp_err_t adc_continuous_new_handle(const adc_continuous_handle_cfg_t* hdl_config,
+                                    adc_continuous_handle_t* ret_handle) {
+  if (!hdl_config || !ret_handle || !hdl_config->conv_frame_size ||
+      hdl_config->conv_frame_size % SOC_ADC_DIGI_RESULT_BYTES ||
+      hdl_config->max_store_buf_size < hdl_config->conv_frame_size) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  *ret_handle = new adc_continuous_ctx_t{hdl_config->conv_frame_size,
+                                         hdl_config->max_store_buf_size, 0, 0, false, false, 0, 0};
+  return ESP_OK;
+}
+
+esp_err_t adc_continuous_config(adc_continuous_handle_t handle, const adc_continuous_config_t* config) {
+  if (!handle || !config || config->pattern_num != 1 || !config->adc_pattern ||
+      config->adc_pattern[0].unit != ADC_UNIT_1 || config->conv_mode != ADC_CONV_SINGLE_UNIT_1 ||
+      config->format != ADC_DIGI_OUTPUT_FORMAT_TYPE2 || !config->sample_freq_hz) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (handle->running) return ESP_ERR_INVALID_STATE;
+  handle->freqHz = config->sample_freq_hz;
+  handle->channel = config->adc_pattern[0].channel;
+  handle->configured = true;
+  return ESP_OK;
+}
+
+esp_err_t adc_continuous_start(adc_continuous_handle_t handle) {
+  if (!handle || !handle->configured || handle->running) return ESP_ERR_INVALID_STATE;
+  handle->running = true;
+  handle->startUs = hostClockNowUs();
+  handle->taken = 0;
+  return ESP_OK;
+}
+
+esp_err_t adc_continuous_read(adc_continuous_handle_t handle, uint8_t* buf, uint32_t length_max,
+                              uint32_t* out_length, uint32_t timeout_ms) {
+  *out_length = 0;
+  if (!handle || !handle->running) return ESP_ERR_INVALID_STATE;
+  const uint32_t frame = handle->frameBytes / SOC_ADC_DIGI_RESULT_BYTES;
+  const uint32_t poolFrames = handle->poolBytes / handle->frameBytes;
+  if (length_max < handle->frameBytes) return ESP_ERR_INVALID_ARG;
+
+  uint64_t giveUpUs = timeout_ms == ADC_MAX_DELAY ? NEVER : hostClockNowUs() + (uint64_t)timeout_ms * 1000;
+  uint64_t ready;
+  while ((ready = (conversionsDone(handle) - handle->taken) / frame) == 0) {
+    if (hostClockNowUs() >= giveUpUs) return ESP_ERR_TIMEOUT;
+    uint64_t doneAtUs = handle->startUs +
+                        ((handle->taken + frame) * 1000000 + handle->freqHz - 1) / handle->freqHz;
+    sleepUntilUs(std::min(doneAtUs, giveUpUs));
+  }
+  if (ready > poolFrames) {
+    handle->taken += (ready - poolFrames) * frame;
+    ready = poolFrames;
+  }
+  uint32_t n = (uint32_t)std::min<uint64_t>(ready, length_max / handle->frameBytes) * frame;
+  for (uint32_t i = 0; i < n; i++) {
+    // Every adcStrayEvery-th conversion comes from the next channel over
+    uint8_t channel = handle->channel;
+    if (adcStrayEvery && (handle->taken + i + 1) % adcStrayEvery == 0) channel = (channel + 1) % 10;
+    adc_digi_output_data_t d = {};
+    d.type2.data = analogSource(channel + 1) & 0xFFF;  // ADC1 channel n is GPIO n + 1
+    d.type2.channel = channel;
+    d.type2.unit = 0;
+    memcpy(buf + i * SOC_ADC_DIGI_RESULT_BYTES, &d, SOC_ADC_DIGI_RESULT_BYTES);
+  }
+  handle->taken += n;
+  *out_length = n * SOC_ADC_DIGI_RESULT_BYTES;
+  return ESP_OK;
+}
+
+esp_err_t adc_continuous_stop(adc_continuous_handle_t handle) {
+  if (!handle || !handle->running) return ESP_ERR_INVALID_STATE;
+  handle->running = false;
+  return ESP_OK;
+}
+
+esp_err_t adc_continuous_deinit(adc_continuous_handle_t handle) {
+  if (!handle) return ESP_ERR_INVALID_ARG;
+  if (handle->running) return ESP_ERR_INVALID_STATE;
+  delete handle;
+  return ESP_OK;
+}
+
+esp_err_t adc_continuous_io_to_channel(int io_num, adc_unit_t* unit_id, adc_channel_t* channel) {
+  // ESP32-S3: GPIO 1-10 are ADC1 channels 0-9, GPIO 11-20 ADC2's
+  if (io_num >= 1 && io_num <= 10) {
+    *unit_id = ADC_UNIT_1;
+    *channel = (adc_channel_t)(io_num - 1);
+  } else if (io_num >= 11 && io_num <= 20) {
+    *unit_id = ADC_UNIT_2;
+    *channel = (adc_channel_t)(io_num - 11);
+  } else {
+    return ESP_ERR_INVALID_ARG;
+  }
+  return ESP_OK;
+}
+
+// ===== SERIAL =====
+
+namespace {
+
+std::deque<char> serialIn;
+FILE* serialFile = stdout;
+std::string* serialCapture = nullptr;
+
+}  // namespace
+
+size_t HardwareSerial::write(const uint8_t* buf, size_t n) {
+  if (serialFile) fwrite(buf, 1, n, serialFile);
+  if (serialCapture) serialCapture->append((const char*)buf, n);
+  return n;
+}
+
+int HardwareSerial::available() {
+  return (int)serialIn.size();
+}
+
+int HardwareSerial::read() {
+  if (serialIn.empty()) return -1;
+  char c = serialIn.front();
+  serialIn.pop_front();
+  return (uint8_t)c;
+}
+
+int HardwareSerial::peek() {
+  return serialIn.empty() ? -1 : (uint8_t)serialIn.front();
+}
+
+void hostSerialInput(const char* text) {
+  serialIn.insert(serialIn.end(), text, text + strlen(text));
+}
+
+void hostSerialOutput(FILE* file, std::string* capture) {
+  serialFile = file;
+  serialCapture = capture;
+}
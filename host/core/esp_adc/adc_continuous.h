@@ -0,0 +1,86 @@
+// Host stand-in for ESP-IDF's continuous (DMA) ADC driver, the parts the
+// sketch uses, as on the ESP32-S3: ADC1 only, one channel, TYPE2 results.
+//
+// Conversions run off the virtual clock at the configured rate and read
+// the analogRead() source (hostSetAnalogSource()), the ADC1 channel's GPIO
+// as the pin. adc_continuous_read() blocks until a whole conversion frame
+// is done or the timeout passes, and hands out whole frames only. Frames
+// the reader leaves in the pool beyond max_store_buf_size are dropped,
+// oldest first, as the driver does.
+#pragma once
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_TIMEOUT 0x107
+
+#define ADC_MAX_DELAY UINT32_MAX
+#define SOC_ADC_DIGI_MAX_BITWIDTH 12
+#define SOC_ADC_DIGI_RESULT_BYTES 4
+
+typedef enum { ADC_UNIT_1, ADC_UNIT_2 } adc_unit_t;
+
+typedef enum {
+  ADC_CHANNEL_0, ADC_CHANNEL_1, ADC_CHANNEL_2, ADC_CHANNEL_3, ADC_CHANNEL_4,
+  ADC_CHANNEL_5, ADC_CHANNEL_6, ADC_CHANNEL_7, ADC_CHANNEL_8, ADC_CHANNEL_9
+} adc_channel_t;
+
+typedef enum { ADC_ATTEN_DB_0, ADC_ATTEN_DB_2_5, ADC_ATTEN_DB_6, ADC_ATTEN_DB_12 } adc_atten_t;
+
+typedef enum {
+  ADC_CONV_SINGLE_UNIT_1 = 1,
+  ADC_CONV_SINGLE_UNIT_2,
+  ADC_CONV_BOTH_UNIT,
+  ADC_CONV_ALTER_UNIT
+} adc_digi_convert_mode_t;
+
+typedef enum { ADC_DIGI_OUTPUT_FORMAT_TYPE1, ADC_DIGI_OUTPUT_FORMAT_TYPE2 } adc_digi_output_format_t;
+
+typedef struct {
+  uint8_t atten;
+  uint8_t channel;
+  uint8_t unit;
+  uint8_t bit_width;
+} adc_digi_pattern_config_t;
+
+typedef struct {
+  uint32_t max_store_buf_size;
+  uint32_t conv_frame_size;
+} adc_continuous_handle_cfg_t;
+
+typedef struct {
+  uint32_t pattern_num;
+  adc_digi_pattern_config_t* adc_pattern;
+  uint32_t sample_freq_hz;
+  adc_digi_convert_mode_t conv_mode;
+  adc_digi_output_format_t format;
+} adc_continuous_config_t;
+
+typedef struct {
+  union {
+    struct {
+      uint32_t data : 12;
+      uint32_t reserved12 : 1;
+      uint32_t channel : 4;
+      uint32_t unit : 1;
+      uint32_t reserved17_31 : 14;
+    } type2;
+    uint32_t val;
+  };
+} adc_digi_output_data_t;
+
+typedef struct adc_continuous_ctx_t* adc_continuous_handle_t;
+
+esp_err_t adc_continuous_new_handle(const adc_continuous_handle_cfg_t* hdl_config,
+                                    adc_continuous_handle_t* ret_handle);
+esp_err_t adc_continuous_config(adc_continuous_handle_t handle, const adc_continuous_config_t* config);
+esp_err_t adc_continuous_start(adc_continuous_handle_t handle);
+esp_err_t adc_continuous_read(adc_continuous_handle_t handle, uint8_t* buf, uint32_t length_max,
+                              uint32_t* out_length, uint32_t timeout_ms);
+esp_err_t adc_continuous_stop(adc_continuous_handle_t handle);
+esp_err_t adc_continuous_deinit(adc_continuous_handle_t handle);
+esp_err_t adc_continuous_io_to_channel(int io_num, adc_unit_t* unit_id, adc_channel_t* channel);
@@ -0,0 +1,50 @@
+// SPI.h and LittleFS.h for host builds
+#include "LittleFS.h"
+#include "SPI.h"
+
+SPIClass SPI;
+LittleFSFS LittleFS;
+
+size_t File::write(const uint8_t* buf, size_t n) {
+  if (!data || !writable) return 0;
+  if (pos + n > data->size()) data->resize(pos + n);
+  memcpy(data->data() + pos, buf, n);
+  pos += n;
+  return n;
+}
+
+int File::available() {
+  return data ? (int)(data->size() - pos) : 0;
+}
+
+int File::read() {
+  if (!data || pos >= data->size()) return -1;
+  return (*data)[pos++];
+}
+
+int File::peek() {
+  if (!data || pos >= data->size()) return -1;
+  return (*data)[pos];
+}
+
+bool File::seek(uint32_t to) {
+  if (!data || to > data->size()) return false;
+  pos = to;
+  return true;
+}
+
+File LittleFSFS::open(const char* path, const char* mode) {
+  auto it = files.find(path);
+  if (mode[0] == 'r') {
+    if (it == files.end()) return File();
+    return File(it->second, false);
+  }
+  if (it == files.end() || mode[0] == 'w') {
+    // Open handles keep the old contents, as a replaced file would on flash
+    files[path] = std::make_shared<std::vector<uint8_t>>();
+    it = files.find(path);
+  }
+  File f(it->second, true);
+  if (mode[0] == 'a') f.seek(it->second->size());
+  return f;
+}
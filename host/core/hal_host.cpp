@@ -0,0 +1,39 @@
+// hal.h for host builds: a virtual clock that only moves when told to, and
+// real time for measuring the code (halWallMicros, and nanoseconds for the
+// profiler's cycle counter)
+#include "hal.h"
+
+#include <atomic>
+#include <chrono>
+
+static std::atomic<uint64_t> hostClockUs{0};
+
+uint32_t halMillis() {
+  return (uint32_t)(hostClockUs.load(std::memory_order_relaxed) / 1000);
+}
+
+uint32_t halMicros() {
+  return (uint32_t)hostClockUs.load(std::memory_order_relaxed);
+}
+
+uint64_t hostClockNowUs() {
+  return hostClockUs.load(std::memory_order_relaxed);
+}
+
+void halAdvanceUs(uint64_t us) {
+  hostClockUs.fetch_add(us, std::memory_order_relaxed);
+}
+
+uint32_t halWallMicros() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t halCycles() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+float halCyclesPerUs() {
+  return 1000.0f;
+}
@@ -0,0 +1,402 @@
+// Headless auto-tune simulator. The whole sketch - setup(), loop(), its
+// FreeRTOS tasks, the display and servo code - is built against the host
+// core in host/core and run on its virtual clock. A scripted user presses
+// the real buttons through their pins, the guitar model in sim_model.h
+// turns the angle last written to the servo into pitch, and a sample task
+// plays that into the ring in place of the ADC. Scenarios are the device
+// "sim" command's: run r draws its strings from seed 1000 + r.
+//
+//   tuner_sim [--runs N] [--servo step|adaptive|compare] [--serial] [--record rec.txt]
+//   tuner_sim [--file host.wav=/a2.wav] --command "selftest wav /a2.wav 110"
+//   tuner_sim --replay rec.txt
+//
+// The first form prints the "sim" report (a JSON line per run, then the
+// summary); --serial also shows the sketch's own serial output on stderr.
+// "--servo compare" runs the same scenarios under the step table and then
+// the adaptive controller, prints both summaries and a comparison line, and
+// fails unless adaptive tunes at least as many strings in less time.
+// --record logs the runs with the frame recorder and writes the log as
+// "rec dump" prints it.
+// --command types a serial command after setup() and prints what the
+// sketch answers - the device-side simulator, selftest, bench and so on;
+// repeated, the commands run in order. --file copies a file from disk into
+// the sketch's LittleFS first, so recordings can be run through "selftest
+// wav" or "rec load".
+// --replay runs a recording through "replay": a "rec dump" capture from the
+// device's serial port (other output around it is skipped), or the
+// /rec.bin image "rec save" writes.
+// Everything but wall_ms and speedup repeats exactly for a given build.
+#include "code.cpp"
+
+#include <chrono>
+#include <climits>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+const unsigned long SIM_CLICK_MS = 120;       // A short press
+const unsigned long SIM_LONG_PRESS_MS = 1000;  // Long TOGGLE starts auto-tune all
+
+// Plays the string under test into the ring at the sample rate, stepping
+// the string model along with the servo once per tick. The servo horn is
+// off the peg while the motor recenters at a limit, so that move shifts
+// the model instead of tuning it.
+class SimSource : public TaskSampleSource {
+public:
+  SimString* string = nullptr;  // nullptr: nothing to play
+  SimTone tone;
+  bool pluckPending = false;
+
+  bool begin(SampleRing* r) override {
+    ring = r;
+    startUs = lastUs = hostClockNowUs();
+    produced = 0;
+    lastAngle = tunerServo.read();
+    return startTask("sim", 2048, 5);
+  }
+
+protected:
+  void poll() override {
+    step(hostClockNowUs());
+    vTaskDelay(1);
+  }
+
+private:
+  void step(uint64_t nowUs) {
+    int angle = tunerServo.read();
+    if (string) {
+      if (servoReturningToCenter) string->shift(angle - lastAngle);
+      string->follow(angle, (nowUs - lastUs) / 1000.0f);
+    }
+    lastAngle = angle;
+    lastUs = nowUs;
+    if (pluckPending) {
+      tone.pluck();
+      pluckPending = false;
+    }
+    float hz = string ? string->hz() : 0.0f;
+    uint64_t due = (nowUs - startUs) * (uint64_t)SAMPLING_FREQ / 1000000;
+    for (; produced < due; produced++) {
+      int16_t raw = tone.next(hz);
+      frameRecorder.sample(raw);
+      ring->push(raw);
+    }
+  }
+
+  uint64_t startUs = 0, lastUs = 0, produced = 0;
+  int lastAngle = 0;
+};
+
+SimSource simSource;
+
+// Report output, kept apart from the sketch's Serial
+class FilePrint : public Print {
+public:
+  explicit FilePrint(FILE* f) : f(f) {}
+  size_t write(uint8_t c) override { return fputc(c, f) == EOF ? 0 : 1; }
+  size_t write(const uint8_t* buf, size_t n) override { return fwrite(buf, 1, n, f); }
+
+private:
+  FILE* f;
+};
+
+// Holds one button down for a while; buttons pull up, so pressed is LOW
+struct Finger {
+  int pin = -1;
+  unsigned long releaseAt = 0;
+
+  bool busy() const { return pin >= 0; }
+
+  void press(int p, unsigned long now, unsigned long ms) {
+    pin = p;
+    releaseAt = now + ms;
+    hostSetPin(pin, LOW);
+  }
+
+  void update(unsigned long now) {
+    if (busy() && now >= releaseAt) {
+      hostSetPin(pin, HIGH);
+      pin = -1;
+    }
+  }
+};
+
+// Auto-tunes all six strings through the buttons, as simulateAutoTune()
+// does on the device. Returns the virtual run time.
+unsigned long runScenario(uint32_t seed, SimResult results[6]) {
+  SimRng rng(seed);
+  SimString strings[6];
+  simDrawStrings(rng, tuningModes[tuningMode].freqs, strings);
+  for (int s = 0; s < 6; s++) {
+    results[s] = SimResult{strings[s].detune, strings[s].gain, false, 0, 0, 0, 0, 0.0f};
+    servoGain[s] = SERVO_GAIN_INIT;  // Nothing learned yet, as after power-up
+  }
+  simSource.tone = SimTone();
+  simSource.tone.rng = rng.state;
+  simSource.string = nullptr;
+
+  Finger finger;
+  const unsigned long start = millis();
+  const unsigned long limitMs = 200 + 6 * (AUTO_TUNE_TIMEOUT + 4000);
+  bool started = false, wasWaiting = false, wasReturning = false;
+  int cur = -1;
+  unsigned long selectDue = 0, pluckDue = 0, lastPluck = 0;
+  unsigned long stringStart = 0, selectAt = 0;
+  int lastAngle = tunerServo.read();
+
+  while (millis() - start < limitMs) {
+    unsigned long now = millis() - start;
+    finger.update(millis());
+
+    if (!started) {
+      if (now >= 200 && currentState == STATE_STANDBY) {
+        finger.press(BTN_TOGGLE, millis(), SIM_LONG_PRESS_MS);
+        started = true;
+      }
+    } else if (currentState != STATE_AUTO_TUNE_ALL && !finger.busy()) {
+      if (cur >= 0) break;  // Finished
+    }
+
+    if (currentState == STATE_AUTO_TUNE_ALL) {
+      int s = autoTuneCurrentString;
+      if (s != cur) {
+        cur = s;
+        strings[s].engage(tunerServo.read());
+        simSource.string = &strings[s];
+        stringStart = now;
+        selectAt = 0;
+        selectDue = now + SIM_SELECT_DELAY;
+        wasWaiting = true;
+      }
+      if (waitingForConfirm && !wasWaiting && !showSuccessAnimation) {
+        selectDue = now + SIM_SELECT_DELAY;  // Stopped at the servo limit
+      }
+
+      if (selectDue && now >= selectDue && !finger.busy()) {
+        bool recenter = servoLimitReached && !servoReturningToCenter;
+        finger.press(BTN_SELECT, millis(), SIM_CLICK_MS);
+        if (recenter) {
+          results[s].limits++;
+          selectDue = now + SIM_CLICK_MS + SIM_RECENTER_DELAY;
+        } else {
+          selectDue = 0;
+          pluckDue = now + SIM_CLICK_MS + SIM_PLUCK_DELAY;
+          if (!selectAt) selectAt = now + SIM_CLICK_MS;  // The press counts on release
+        }
+      }
+
+      if (pluckDue && now >= pluckDue) {
+        simSource.pluckPending = true;
+        lastPluck = now;
+        pluckDue = 0;
+      } else if (!waitingForConfirm && !showSuccessAnimation && selectAt &&
+                 now - lastPluck >= SIM_REPLUCK_PERIOD) {
+        simSource.pluckPending = true;
+        lastPluck = now;
+      }
+
+      if (showSuccessAnimation && !results[s].tuned) {
+        results[s].tuned = true;
+        results[s].tuneMs = now - selectAt;
+        results[s].finalCents = strings[s].settledCents(tunerServo.read());
+      }
+
+      // The firmware leaves a stuck string to the user; like the device's
+      // script, this one moves on (there is no button for that)
+      if (!results[s].tuned && now - stringStart >= AUTO_TUNE_TIMEOUT) {
+        results[s].finalCents = strings[s].settledCents(tunerServo.read());
+        autoTuneGoTo(s + 1);
+      }
+      wasWaiting = waitingForConfirm;
+    }
+
+    loop();
+
+    // Servo travel while tuning; the recenter at a limit doesn't count
+    int angle = tunerServo.read();
+    if (cur >= 0 && currentState == STATE_AUTO_TUNE_ALL && angle != lastAngle &&
+        !(servoReturningToCenter && !wasReturning)) {
+      results[cur].travel += abs(angle - lastAngle);
+      results[cur].moves++;
+    }
+    lastAngle = angle;
+    wasReturning = servoReturningToCenter;
+  }
+
+  simSource.string = nullptr;
+  finger.update(ULONG_MAX);
+  return millis() - start;
+}
+
+// Types 'command' and runs loop() until the sketch has answered it
+void runCommand(const std::string &command) {
+  hostSerialInput((command + "\n").c_str());
+  while (Serial.available()) loop();
+}
+
+// "host/path=/littlefs/path" into LittleFS
+bool loadFile(const std::string &spec) {
+  size_t eq = spec.find('=');
+  if (eq == std::string::npos) return false;
+  std::ifstream in(spec.substr(0, eq), std::ios::binary);
+  if (!in) return false;
+  auto bytes = std::make_shared<std::vector<uint8_t>>((std::istreambuf_iterator<char>(in)),
+                                                      std::istreambuf_iterator<char>());
+  LittleFS.hostFiles()[spec.substr(eq + 1)] = bytes;
+  return true;
+}
+
+// A recording as "rec load" reads it: the file itself if it is a log image,
+// otherwise the hex between "rec: begin" and "rec: end"
+bool readRecording(const std::string &path, std::vector<uint8_t> &image) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return false;
+  std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  if (text.size() >= 4 && memcmp(text.data(), &REC_MAGIC, 4) == 0) {
+    image.assign(text.begin(), text.end());
+    return true;
+  }
+  size_t begin = text.find("rec: begin");
+  if (begin == std::string::npos) return false;
+  begin = text.find('\n', begin);
+  size_t end = text.find("rec: end", begin);
+  if (begin == std::string::npos || end == std::string::npos) return false;
+  image.clear();
+  int hi = -1;
+  for (size_t i = begin; i < end; i++) {
+    char c = text[i];
+    if (!isxdigit((unsigned char)c)) continue;  // Line breaks, and the CR a serial capture adds
+    int v = isdigit((unsigned char)c) ? c - '0' : (c | 0x20) - 'a' + 10;
+    if (hi < 0) {
+      hi = v;
+    } else {
+      image.push_back((uint8_t)(hi << 4 | v));
+      hi = -1;
+    }
+  }
+  return hi < 0 && image.size() >= sizeof(RecordHeader);
+}
+
+// Stops the recorder and writes the log as "rec dump" prints it
+bool writeRecording(const std::string &path, Print &log) {
+  handleRecordCommand("stop", log);
+  FILE* f = fopen(path.c_str(), "w");
+  if (!f) return false;
+  FilePrint file(f);
+  handleRecordCommand("dump", file);
+  return fclose(f) == 0;
+}
+
+// Runs scenarios 0..runs-1 under the current servoControlMode, printing the
+// report; returns the totals
+SimTotals runScenarios(int runs, Print &out) {
+  SimTotals totals = {0, 0, 0, 0, 0.0f, 0.0f, 0.0};
+  auto t0 = std::chrono::steady_clock::now();
+  for (int r = 0; r < runs; r++) {
+    SimResult res[6];
+    unsigned long ms = runScenario(1000 + r, res);
+    printSimRun(r, ms, res, totals, out);
+  }
+  auto elapsed = std::chrono::steady_clock::now() - t0;
+  printSimSummary(totals,
+                  (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count(),
+                  out);
+  return totals;
+}
+
+float meanTuneMs(const SimTotals &t) {
+  return t.tuned ? t.tuneMs / t.tuned : 0.0f;
+}
+
+void usage() {
+  fprintf(stderr,
+          "usage: tuner_sim [--runs N] [--servo step|adaptive|compare] [--serial] [--record <file>]\n"
+          "       tuner_sim [--file <disk path>=<LittleFS path>]... --command \"<serial command>\"...\n"
+          "       tuner_sim --replay <file>\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int runs = 1;
+  bool showSerial = false, compare = false;
+  std::vector<std::string> commands;
+  std::string recordPath, replayPath;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--runs" && i + 1 < argc) {
+      runs = std::max(1, atoi(argv[++i]));
+    } else if (arg == "--servo" && i + 1 < argc) {
+      std::string mode = argv[++i];
+      if (mode == "step") servoControlMode = SERVO_CTRL_STEP;
+      else if (mode == "adaptive") servoControlMode = SERVO_CTRL_ADAPTIVE;
+      else if (mode == "compare") compare = true;
+      else return usage(), 2;
+    } else if (arg == "--command" && i + 1 < argc) {
+      commands.push_back(argv[++i]);
+    } else if (arg == "--record" && i + 1 < argc) {
+      recordPath = argv[++i];
+    } else if (arg == "--replay" && i + 1 < argc) {
+      replayPath = argv[++i];
+    } else if (arg == "--file" && i + 1 < argc) {
+      if (!loadFile(argv[++i])) {
+        fprintf(stderr, "tuner_sim: can't read %s\n", argv[i]);
+        return 2;
+      }
+    } else if (arg == "--serial") {
+      showSerial = true;
+    } else {
+      return usage(), 2;
+    }
+  }
+
+  sampleSource = &simSource;
+  if (!replayPath.empty()) {
+    std::vector<uint8_t> image;
+    if (!readRecording(replayPath, image)) {
+      fprintf(stderr, "tuner_sim: no recording in %s\n", replayPath.c_str());
+      return 2;
+    }
+    LittleFS.hostFiles()[REC_PATH] = std::make_shared<std::vector<uint8_t>>(image);
+    commands = {"rec load", "replay"};
+  }
+  if (!commands.empty()) {
+    hostSerialOutput(nullptr);
+    setup();
+    traceOutput = TRACE_OUT_OFF;
+    hostSerialOutput(stdout);
+    for (const std::string &command : commands) runCommand(command);
+    return replayPath.empty() || frameRecorder.sampleBytes() ? 0 : 1;
+  }
+
+  hostSerialOutput(showSerial ? stderr : nullptr);
+  setup();
+  if (!showSerial) traceOutput = TRACE_OUT_OFF;
+
+  FilePrint out(stdout), log(stderr);
+  if (!recordPath.empty()) handleRecordCommand("start", log);
+
+  bool ok = true;
+  if (!compare) {
+    runScenarios(runs, out);
+  } else {
+    servoControlMode = SERVO_CTRL_STEP;
+    SimTotals step = runScenarios(runs, out);
+    servoControlMode = SERVO_CTRL_ADAPTIVE;
+    SimTotals adaptive = runScenarios(runs, out);
+    ok = adaptive.tuned >= step.tuned && meanTuneMs(adaptive) < meanTuneMs(step);
+    out.printf("{\"compare\":{\"step_tuned\":%d,\"adaptive_tuned\":%d,\"step_mean_tune_ms\":%.0f,"
+               "\"adaptive_mean_tune_ms\":%.0f,\"adaptive_better\":%s}}\n",
+               step.tuned, adaptive.tuned, meanTuneMs(step), meanTuneMs(adaptive),
+               ok ? "true" : "false");
+  }
+
+  if (!recordPath.empty() && !writeRecording(recordPath, log)) {
+    fprintf(stderr, "tuner_sim: can't write %s\n", recordPath.c_str());
+    return 2;
+  }
+  return ok ? 0 : 1;
+}
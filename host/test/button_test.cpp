@@ -0,0 +1,105 @@
+// Button press classification from timestamped edge sequences. The
+// classifier is serviced once per ms, as the button task would be; a stall
+// is a stretch where nothing is serviced and edges queue up with their
+// timestamps, as they do behind a long DSP frame or display flush.
+#include "code.cpp"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace {
+
+struct Edge {
+  unsigned long ms;
+  bool pressed;
+};
+
+struct Emitted {
+  unsigned long ms;
+  int action;
+
+  bool operator==(const Emitted &o) const { return ms == o.ms && action == o.action; }
+};
+
+void PrintTo(const Emitted &e, std::ostream* os) {
+  *os << "{" << e.ms << " ms, action " << e.action << "}";
+}
+
+// Services a classifier every ms up to 'untilMs', skipping [stallFrom, stallTo)
+std::vector<Emitted> classify(const std::vector<Edge> &edges, unsigned long untilMs,
+                              unsigned long stallFrom = 0, unsigned long stallTo = 0) {
+  ButtonClassifier c;
+  std::vector<Emitted> out;
+  size_t next = 0;
+  for (unsigned long t = 0; t <= untilMs; t++) {
+    if (t >= stallFrom && t < stallTo) continue;
+    for (; next < edges.size() && edges[next].ms <= t; next++) {
+      if (int a = c.edge(edges[next].pressed, edges[next].ms)) out.push_back({t, a});
+    }
+    if (int a = c.poll(t)) out.push_back({t, a});
+  }
+  return out;
+}
+
+TEST(ButtonClassifier, BounceIsOnePress) {
+  std::vector<Edge> edges = {{0, true},   {2, false},   {4, true},   {7, false}, {9, true},
+                             {300, false}, {302, true}, {305, false}};
+  // Dated to the first edge of each burst, emitted once the release has held
+  EXPECT_EQ(classify(edges, 3000), (std::vector<Emitted>{{325, 1}}));
+}
+
+TEST(ButtonClassifier, BounceWithoutAPressIsNothing) {
+  EXPECT_TRUE(classify({{0, true}, {5, false}}, 3000).empty());
+  EXPECT_TRUE(classify({{0, true}, {30, false}}, 3000).empty());  // Under BUTTON_CLICK_MS
+}
+
+TEST(ButtonClassifier, Click) {
+  EXPECT_EQ(classify({{100, true}, {220, false}}, 3000), (std::vector<Emitted>{{240, 1}}));
+}
+
+TEST(ButtonClassifier, LongPressAt800Ms) {
+  EXPECT_EQ(classify({{0, true}, {799, false}}, 3000), (std::vector<Emitted>{{819, 1}}));
+  EXPECT_EQ(classify({{0, true}, {800, false}}, 3000), (std::vector<Emitted>{{820, 2}}));
+}
+
+TEST(ButtonClassifier, VeryLongPressFiresAt2000MsWhileHeld) {
+  // The release at 2500 is swallowed
+  EXPECT_EQ(classify({{0, true}, {2500, false}}, 4000), (std::vector<Emitted>{{2000, 3}}));
+  EXPECT_EQ(classify({{0, true}, {1999, false}}, 4000), (std::vector<Emitted>{{2019, 2}}));
+}
+
+TEST(ButtonClassifier, ReleaseDuringAStall) {
+  // Press still settling when the stall starts; the release is queued
+  // behind it and must not merge into the press's bounce burst
+  EXPECT_EQ(classify({{0, true}, {150, false}}, 3000, 10, 1000),
+            (std::vector<Emitted>{{1000, 1}}));
+  EXPECT_EQ(classify({{0, true}, {900, false}}, 3000, 10, 1500),
+            (std::vector<Emitted>{{1500, 2}}));
+  // Press and release both inside the stall
+  EXPECT_EQ(classify({{100, true}, {250, false}}, 3000, 50, 1000),
+            (std::vector<Emitted>{{1000, 1}}));
+}
+
+// Through the queues: two clicks land in buttonEdges during a stall, and
+// serviceButtons() must hand both to loop()
+TEST(ServiceButtons, TwoClicksQueuedDuringAStall) {
+  uint32_t t0 = millis();
+  uint32_t edges[][2] = {{0, 1}, {150, 0}, {400, 1}, {550, 0}};
+  for (auto &e : edges) buttonEdges.push(ButtonEvent{t0 + e[0], 1, (uint8_t)e[1]});
+  delay(1000);
+  EXPECT_EQ(serviceButtons(), -1);  // Both settled, nothing pending
+
+  std::vector<ButtonEvent> presses;
+  ButtonEvent e;
+  while (buttonPresses.pop(e)) presses.push_back(e);
+  ASSERT_EQ(presses.size(), 2u);
+  EXPECT_EQ(presses[0].ms, t0 + 400);  // Settled by the second click's edge
+  EXPECT_EQ(presses[1].ms, t0 + 1000);
+  for (const ButtonEvent &p : presses) {
+    EXPECT_EQ(p.button, 1);
+    EXPECT_EQ(p.value, 1);
+  }
+}
+
+}  // namespace
@@ -0,0 +1,251 @@
+// Two-thread stress tests for the sketch's lock-free handoffs: the pitch
+// mailbox, the button event queue, the trace ring, the frame recorder, and
+// the DSP task against loop(). They are built with
+// -fsanitize=thread, so besides the checks below any unsynchronized access
+// fails the run. Each record is filled from one counter, so a torn read
+// shows up as fields that disagree.
+#include "code.cpp"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+namespace {
+
+const uint32_t MAILBOX_RECORDS = 200000;
+const uint32_t QUEUE_EVENTS = 200000;
+const uint32_t TRACE_RECORDS_PER_PRODUCER = 100000;
+const int16_t REC_STEP = 100;  // Past a one-byte delta, so every sample takes two bytes
+const int REC_RESTARTS = 200;
+const uint32_t REC_RESTART_SAMPLES = 32;  // Recorded after each restart before it is checked
+const uint32_t DSP_FRAMES = 400;
+const float DSP_TONE_HZ = 110.0f;
+
+PitchResult mailboxRecord(uint32_t n) {
+  PitchResult r;
+  r.freq = (float)n;
+  r.signalLevel = 2.0f * n;
+  r.lagQ15 = (int32_t)n;
+  r.expectedFreq = 3.0f * n;
+  r.timeMs = n;
+  return r;
+}
+
+TEST(PitchMailbox, EveryReadIsAWholeOldOrNewRecord) {
+  PitchMailbox box;
+  std::atomic<bool> done{false};
+
+  std::thread writer([&] {
+    for (uint32_t n = 1; n <= MAILBOX_RECORDS; n++) box.publish(mailboxRecord(n));
+    done.store(true, std::memory_order_release);
+  });
+
+  uint32_t lastSeq = 0, lastN = 0, reads = 0;
+  bool finished = false;
+  while (!finished) {
+    finished = done.load(std::memory_order_acquire);  // One more read after the last publish
+    PitchResult r;
+    if (!box.read(r, lastSeq)) continue;
+    uint32_t n = (uint32_t)r.lagQ15;
+    ASSERT_EQ(r.freq, (float)n);
+    ASSERT_EQ(r.signalLevel, 2.0f * n);
+    ASSERT_EQ(r.expectedFreq, 3.0f * n);
+    ASSERT_EQ(r.timeMs, (unsigned long)n);
+    ASSERT_GT(n, lastN) << "read went back to an older record";
+    lastN = n;
+    reads++;
+  }
+  writer.join();
+
+  EXPECT_EQ(lastN, MAILBOX_RECORDS);
+  EXPECT_GT(reads, 0u);
+  PitchResult r;
+  EXPECT_FALSE(box.read(r, lastSeq));  // Nothing newer than the last record
+}
+
+TEST(ButtonEventQueue, DeliversEveryEventInOrder) {
+  ButtonEventQueue queue;
+
+  std::thread producer([&] {
+    for (uint32_t n = 0; n < QUEUE_EVENTS; n++) {
+      ButtonEvent e = {n, (uint8_t)(n & 1), (uint8_t)(n * 7)};
+      while (!queue.push(e)) std::this_thread::yield();  // Full: the ISR would drop, the test waits
+    }
+  });
+
+  for (uint32_t n = 0; n < QUEUE_EVENTS;) {
+    ButtonEvent e;
+    if (!queue.pop(e)) {
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_EQ(e.ms, n);
+    ASSERT_EQ(e.button, (uint8_t)(n & 1));
+    ASSERT_EQ(e.value, (uint8_t)(n * 7));
+    n++;
+  }
+  producer.join();
+
+  ButtonEvent e;
+  EXPECT_FALSE(queue.pop(e));
+}
+
+TEST(TraceRing, TwoProducersLoseNothingButDrops) {
+  TraceRing ring;
+  std::atomic<int> producing{2};
+
+  auto produce = [&](uint8_t event) {
+    for (uint32_t n = 0; n < TRACE_RECORDS_PER_PRODUCER; n++) {
+      ring.log(event, (float)n, (int)(n & 0x7FFF), event, 2.0f * n);
+    }
+    producing.fetch_sub(1, std::memory_order_release);
+  };
+  std::thread a(produce, (uint8_t)1), b(produce, (uint8_t)2);
+
+  // Per producer, records must come out whole and in the order logged
+  int64_t last[3] = {-1, -1, -1};
+  uint32_t popped = 0;
+  while (true) {
+    bool finished = producing.load(std::memory_order_acquire) == 0;
+    TraceRecord r;
+    bool any = false;
+    while (ring.pop(r)) {
+      any = true;
+      ASSERT_TRUE(r.event == 1 || r.event == 2);
+      ASSERT_EQ(r.servoPos, r.event);
+      uint32_t n = (uint32_t)r.value;
+      ASSERT_EQ(r.value, (float)n);
+      ASSERT_EQ(r.cents, (int16_t)(n & 0x7FFF));
+      ASSERT_EQ(r.level, 2.0f * n);
+      ASSERT_GT((int64_t)n, last[r.event]);
+      last[r.event] = n;
+      popped++;
+    }
+    if (finished && !any) break;
+  }
+  a.join();
+  b.join();
+
+  EXPECT_EQ(popped + ring.droppedCount(), 2 * TRACE_RECORDS_PER_PRODUCER);
+  EXPECT_GT(popped, 0u);
+}
+
+// The acquisition task records until the buffer is full while loop() reads
+// the counters and decodes what has been published so far
+TEST(FrameRecorder, LoopSeesWholeSamplesAndTheOverflow) {
+  FrameRecorder rec;
+  ASSERT_TRUE(rec.start());
+  const uint32_t capacity = REC_SAMPLE_BYTES / 2;
+
+  std::thread acquisition([&] {
+    for (uint32_t n = 0; n <= capacity; n++) rec.sample((int16_t)((n * REC_STEP) & 0x3FFF));
+  });
+
+  uint32_t decoded = 0;
+  while (true) {
+    bool full = rec.overflowed();
+    RecordReader reader = {rec.bytes, rec.bytes + rec.sampleBytes(), 0};
+    decoded = 0;
+    int16_t raw;
+    while (reader.next(raw)) {
+      ASSERT_EQ(raw, (int16_t)((decoded * REC_STEP) & 0x3FFF));
+      decoded++;
+    }
+    if (full) break;
+  }
+  acquisition.join();
+
+  EXPECT_EQ(decoded, capacity);
+  EXPECT_EQ(rec.sampleCount(), capacity);
+  EXPECT_FALSE(rec.active());
+}
+
+// loop() restarts the recorder over and over while the acquisition task
+// records. Each fresh log must hold only samples taken after the restart:
+// a run of consecutive values, counted by sampleCount()
+TEST(FrameRecorder, RestartWhileRecordingStartsAFreshLog) {
+  FrameRecorder rec;
+  ASSERT_TRUE(rec.start());
+  std::atomic<bool> done{false};
+
+  std::thread acquisition([&] {
+    for (uint32_t n = 0; !done.load(std::memory_order_acquire); n++) {
+      rec.sample((int16_t)((n * REC_STEP) & 0x3FFF));
+    }
+  });
+
+  for (int r = 0; r < REC_RESTARTS; r++) {
+    ASSERT_TRUE(rec.start());
+    while (rec.sampleCount() < REC_RESTART_SAMPLES && !rec.overflowed()) {
+    }
+    rec.stop();
+    uint32_t count = rec.sampleCount();
+    RecordReader reader = {rec.bytes, rec.bytes + rec.sampleBytes(), 0};
+    uint32_t decoded = 0;
+    int16_t raw, last = 0;
+    while (reader.next(raw)) {
+      if (decoded > 0) {
+        EXPECT_EQ(raw, (int16_t)((last + REC_STEP) & 0x3FFF)) << "restart " << r;
+      }
+      last = raw;
+      decoded++;
+    }
+    EXPECT_GE(decoded, count) << "restart " << r;
+  }
+  done.store(true, std::memory_order_release);
+  acquisition.join();
+}
+
+// The DSP task's frames (and its trace) against loop() taking results,
+// moving the servo and tracing. Anything the two share outside the mailbox
+// and atomics fails the run under TSan.
+TEST(DspTask, SharesNothingWithLoopButTheMailbox) {
+  std::vector<int16_t> frame(SAMPLES);
+  sampleBuffer = frame.data();
+  sampleRing.reset();
+  lastWindowEnd = 0;
+  useOnsetGate = false;
+  dspExpectedFreq.store(DSP_TONE_HZ);
+  std::atomic<bool> done{false};
+
+  std::thread dsp([&] {
+    uint32_t n = 0;
+    for (uint32_t f = 0; f < DSP_FRAMES; f++) {
+      // Acquisition is folded in here; the ring's own handoff isn't under test
+      for (int i = 0; i < FRAME_HOP; i++, n++) {
+        sampleRing.push((int16_t)(2048 + 600 * sinf(2.0f * (float)M_PI * DSP_TONE_HZ * n / SAMPLING_FREQ)));
+      }
+      if (dspFrame()) {
+        // The subharmonic trace in detectPitchLogged(), which a pure tone doesn't trigger
+        TRACE_AT(TRACE_SUBHARMONIC, 0.0f, 0, signalLevel);
+      }
+    }
+    done.store(true, std::memory_order_release);
+  });
+
+  uint32_t taken = 0, onPitch = 0, silent = 0;
+  bool finished = false;
+  while (!finished) {
+    finished = done.load(std::memory_order_acquire);
+    float freq;
+    int32_t lagQ15;
+    if (!fetchPitch(DSP_TONE_HZ, freq, lagQ15, pitchLevel)) continue;
+    if (fabsf(freq - DSP_TONE_HZ) < 1.0f) onPitch++;
+    if (pitchLevel <= 0.0f) silent++;
+    servoPos = SERVO_CENTER + (int)(taken % 20);
+    TRACE(TRACE_SERVO_MOVE, 1.0f, 0);
+    taken++;
+  }
+  dsp.join();
+
+  EXPECT_GT(taken, 0u);
+  EXPECT_GT(onPitch, 0u);  // The rest are gated once the noise floor catches up with the tone
+  EXPECT_EQ(silent, 0u);
+  TraceRecord r;
+  while (traceRing.pop(r)) {}
+  stopPitchTask();
+  servoPos = SERVO_CENTER;
+  sampleBuffer = nullptr;
+}
+
+}  // namespace
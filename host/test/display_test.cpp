@@ -0,0 +1,206 @@
+// Display updates against the host ST7789: the pixel count the sketch
+// reports (CountingST7789, behind uiPixelsPushed) must match what the
+// panel fake received on its bus, through canvas flushes and direct
+// drawing alike; and the screens must match the golden images in
+// host/test/golden, composed off-screen or not. Run with UPDATE_GOLDEN=1
+// to rewrite the goldens after an intended change; a mismatch leaves the
+// screen it got as <name>.actual.ppm in the working directory.
+#include "code.cpp"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+// The panel as a binary PPM (P6), converted as dumpCanvasPPM() does
+std::vector<uint8_t> panelPPM() {
+  char header[32];
+  int n = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", tft.width(), tft.height());
+  std::vector<uint8_t> ppm(header, header + n);
+  for (int y = 0; y < tft.height(); y++) {
+    for (int x = 0; x < tft.width(); x++) {
+      uint16_t v = tft.hostPixel(x, y);
+      ppm.push_back(((v >> 11) & 0x1F) * 255 / 31);
+      ppm.push_back(((v >> 5) & 0x3F) * 255 / 63);
+      ppm.push_back((v & 0x1F) * 255 / 31);
+    }
+  }
+  return ppm;
+}
+
+void writeFile(const std::string &path, const std::vector<uint8_t> &bytes) {
+  std::ofstream(path, std::ios::binary).write((const char*)bytes.data(), bytes.size());
+}
+
+void expectGolden(const char* name) {
+  std::vector<uint8_t> got = panelPPM();
+  std::string path = std::string(GOLDEN_DIR) + "/" + name + ".ppm";
+  if (getenv("UPDATE_GOLDEN")) {
+    writeFile(path, got);
+    return;
+  }
+  std::ifstream in(path, std::ios::binary);
+  ASSERT_TRUE(in) << "no golden " << path << "; run with UPDATE_GOLDEN=1";
+  std::vector<uint8_t> want((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  if (got == want) return;
+
+  size_t differ = 0;
+  for (size_t i = 0; i < std::min(got.size(), want.size()); i++) differ += got[i] != want[i];
+  writeFile(std::string(name) + ".actual.ppm", got);
+  ADD_FAILURE() << name << ": " << differ << " bytes differ from " << path;
+}
+
+class Display : public ::testing::Test {
+protected:
+  static void SetUpTestSuite() {
+    hostSerialOutput(nullptr);
+    setup();
+    traceOutput = TRACE_OUT_OFF;
+  }
+
+  void SetUp() override {
+    servoLimitReached = servoReturningToCenter = waitingForConfirm = false;
+    counted = tft.pixelCount();
+    sent = tft.hostPixelsSent();
+  }
+
+  // Checks the counter against the bus since the last call; returns the count
+  uint32_t pixelsSinceLast() {
+    uint32_t c = tft.pixelCount() - counted;
+    uint64_t b = tft.hostPixelsSent() - sent;
+    EXPECT_EQ((uint64_t)c, b);
+    counted = tft.pixelCount();
+    sent = tft.hostPixelsSent();
+    return c;
+  }
+
+  // Runs the tuning screen through a note, a needle move, the limit overlay
+  // and back
+  void tuningSequence() {
+    currentState = STATE_TUNING;
+    drawTuningScreen();
+    EXPECT_GT(pixelsSinceLast(), 0u);
+
+    updateTuningDisplay(110.0f, "A2", -20, 1);
+    EXPECT_GT(pixelsSinceLast(), 0u);
+    updateTuningDisplay(110.0f, "A2", -20, 1);
+    EXPECT_EQ(pixelsSinceLast(), 0u) << "nothing changed";
+    updateTuningDisplay(111.0f, "A2", 5, 1);
+    EXPECT_GT(pixelsSinceLast(), 0u);
+
+    servoLimitReached = waitingForConfirm = needsTightenRoom = true;
+    updateTuningDisplay(111.0f, "A2", 5, 1);
+    EXPECT_GT(pixelsSinceLast(), 0u);
+    servoLimitReached = waitingForConfirm = false;
+    updateTuningDisplay(0.0f, "--", 0, -1);
+    EXPECT_GT(pixelsSinceLast(), 0u);
+  }
+
+  void autoTuneSequence() {
+    currentState = STATE_AUTO_TUNE_ALL;
+    autoTuneCurrentString = 2;
+    drawAutoTuneAllScreen();
+    EXPECT_GT(pixelsSinceLast(), 0u);
+
+    updateAutoTuneDisplay(147.0f, 12);
+    EXPECT_GT(pixelsSinceLast(), 0u);
+    updateAutoTuneDisplay(146.8f, -3);
+    EXPECT_GT(pixelsSinceLast(), 0u);
+
+    servoLimitReached = waitingForConfirm = servoReturningToCenter = true;
+    updateAutoTuneDisplay(146.8f, -3);
+    EXPECT_GT(pixelsSinceLast(), 0u);
+    servoLimitReached = waitingForConfirm = servoReturningToCenter = false;
+    updateAutoTuneDisplay(146.8f, -3);
+    EXPECT_GT(pixelsSinceLast(), 0u);
+  }
+
+  uint32_t counted = 0;
+  uint64_t sent = 0;
+};
+
+TEST_F(Display, CountMatchesTheBusWithCanvases) {
+  ASSERT_NE(meterRegion.canvas, nullptr);
+  tuningSequence();
+  autoTuneSequence();
+}
+
+TEST_F(Display, CountMatchesTheBusDrawingDirect) {
+  CanvasRegion saved[3] = {meterRegion, noteRegion, statusRegion};
+  meterRegion.canvas = noteRegion.canvas = statusRegion.canvas = nullptr;
+  tuningSequence();
+  autoTuneSequence();
+  meterRegion = saved[0];
+  noteRegion = saved[1];
+  statusRegion = saved[2];
+}
+
+// A needle move flushes one window spanning the old and new needle
+TEST_F(Display, NeedleMoveSendsOneWindow) {
+  currentState = STATE_AUTO_TUNE_ALL;
+  drawAutoTuneAllScreen();
+  updateAutoTuneDisplay(147.0f, 0);
+  pixelsSinceLast();
+
+  updateCentsMeter(210, 10);
+  int span = meterNeedleX(10) - meterNeedleX(0) + 2 * NEEDLE_RADIUS + 1;
+  EXPECT_EQ(pixelsSinceLast(), (uint32_t)(span * (2 * NEEDLE_RADIUS + 1)));
+}
+
+// Each screen is rendered with the canvases and again drawing direct; both
+// must give the golden image
+struct GoldenScreen {
+  const char* name;
+  void (*render)();
+};
+
+const GoldenScreen GOLDEN_SCREENS[] = {
+  {"tuning_a2_flat", [] {
+     currentState = STATE_TUNING;
+     drawTuningScreen();
+     updateTuningDisplay(108.7f, "A2", -20, 1);
+   }},
+  {"tuning_limit", [] {
+     currentState = STATE_TUNING;
+     drawTuningScreen();
+     updateTuningDisplay(146.0f, "D3", -12, 2);
+     servoLimitReached = waitingForConfirm = needsTightenRoom = true;
+     updateTuningDisplay(146.0f, "D3", -12, 2);
+   }},
+  {"autotune_d3_sharp", [] {
+     currentState = STATE_AUTO_TUNE_ALL;
+     autoTuneCurrentString = 2;
+     drawAutoTuneAllScreen();
+     updateAutoTuneDisplay(147.0f, 30);
+     updateAutoTuneDisplay(147.6f, 7);  // A needle move after the first draw
+   }},
+};
+
+TEST_F(Display, ScreensMatchTheGoldens) {
+  for (const GoldenScreen &g : GOLDEN_SCREENS) {
+    SCOPED_TRACE(g.name);
+    SetUp();
+    g.render();
+    expectGolden(g.name);
+  }
+}
+
+TEST_F(Display, DirectDrawingMatchesTheGoldens) {
+  CanvasRegion saved[3] = {meterRegion, noteRegion, statusRegion};
+  meterRegion.canvas = noteRegion.canvas = statusRegion.canvas = nullptr;
+  for (const GoldenScreen &g : GOLDEN_SCREENS) {
+    SCOPED_TRACE(g.name);
+    SetUp();
+    g.render();
+    if (!getenv("UPDATE_GOLDEN")) expectGolden(g.name);
+  }
+  meterRegion = saved[0];
+  noteRegion = saved[1];
+  statusRegion = saved[2];
+}
+
+}  // namespace
@@ -0,0 +1,194 @@
+// The pitch accuracy suite, headless: every detector on the plucked-string
+// corpus (the device's "selftest all") and on 12-bit WAV recordings read
+// through the sketch's WavReader. The full report is printed so a run can
+// be compared with the device's; the checks are regression bounds a little
+// outside what the detectors score today.
+#include "code.cpp"
+#include "wav_fixture.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+class StdoutPrint : public Print {
+public:
+  size_t write(uint8_t c) override { return fputc(c, stdout) == EOF ? 0 : 1; }
+  size_t write(const uint8_t* buf, size_t n) override { return fwrite(buf, 1, n, stdout); }
+};
+
+StdoutPrint report;
+
+struct Bounds {
+  int detector;
+  bool stringWindow;
+  uint32_t maxMissed;     // Of 120 plucks
+  float maxOctaveRate;
+  float maxMeanCents;
+  float maxFramesToLock;
+};
+
+// AUTOCORR with the AUTO window still jumps octaves on most low strings;
+// the bound is there so it doesn't get worse unnoticed
+const Bounds CORPUS_BOUNDS[] = {
+  {ENGINE_AUTOCORR, false, 75, 0.55f, 4.5f, 1.5f},
+  {ENGINE_AUTOCORR, true, 6, 0.05f, 4.0f, 1.5f},
+  {ENGINE_YIN, false, 10, 0.01f, 4.0f, 1.5f},
+  {ENGINE_YIN, true, 10, 0.01f, 2.5f, 1.5f},
+};
+
+// Largest cents disagreement allowed between the fixed-point and float
+// paths, on the detector output and on the tracked pitch
+const float FIXED_MAX_DEV_CENTS = 0.5f;
+
+void putFile(const char* path, const std::vector<uint8_t> &bytes) {
+  LittleFS.hostFiles()[path] = std::make_shared<std::vector<uint8_t>>(bytes);
+}
+
+// A 'seconds' long pluck at 'hz' after a SAMPLES lead-in, as selftest makes them
+std::vector<int16_t> pluckTake(float hz, float seconds, uint32_t seed) {
+  PluckSynth synth;
+  synth.pluck(hz, seed);
+  std::vector<int16_t> take;
+  for (int i = 0; i < SAMPLES; i++) take.push_back(synth.quiet());
+  for (int i = 0; i < (int)(seconds * SAMPLING_FREQ); i++) take.push_back(synth.next());
+  return take;
+}
+
+class SelfTest : public ::testing::Test {
+protected:
+  static void SetUpTestSuite() {
+    hostSerialOutput(nullptr);
+    setup();
+    traceOutput = TRACE_OUT_OFF;
+    hostSerialOutput(stdout);
+  }
+};
+
+TEST_F(SelfTest, PluckCorpusStaysWithinBounds) {
+  SelfTestStats results[ENGINE_COUNT * 2] = {};
+  runSelfTest(0, NUM_TUNINGS - 1, report, results);
+
+  for (const Bounds &b : CORPUS_BOUNDS) {
+    const SelfTestStats &st = results[b.detector * 2 + b.stringWindow];
+    SCOPED_TRACE(std::string(PITCH_ENGINE_NAMES[b.detector]) + (b.stringWindow ? " string" : " auto"));
+    ASSERT_EQ(st.locked + st.missed, (uint32_t)(NUM_TUNINGS * 6 * 5));
+    EXPECT_LE(st.missed, b.maxMissed);
+    EXPECT_LE((float)st.gross / st.pitched, b.maxOctaveRate);
+    EXPECT_LE(st.sumAbsCents / st.correct, b.maxMeanCents);
+    EXPECT_LE((float)st.sumFramesToLock / st.locked, b.maxFramesToLock);
+    EXPECT_LE(st.maxFixedDev, FIXED_MAX_DEV_CENTS);
+    EXPECT_LE(st.maxTrackedFixedDev, FIXED_MAX_DEV_CENTS);
+  }
+}
+
+// The coarse-to-fine lag search must find what the full scan finds: same
+// notes right, same octave and gross errors, over the whole corpus
+TEST_F(SelfTest, CoarseSearchMatchesTheFullScan) {
+  if (CORR_ENGINE != CORR_ENGINE_DIRECT) GTEST_SKIP() << "coarse search is DIRECT only";
+  class NullPrint : public Print {
+  public:
+    size_t write(uint8_t) override { return 1; }
+  } quiet;
+  SelfTestStats coarse[ENGINE_COUNT * 2] = {}, full[ENGINE_COUNT * 2] = {};
+  useCoarseSearch = true;
+  runSelfTest(0, NUM_TUNINGS - 1, quiet, coarse);
+  useCoarseSearch = false;
+  runSelfTest(0, NUM_TUNINGS - 1, quiet, full);
+  useCoarseSearch = true;
+
+  const SelfTestStats &c = coarse[ENGINE_AUTOCORR * 2], &f = full[ENGINE_AUTOCORR * 2];  // AUTO window
+  EXPECT_EQ(c.correct, f.correct);
+  EXPECT_EQ(c.gross, f.gross);
+  EXPECT_EQ(c.missed, f.missed);
+}
+
+// The fixed-point path picks the string from bounds on the log period;
+// they must split the strings where the Hz bounds do. Pitches within
+// BOUND_SLOP_CENTS of a bound are skipped: Q8 cents and the Q15 period
+// round differently there.
+const float BOUND_SLOP_CENTS = 0.05f;
+
+TEST(StringBounds, LagBoundsMatchHzBounds) {
+  for (int t = 0; t < NUM_TUNINGS; t++) {
+    for (float f = F_MIN; f <= F_MAX; f *= 1.0005f) {
+      int byHz = 0;
+      while (byHz < 5 && f >= tuningModes[t].upperBounds[byHz]) byHz++;
+      bool nearBound = false;
+      for (int s = 0; s < 5; s++) {
+        nearBound |= fabsf(1200.0f * log2f(f / tuningModes[t].upperBounds[s])) < BOUND_SLOP_CENTS;
+      }
+      if (nearBound) continue;
+      int32_t lagQ15 = (int32_t)lround(SAMPLING_FREQ * 32768.0 / f);
+      ASSERT_EQ(stringForLagQ15(lagQ15, t), byHz) << tuningModes[t].name << " at " << f << " Hz";
+    }
+  }
+}
+
+TEST_F(SelfTest, WavReaderReturnsTheAdcCounts) {
+  std::vector<int16_t> take = pluckTake(147.0f, 0.2f, 7);
+  for (bool extensible : {false, true}) {
+    for (uint16_t channels : {1, 2}) {
+      putFile("/t.wav", makeWav(take, (uint32_t)SAMPLING_FREQ, channels, extensible));
+      File f = LittleFS.open("/t.wav", "r");
+      WavReader wav;
+      ASSERT_TRUE(wav.begin(f)) << wav.error;
+      EXPECT_EQ(wav.validBits, extensible ? 12 : 16);
+      ASSERT_EQ(wav.frames, take.size());
+      int16_t raw;
+      for (size_t i = 0; i < take.size(); i++) {
+        ASSERT_TRUE(wav.next(raw));
+        ASSERT_EQ(raw, take[i]) << "sample " << i;
+      }
+      EXPECT_FALSE(wav.next(raw));
+    }
+  }
+}
+
+TEST_F(SelfTest, WavReaderRejectsWhatItCantUse) {
+  std::vector<int16_t> take(100, 2048);
+  std::vector<uint8_t> wrongRate = makeWav(take, 44100, 1, false);
+  std::vector<uint8_t> eightBit = makeWav(take, (uint32_t)SAMPLING_FREQ, 1, false);
+  eightBit[12 + 12 + 8 + 14] = 8;  // bitsPerSample: RIFF header, LIST chunk, fmt header
+  std::vector<uint8_t> notWav = {'R', 'I', 'F', 'X', 0, 0, 0, 0, 'W', 'A', 'V', 'E'};
+  std::vector<uint8_t> noData = makeWav(take, (uint32_t)SAMPLING_FREQ, 1, false);
+  noData.resize(12 + 12 + 24);
+
+  struct Case {
+    const std::vector<uint8_t>* bytes;
+    const char* error;
+  } cases[] = {
+    {&wrongRate, "sample rate is not SAMPLING_FREQ"},
+    {&eightBit, "not 16-bit PCM"},
+    {&notWav, "not a RIFF/WAVE file"},
+    {&noData, "no data chunk"},
+  };
+  for (const Case &c : cases) {
+    putFile("/bad.wav", *c.bytes);
+    File f = LittleFS.open("/bad.wav", "r");
+    WavReader wav;
+    EXPECT_FALSE(wav.begin(f));
+    EXPECT_STREQ(wav.error, c.error);
+  }
+}
+
+TEST_F(SelfTest, WavRecordingRunsThroughEveryDetector) {
+  const float hz = 110.0f * powf(2.0f, 20.0f / 1200.0f);  // A string, 20 cents sharp
+  putFile("/a2.wav", makeWav(pluckTake(hz, 2.0f, 99), (uint32_t)SAMPLING_FREQ, 1, true));
+
+  SelfTestStats results[ENGINE_COUNT * 2] = {};
+  runWavSelfTest("/a2.wav", hz, report, results);
+
+  for (int e = 0; e < ENGINE_COUNT; e++) {
+    const SelfTestStats &st = results[e * 2 + 1];  // String window
+    SCOPED_TRACE(PITCH_ENGINE_NAMES[e]);
+    EXPECT_EQ(st.frames, (uint32_t)(2 * SAMPLING_FREQ / FRAME_HOP));
+    EXPECT_EQ(st.missed, 0u);
+    EXPECT_EQ(st.gross, 0u);
+    EXPECT_LE(st.sumAbsCents / st.correct, 5.0f);
+  }
+}
+
+}  // namespace
@@ -0,0 +1,161 @@
+// The sample sources behind the ring: the ADC through the continuous (DMA)
+// driver, which must hand over every conversion of the piezo's channel in
+// order, a frame at a time; the WAV source, which plays a recording in
+// place of the ADC and starts over at its end; and the "source" command
+// that switches between them. What a source delivered is read back through the frame recorder,
+// which logs the raw samples before the ring's DC blocker.
+#include "code.cpp"
+#include "wav_fixture.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+uint32_t rampNext = 0;
+
+// Counts up through the 12-bit range, one step per conversion
+uint16_t ramp(uint8_t pin) {
+  return pin == PIEZO_PIN ? (uint16_t)(rampNext++ & 0xFFF) : 2048;
+}
+
+// Everything the recorder logged, decoded
+std::vector<int16_t> recorded() {
+  std::vector<int16_t> out;
+  RecordReader reader = {frameRecorder.bytes, frameRecorder.bytes + frameRecorder.sampleBytes(), 0};
+  int16_t raw;
+  while (reader.next(raw)) out.push_back(raw);
+  return out;
+}
+
+class Sources : public ::testing::Test {
+protected:
+  static void SetUpTestSuite() {
+    hostSerialOutput(nullptr);
+    setup();
+    traceOutput = TRACE_OUT_OFF;
+  }
+
+  // Nothing feeds the ring and the DSP task is parked
+  void SetUp() override { beginOfflineRun(); }
+
+  void TearDown() override {
+    frameRecorder.stop();
+    hostSetAnalogSource(nullptr);
+    hostSetAdcStrays(0);
+    sampleSource = &adcSource;
+    endOfflineRun(Serial);
+  }
+};
+
+TEST_F(Sources, AdcHandsOverEveryConversionAFrameAtATime) {
+  rampNext = 0;
+  hostSetAnalogSource(ramp);
+  ASSERT_TRUE(frameRecorder.start());
+  uint32_t before = sampleRing.count();
+  ASSERT_TRUE(adcSource.begin(&sampleRing));
+
+  for (int i = 0; i < 20; i++) {
+    delay(37);  // Out of step with the frames
+    EXPECT_EQ((sampleRing.count() - before) % ADC_FRAME_SAMPLES, 0u);
+  }
+  delay(1000 - 20 * 37);
+
+  // end() returns once the task has stopped; nothing arrives after it
+  adcSource.end();
+  frameRecorder.stop();
+  uint32_t stopped = sampleRing.count();
+  delay(100);
+  EXPECT_EQ(sampleRing.count(), stopped);
+
+  uint32_t got = stopped - before;
+  EXPECT_EQ(got % ADC_FRAME_SAMPLES, 0u);
+  EXPECT_GE(got, (uint32_t)SAMPLING_FREQ - ADC_FRAME_SAMPLES);
+  EXPECT_LE(got, (uint32_t)SAMPLING_FREQ + ADC_FRAME_SAMPLES);
+
+  std::vector<int16_t> samples = recorded();
+  ASSERT_EQ(samples.size(), got);
+  for (uint32_t i = 0; i < got; i++) ASSERT_EQ(samples[i], (int16_t)(i & 0xFFF)) << "sample " << i;
+
+  // And it starts again
+  ASSERT_TRUE(adcSource.begin(&sampleRing));
+  delay(100);
+  EXPECT_GT(sampleRing.count(), stopped);
+  adcSource.end();
+}
+
+// Results from another channel are counted and kept out of the ring
+TEST_F(Sources, AdcSkipsConversionsFromOtherChannels) {
+  rampNext = 0;
+  hostSetAnalogSource(ramp);
+  hostSetAdcStrays(10);
+  ASSERT_TRUE(frameRecorder.start());
+  uint32_t strays = adcSource.strayCount();
+  ASSERT_TRUE(adcSource.begin(&sampleRing));
+  delay(500);
+  adcSource.end();
+  frameRecorder.stop();
+  strays = adcSource.strayCount() - strays;
+
+  std::vector<int16_t> samples = recorded();
+  ASSERT_GT(samples.size(), 0u);
+  for (uint32_t i = 0; i < samples.size(); i++) ASSERT_EQ(samples[i], (int16_t)(i & 0xFFF)) << "sample " << i;
+  EXPECT_EQ(strays, (uint32_t)(samples.size() + strays) / 10);
+}
+
+TEST_F(Sources, WavPlaysTheRecordingAndStartsOver) {
+  std::vector<int16_t> take;
+  for (int i = 0; i < 3000; i++) take.push_back((int16_t)(2048 + (i * 7) % 1500 - 750));
+  LittleFS.hostFiles()["/loop.wav"] = std::make_shared<std::vector<uint8_t>>(makeWav(take));
+
+  ASSERT_TRUE(wavSource.open("/loop.wav")) << wavSource.error;
+  ASSERT_TRUE(frameRecorder.start());
+  uint32_t before = sampleRing.count();
+  ASSERT_TRUE(wavSource.begin(&sampleRing));
+  delay(1000);
+  wavSource.end();
+  frameRecorder.stop();
+
+  uint32_t got = sampleRing.count() - before;
+  EXPECT_GE(got, (uint32_t)SAMPLING_FREQ - 16);
+  EXPECT_LE(got, (uint32_t)SAMPLING_FREQ + 16);
+  std::vector<int16_t> samples = recorded();
+  ASSERT_EQ(samples.size(), got);
+  for (uint32_t i = 0; i < got; i++) ASSERT_EQ(samples[i], take[i % take.size()]) << "sample " << i;
+}
+
+TEST_F(Sources, SourceCommandSwitchesAndRejectsBadFiles) {
+  endOfflineRun(Serial);  // The command stops and starts sources itself
+  std::string out;
+  hostSerialOutput(nullptr, &out);
+
+  std::vector<int16_t> take(2 * SAMPLES, 2048);
+  LittleFS.hostFiles()["/quiet.wav"] = std::make_shared<std::vector<uint8_t>>(makeWav(take));
+  LittleFS.hostFiles()["/junk.wav"] = std::make_shared<std::vector<uint8_t>>(12, 'x');
+
+  handleSourceCommand("wav /missing.wav", Serial);
+  handleSourceCommand("wav /junk.wav", Serial);
+  EXPECT_EQ(sampleSource, &adcSource);
+  handleSourceCommand("wav /quiet.wav", Serial);
+  EXPECT_EQ(sampleSource, &wavSource);
+  uint32_t before = sampleRing.count();
+  delay(100);
+  EXPECT_GT(sampleRing.count(), before);
+  handleSourceCommand("synth 110", Serial);
+  EXPECT_EQ(sampleSource, &syntheticSource);
+  handleSourceCommand("adc", Serial);
+  EXPECT_EQ(sampleSource, &adcSource);
+
+  hostSerialOutput(nullptr);
+  EXPECT_EQ(out,
+            "source: /missing.wav: can't open\n"
+            "source: /junk.wav: not a RIFF/WAVE file\n"
+            "source: wav /quiet.wav\n"
+            "source: synth 110\n"
+            "source: adc\n");
+  beginOfflineRun();
+}
+
+}  // namespace
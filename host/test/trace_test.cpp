@@ -0,0 +1,139 @@
+// The binary trace output ("trace bin"): records go through the ring and the
+// trace task onto Serial as frames, with text printed in between, and
+// tools/trace_decode.py turns the capture into the CSV "trace csv" prints.
+// The frame layout is in tools/trace_format.md.
+#include "code.cpp"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const float MARK = 12345.0f;  // In 'level', tells the test's records from any others
+const int LOGGED = 300;       // More than the ring holds before the task drains it
+
+struct Frame {
+  char type;
+  std::vector<uint8_t> payload;
+};
+
+// Frames in the capture, and the bytes between them
+std::vector<Frame> parseFrames(const std::string &s, std::string &between) {
+  std::vector<Frame> frames;
+  size_t pos = 0;
+  while (pos < s.size()) {
+    if (pos + 4 < s.size() && (uint8_t)s[pos] == TRACE_BIN_SYNC[0] &&
+        (uint8_t)s[pos + 1] == TRACE_BIN_SYNC[1]) {
+      uint8_t type = s[pos + 2], len = s[pos + 3];
+      size_t end = pos + 4 + len;
+      if (end < s.size()) {
+        uint8_t sum = type + len;
+        for (size_t i = pos + 4; i < end; i++) sum += (uint8_t)s[i];
+        if (sum == (uint8_t)s[end]) {
+          frames.push_back({(char)type, std::vector<uint8_t>(s.begin() + pos + 4, s.begin() + end)});
+          pos = end + 1;
+          continue;
+        }
+      }
+    }
+    between += s[pos++];
+  }
+  return frames;
+}
+
+class Trace : public ::testing::Test {
+protected:
+  static void SetUpTestSuite() {
+    hostSerialOutput(nullptr);
+    setup();
+    traceOutput = TRACE_OUT_OFF;
+    delay(50);  // Let the trace task drain whatever setup() logged
+  }
+};
+
+TEST_F(Trace, BinaryStreamCarriesEveryRecord) {
+  std::string capture;
+  hostSerialOutput(nullptr, &capture);
+  traceOutput = TRACE_OUT_BIN;
+  for (int i = 0; i < LOGGED; i++) {
+    traceRing.log(i % TRACE_EVENT_COUNT, 0.25f * i, i - 150, i & 0xFF, MARK);
+  }
+  delay(50);
+  Serial.print("text between frames\n");
+  for (int i = LOGGED; i < LOGGED + 3; i++) {
+    traceRing.log(i % TRACE_EVENT_COUNT, 0.25f * i, i - 150, i & 0xFF, MARK);
+  }
+  delay(50);
+  traceOutput = TRACE_OUT_OFF;
+  hostSerialOutput(nullptr);
+
+  std::string between;
+  std::vector<Frame> frames = parseFrames(capture, between);
+  EXPECT_EQ(between, "text between frames\n");
+  ASSERT_FALSE(frames.empty());
+
+  // Header first
+  const Frame &h = frames[0];
+  ASSERT_EQ(h.type, TRACE_BIN_HEADER);
+  ASSERT_GE(h.payload.size(), 3u);
+  EXPECT_EQ(h.payload[0], TRACE_BIN_VERSION);
+  EXPECT_EQ(h.payload[1], sizeof(TraceRecord));
+  EXPECT_EQ(h.payload[2], TRACE_EVENT_COUNT);
+  const char* name = (const char*)&h.payload[3];
+  for (int e = 0; e < TRACE_EVENT_COUNT; e++) {
+    EXPECT_STREQ(name, TRACE_EVENT_NAMES[e]);
+    name += strlen(name) + 1;
+  }
+
+  // The ring keeps the first TRACE_RING_SIZE and counts the rest as dropped
+  std::vector<int> seen;
+  uint32_t dropped = 0;
+  std::string csv = "us,event,servo,cents,value,level\n";
+  char line[TRACE_LINE_MAX];
+  for (size_t f = 1; f < frames.size(); f++) {
+    if (frames[f].type == TRACE_BIN_DROPS) {
+      ASSERT_EQ(frames[f].payload.size(), 4u);
+      uint32_t n;
+      memcpy(&n, frames[f].payload.data(), 4);
+      dropped += n;
+      csv += "# trace: " + std::to_string(n) + " records dropped\n";
+      continue;
+    }
+    ASSERT_EQ(frames[f].type, TRACE_BIN_RECORD);
+    ASSERT_EQ(frames[f].payload.size(), sizeof(TraceRecord));
+    TraceRecord r;
+    memcpy(&r, frames[f].payload.data(), sizeof(r));
+    csv.append(line, formatTraceCsv(r, line));
+    if (r.level != MARK) continue;
+    int i = (int)(r.value * 4.0f);
+    EXPECT_EQ(r.event, i % TRACE_EVENT_COUNT);
+    EXPECT_EQ(r.cents, i - 150);
+    EXPECT_EQ(r.servoPos, i & 0xFF);
+    seen.push_back(i);
+  }
+  std::vector<int> want;
+  for (int i = 0; i < (int)TRACE_RING_SIZE; i++) want.push_back(i);
+  for (int i = LOGGED; i < LOGGED + 3; i++) want.push_back(i);
+  EXPECT_EQ(seen, want);
+  EXPECT_EQ(dropped, (uint32_t)(LOGGED - TRACE_RING_SIZE));
+
+#ifdef TRACE_DECODER
+  // The decoder must print what "trace csv" would have
+  std::ofstream("trace_capture.bin", std::ios::binary) << capture;
+  FILE* p = popen(TRACE_DECODER " trace_capture.bin", "r");
+  ASSERT_NE(p, nullptr);
+  std::string decoded;
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), p)) > 0) decoded.append(buf, n);
+  EXPECT_EQ(pclose(p), 0);
+  EXPECT_EQ(decoded, csv);
+#else
+  GTEST_SKIP() << "no Python 3; trace_decode.py not checked";
+#endif
+}
+
+}  // namespace
@@ -0,0 +1,58 @@
+// WAV files for the host tests, built in memory from 12-bit ADC counts to
+// be read back through the sketch's WavReader. Include after code.cpp.
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+// 16-bit PCM with 12 significant bits: ADC count c is stored as (c - 2048) << 4
+inline std::vector<uint8_t> makeWav(const std::vector<int16_t> &adc,
+                                    uint32_t rate = (uint32_t)SAMPLING_FREQ,
+                                    uint16_t channels = 1, bool extensible = false) {
+  std::vector<uint8_t> w;
+  auto put16 = [&](uint32_t v) {
+    w.push_back(v & 0xFF);
+    w.push_back((v >> 8) & 0xFF);
+  };
+  auto put32 = [&](uint32_t v) {
+    put16(v & 0xFFFF);
+    put16(v >> 16);
+  };
+  auto tag = [&](const char* t) { w.insert(w.end(), t, t + 4); };
+  uint32_t dataBytes = adc.size() * 2 * channels;
+
+  tag("RIFF");
+  put32(0);  // Filled in below
+  tag("WAVE");
+  tag("LIST");  // A chunk the reader has to skip
+  put32(3);
+  w.insert(w.end(), {'a', 'b', 'c', 0});  // Odd size, so a pad byte
+  tag("fmt ");
+  put32(extensible ? 40 : 16);
+  put16(extensible ? WAV_FORMAT_EXTENSIBLE : WAV_FORMAT_PCM);
+  put16(channels);
+  put32(rate);
+  put32(rate * 2 * channels);
+  put16(2 * channels);
+  put16(16);
+  if (extensible) {
+    put16(22);
+    put16(12);  // Valid bits
+    put32(0);
+    put16(WAV_FORMAT_PCM);
+    const uint8_t guidTail[14] = {0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80,
+                                  0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+    w.insert(w.end(), guidTail, guidTail + 14);
+  }
+  tag("data");
+  put32(dataBytes);
+  for (int16_t c : adc) {
+    put16((uint16_t)((c - 2048) * 16));
+    for (uint16_t ch = 1; ch < channels; ch++) put16(0x7FF0);  // Only the first channel counts
+  }
+  uint32_t riff = w.size() - 8;
+  memcpy(&w[4], &riff, 4);
+  return w;
+}
@@ -0,0 +1,82 @@
+// ST7789 driver that counts the pixels it sends, for the display update
+// stats (uiPixelsPushed). Adafruit_SPITFT's drawing entry points each clip
+// and send their own window without calling one another, and the GFX
+// shapes and text are built from them, so counting at each one sees every
+// pixel on the bus once. writePixels() isn't virtual in the library; the
+// sketch calls it on this class directly.
+#pragma once
+
+#include <Adafruit_ST7789.h>
+
+class CountingST7789 : public Adafruit_ST7789 {
+public:
+  CountingST7789(int8_t cs, int8_t dc, int8_t rst) : Adafruit_ST7789(cs, dc, rst) {}
+
+  // Pixels sent since power-up; wraps
+  uint32_t pixelCount() const { return pixels; }
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override {
+    pixels += clippedArea(x, y, 1, 1);
+    Adafruit_ST7789::drawPixel(x, y, color);
+  }
+
+  void writePixel(int16_t x, int16_t y, uint16_t color) override {
+    pixels += clippedArea(x, y, 1, 1);
+    Adafruit_ST7789::writePixel(x, y, color);
+  }
+
+  void writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override {
+    pixels += clippedArea(x, y, w, h);
+    Adafruit_ST7789::writeFillRect(x, y, w, h, color);
+  }
+
+  void writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override {
+    pixels += clippedArea(x, y, w, 1);
+    Adafruit_ST7789::writeFastHLine(x, y, w, color);
+  }
+
+  void writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override {
+    pixels += clippedArea(x, y, 1, h);
+    Adafruit_ST7789::writeFastVLine(x, y, h, color);
+  }
+
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override {
+    pixels += clippedArea(x, y, w, h);
+    Adafruit_ST7789::fillRect(x, y, w, h, color);
+  }
+
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override {
+    pixels += clippedArea(x, y, w, 1);
+    Adafruit_ST7789::drawFastHLine(x, y, w, color);
+  }
+
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override {
+    pixels += clippedArea(x, y, 1, h);
+    Adafruit_ST7789::drawFastVLine(x, y, h, color);
+  }
+
+  // Pixels into the current address window
+  void writePixels(uint16_t* colors, uint32_t len, bool block = true, bool bigEndian = false) {
+    pixels += len;
+    Adafruit_ST7789::writePixels(colors, len, block, bigEndian);
+  }
+
+private:
+  // Area of the rect left on screen, negative sizes flipped as the library does
+  uint32_t clippedArea(int16_t x, int16_t y, int16_t w, int16_t h) const {
+    if (w < 0) {
+      x += w + 1;
+      w = -w;
+    }
+    if (h < 0) {
+      y += h + 1;
+      h = -h;
+    }
+    int32_t x0 = x > 0 ? x : 0, y0 = y > 0 ? y : 0;
+    int32_t x1 = (int32_t)x + w < width() ? (int32_t)x + w : width();
+    int32_t y1 = (int32_t)y + h < height() ? (int32_t)y + h : height();
+    return (x1 > x0 && y1 > y0) ? (uint32_t)((x1 - x0) * (y1 - y0)) : 0;
+  }
+
+  uint32_t pixels = 0;
+};
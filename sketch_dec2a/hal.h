@@ -0,0 +1,43 @@
+// Hardware shim for the Arduino-free modules (pitch_dsp, profile): the
+// clocks, the cycle counter and the few core macros they use. On the device
+// it forwards to the ESP32 Arduino core; host builds link host/core/hal_host.cpp.
+#pragma once
+
+#include <stdint.h>
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+
+inline uint32_t halMillis() { return millis(); }
+inline uint32_t halMicros() { return micros(); }
+inline uint32_t halWallMicros() { return micros(); }
+inline uint32_t halCycles() { return ESP.getCycleCount(); }
+inline float halCyclesPerUs() { return (float)getCpuFrequencyMhz(); }
+
+#else
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+#ifndef constrain
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#endif
+using std::min;
+using std::max;
+
+// Virtual clock on the host: only delay() and halAdvanceUs() move it, so
+// simulations run faster than real time and repeat exactly
+uint32_t halMillis();
+uint32_t halMicros();
+void halAdvanceUs(uint64_t us);
+// Real time, for measuring how long the code itself took
+uint32_t halWallMicros();
+// Nanoseconds of real time, so profiles still measure something
+uint32_t halCycles();
+float halCyclesPerUs();
+
+#endif
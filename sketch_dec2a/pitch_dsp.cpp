@@ -0,0 +1,807 @@
+#include "pitch_dsp.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+int16_t *sampleBuffer;
+float NOISE_THRESHOLD = 4.0f;
+bool useOnsetGate = true;
+const char* PITCH_ENGINE_NAMES[ENGINE_COUNT] = {"AUTOCORR", "YIN"};
+int pitchEngine = ENGINE_AUTOCORR;
+bool useCoarseSearch = true;
+bool useStringPrefilter = true;
+bool useFixedPointPitch = true;
+int32_t detectedLagQ15 = 0;
+bool detectedSubharmonic = false;
+const char* NOTE_NAMES[12] = {"C","C#","D","D#","E","F","F#","G","G#","A","A#","B"};
+float signalLevel = 0;
+
+// ===== SAMPLE CAPTURE =====
+
+SampleRing sampleRing;
+uint32_t lastWindowEnd = 0;
+float frameLevel = 0.0f;
+bool frameActive = false;
+
+int16_t syntheticSample(float freq, uint32_t n) {
+  float t = (float)(n % (uint32_t)SAMPLING_FREQ) / (float)SAMPLING_FREQ;
+  float phase = 2.0f * (float)M_PI * freq * t;
+  float env = expf(-3.0f * t);
+  float v = sinf(phase) + 0.5f * sinf(2.0f * phase) + 0.25f * sinf(3.0f * phase);
+  return (int16_t)(2048.0f + 400.0f * env * v);
+}
+
+void advanceCorrelation(uint32_t windowEnd);
+
+bool frameGateOpen(uint32_t end) {
+  float floorNow = sampleRing.noiseFloor();
+  float gate = max(NOISE_THRESHOLD, NOISE_FLOOR_RATIO * floorNow);
+  if (frameLevel < gate) return false;
+  if (!useOnsetGate) return true;
+  bool recentOnset = sampleRing.onsetCount() > 0 &&
+                     (int32_t)(end - sampleRing.onsetIndex()) < (int32_t)ONSET_HOLD_SAMPLES;
+  return recentOnset || frameLevel >= SUSTAIN_FLOOR_RATIO * floorNow;
+}
+
+bool captureSamples() {
+  uint32_t end = sampleRing.count();
+  if (end < SAMPLES || end - lastWindowEnd < FRAME_HOP) {
+    return false;
+  }
+  // Gated frames are neither copied nor fed to the correlation engine, so
+  // silence costs one level check per hop; detectPitch() rejects them
+  frameLevel = sampleRing.level();
+  frameActive = frameGateOpen(end);
+  if (frameActive) {
+    PROFILE_SCOPE(PROF_CAPTURE);
+    sampleRing.copyWindow(sampleBuffer, end, SAMPLES);
+    advanceCorrelation(end);
+  }
+  lastWindowEnd = end;
+  return true;
+}
+
+BandPass prefilter = {0.0f, 0, 0, 0};
+
+// Filter for expectedFreq, redesigned only when the target changes.
+// nullptr when prefiltering is off or there is no target.
+const BandPass* prefilterFor(float expectedFreq) {
+  if (!useStringPrefilter || expectedFreq <= 0.0f) return nullptr;
+  if (prefilter.freq != expectedFreq) {
+    float w0 = 2.0f * (float)M_PI * expectedFreq / (float)SAMPLING_FREQ;
+    float alpha = sinf(w0) / (2.0f * PREFILTER_Q);
+    float a0 = 1.0f + alpha;
+    prefilter.freq = expectedFreq;
+    prefilter.b0 = (int32_t)lroundf(16384.0f * alpha / a0);
+    prefilter.a1 = (int32_t)lroundf(16384.0f * -2.0f * cosf(w0) / a0);
+    prefilter.a2 = (int32_t)lroundf(16384.0f * (1.0f - alpha) / a0);
+  }
+  return &prefilter;
+}
+
+// Band-passes sampleBuffer in place. The frame arrives DC-free from the
+// ring, so this is the only pass over it before correlation.
+void prefilterFrame(const BandPass* bp) {
+  PROFILE_SCOPE(PROF_PREFILTER);
+  // Direct form I; outputs kept in Q14 so the feedback path doesn't truncate
+  int32_t x1 = 0, x2 = 0;
+  int64_t y1 = 0, y2 = 0;
+  for (int i = 0; i < SAMPLES; i++) {
+    int32_t x = sampleBuffer[i];
+    int64_t y = (int64_t)bp->b0 * (x - x2) - ((bp->a1 * y1 + bp->a2 * y2) >> 14);
+    x2 = x1;
+    x1 = x;
+    y2 = y1;
+    y1 = y;
+    int32_t out = (int32_t)((y + 8192) >> 14);
+    sampleBuffer[i] = (int16_t)constrain(out, -32768, 32767);
+  }
+}
+
+// ===== CORRELATION KERNEL =====
+
+// sum(a[i] * b[i]) for int16 data, accumulated modulo 2^32 exactly like a
+// scalar int32 accumulator. Every backend only reorders wrapping int32
+// additions, so all of them are bit-exact with the scalar loop.
+// The vector backends are host-only. The ESP32-S3 runs the unrolled scalar
+// loop below; an S3 SIMD backend is out of scope for now and nothing here
+// speeds up the device. The candidate is PIE's EE.VMULAS.S16.ACCX: ACCX is
+// 40 bits and RUR.ACCX_0 reads back its low 32, the sum mod 2^32, so it
+// could stay bit-exact. But EE.VLD.128 wants 16-byte aligned data, and b is
+// the frame shifted by the lag, aligned for one lag in eight. The rest need
+// the EE.LD.128.USAR / EE.SRC.Q funnel loads, and without an S3 toolchain
+// to check that path against this loop it would go in unverified.
+// ESP-DSP's dsps_dotprod_s16 is no shortcut: it returns an int16, so a
+// caller would have to shift every frame down to fit. Emulating its
+// reference code on the host with the best shift per call moved the
+// detected pitch by up to 0.15 cents (0.02 mean) over the bench plucks,
+// from full scale down to the gate. That error is small, but the results
+// would no longer be bit-exact. Host replays would then drift from what
+// the device decided, and the sliding engine's running sums would break,
+// because they need exact wrap-around.
+int32_t dotProduct16(const int16_t* a, const int16_t* b, int n) {
+  uint32_t acc = 0;
+  int i = 0;
+#if defined(__AVX2__)
+  __m256i v = _mm256_setzero_si256();
+  for (; i + 16 <= n; i += 16) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+    __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+    v = _mm256_add_epi32(v, _mm256_madd_epi16(x, y));
+  }
+  __m128i h = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+  h = _mm_add_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(1, 0, 3, 2)));
+  h = _mm_add_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(2, 3, 0, 1)));
+  acc = (uint32_t)_mm_cvtsi128_si32(h);
+#elif defined(__SSE2__)
+  __m128i v = _mm_setzero_si128();
+  for (; i + 8 <= n; i += 8) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+    __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+    v = _mm_add_epi32(v, _mm_madd_epi16(x, y));
+  }
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  acc = (uint32_t)_mm_cvtsi128_si32(v);
+#elif defined(__ARM_NEON)
+  int32x4_t v = vdupq_n_s32(0);
+  for (; i + 4 <= n; i += 4) {
+    v = vmlal_s16(v, vld1_s16(a + i), vld1_s16(b + i));
+  }
+  acc = (uint32_t)vgetq_lane_s32(v, 0) + (uint32_t)vgetq_lane_s32(v, 1) +
+        (uint32_t)vgetq_lane_s32(v, 2) + (uint32_t)vgetq_lane_s32(v, 3);
+#else
+  uint32_t acc1 = 0, acc2 = 0, acc3 = 0;
+  for (; i + 4 <= n; i += 4) {
+    acc += (uint32_t)((int32_t)a[i] * b[i]);
+    acc1 += (uint32_t)((int32_t)a[i + 1] * b[i + 1]);
+    acc2 += (uint32_t)((int32_t)a[i + 2] * b[i + 2]);
+    acc3 += (uint32_t)((int32_t)a[i + 3] * b[i + 3]);
+  }
+  acc += acc1 + acc2 + acc3;
+#endif
+  for (; i < n; i++) {
+    acc += (uint32_t)((int32_t)a[i] * b[i]);
+  }
+  return (int32_t)acc;
+}
+
+// Two dot products against the same 'a' in one sweep (a is loaded once)
+void dotProduct16Pair(const int16_t* a, const int16_t* b0, const int16_t* b1, int n,
+                      int32_t &out0, int32_t &out1) {
+  uint32_t acc0 = 0, acc1 = 0;
+  int i = 0;
+#if defined(__AVX2__)
+  __m256i v0 = _mm256_setzero_si256();
+  __m256i v1 = _mm256_setzero_si256();
+  for (; i + 16 <= n; i += 16) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+    v0 = _mm256_add_epi32(v0, _mm256_madd_epi16(x, _mm256_loadu_si256((const __m256i*)(b0 + i))));
+    v1 = _mm256_add_epi32(v1, _mm256_madd_epi16(x, _mm256_loadu_si256((const __m256i*)(b1 + i))));
+  }
+  // Both reduced together: h holds v0's partial sums in lanes 0-1, v1's in 2-3
+  __m128i h0 = _mm_add_epi32(_mm256_castsi256_si128(v0), _mm256_extracti128_si256(v0, 1));
+  __m128i h1 = _mm_add_epi32(_mm256_castsi256_si128(v1), _mm256_extracti128_si256(v1, 1));
+  __m128i h = _mm_add_epi32(_mm_unpacklo_epi64(h0, h1), _mm_unpackhi_epi64(h0, h1));
+  h = _mm_add_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(2, 3, 0, 1)));
+  acc0 = (uint32_t)_mm_cvtsi128_si32(h);
+  acc1 = (uint32_t)_mm_extract_epi32(h, 2);
+#elif defined(__SSE2__)
+  __m128i v0 = _mm_setzero_si128();
+  __m128i v1 = _mm_setzero_si128();
+  for (; i + 8 <= n; i += 8) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+    v0 = _mm_add_epi32(v0, _mm_madd_epi16(x, _mm_loadu_si128((const __m128i*)(b0 + i))));
+    v1 = _mm_add_epi32(v1, _mm_madd_epi16(x, _mm_loadu_si128((const __m128i*)(b1 + i))));
+  }
+  v0 = _mm_add_epi32(v0, _mm_shuffle_epi32(v0, _MM_SHUFFLE(1, 0, 3, 2)));
+  v0 = _mm_add_epi32(v0, _mm_shuffle_epi32(v0, _MM_SHUFFLE(2, 3, 0, 1)));
+  v1 = _mm_add_epi32(v1, _mm_shuffle_epi32(v1, _MM_SHUFFLE(1, 0, 3, 2)));
+  v1 = _mm_add_epi32(v1, _mm_shuffle_epi32(v1, _MM_SHUFFLE(2, 3, 0, 1)));
+  acc0 = (uint32_t)_mm_cvtsi128_si32(v0);
+  acc1 = (uint32_t)_mm_cvtsi128_si32(v1);
+#elif defined(__ARM_NEON)
+  int32x4_t v0 = vdupq_n_s32(0);
+  int32x4_t v1 = vdupq_n_s32(0);
+  for (; i + 4 <= n; i += 4) {
+    int16x4_t x = vld1_s16(a + i);
+    v0 = vmlal_s16(v0, x, vld1_s16(b0 + i));
+    v1 = vmlal_s16(v1, x, vld1_s16(b1 + i));
+  }
+  acc0 = (uint32_t)vgetq_lane_s32(v0, 0) + (uint32_t)vgetq_lane_s32(v0, 1) +
+         (uint32_t)vgetq_lane_s32(v0, 2) + (uint32_t)vgetq_lane_s32(v0, 3);
+  acc1 = (uint32_t)vgetq_lane_s32(v1, 0) + (uint32_t)vgetq_lane_s32(v1, 1) +
+         (uint32_t)vgetq_lane_s32(v1, 2) + (uint32_t)vgetq_lane_s32(v1, 3);
+#endif
+  for (; i < n; i++) {
+    int32_t x = a[i];
+    acc0 += (uint32_t)(x * b0[i]);
+    acc1 += (uint32_t)(x * b1[i]);
+  }
+  out0 = (int32_t)acc0;
+  out1 = (int32_t)acc1;
+}
+
+// ===== FFT =====
+// Shared by the FFT correlation engine and the polyphonic check. A real
+// sequence of length 2n is packed as re = even samples, im = odd samples;
+// cosTab/sinTab hold cos/sin(2*pi*k / 2n) for k < n.
+
+// In-place radix-2 complex FFT of length n (inverse is unnormalized)
+void fftComplex(float* re, float* im, int n, const float* cosTab, const float* sinTab,
+                bool inverse) {
+  for (int i = 1, j = 0; i < n; i++) {
+    int bit = n >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    if (i < j) {
+      float t = re[i]; re[i] = re[j]; re[j] = t;
+      t = im[i]; im[i] = im[j]; im[j] = t;
+    }
+  }
+
+  for (int len = 2; len <= n; len <<= 1) {
+    int half = len >> 1;
+    int step = 2 * n / len;
+    for (int i = 0; i < n; i += len) {
+      for (int j = 0; j < half; j++) {
+        float wr = cosTab[j * step];
+        float wi = inverse ? sinTab[j * step] : -sinTab[j * step];
+        int a = i + j;
+        int b = a + half;
+        float tr = re[b] * wr - im[b] * wi;
+        float ti = re[b] * wi + im[b] * wr;
+        re[b] = re[a] - tr;
+        im[b] = im[a] - ti;
+        re[a] += tr;
+        im[a] += ti;
+      }
+    }
+  }
+}
+
+// After fftComplex() on a packed real sequence: untangle into the real
+// spectrum X[k] = E[k] + W^k O[k] and write |X[k]|^2 for k = 0..n
+void realFftPower(const float* re, const float* im, int n, const float* cosTab,
+                  const float* sinTab, float* power) {
+  power[0] = (re[0] + im[0]) * (re[0] + im[0]);
+  power[n] = (re[0] - im[0]) * (re[0] - im[0]);
+  for (int k = 1; k < n; k++) {
+    int m = n - k;
+    float er = 0.5f * (re[k] + re[m]);
+    float ei = 0.5f * (im[k] - im[m]);
+    float or_ = 0.5f * (im[k] + im[m]);
+    float oi = -0.5f * (re[k] - re[m]);
+    float wr = cosTab[k];
+    float wi = -sinTab[k];
+    float xr = er + wr * or_ - wi * oi;
+    float xi = ei + wr * oi + wi * or_;
+    power[k] = xr * xr + xi * xi;
+  }
+}
+
+// ===== CORRELATION ENGINES =====
+
+#if CORR_ENGINE == CORR_ENGINE_FFT
+static_assert((SAMPLES & (SAMPLES - 1)) == 0, "FFT engine needs a power-of-two SAMPLES");
+
+const uint16_t FFT_LEN = SAMPLES * 2;    // Zero-padded so circular wrap never reaches a used lag
+const uint16_t FFT_HALF = FFT_LEN / 2;   // Real FFT packed into a complex FFT of this size
+const uint16_t CORR_TABLE_LEN = SAMPLES / 2 + 2;
+
+float *fftRe, *fftIm;     // FFT_HALF each
+float *fftCos, *fftSin;   // FFT_HALF each: cos/sin(2*pi*k / FFT_LEN)
+float *fftPower;          // FFT_HALF + 1 bins of |X[k]|^2
+float *fftCorr;           // Autocorrelation for lags 0..CORR_TABLE_LEN-1
+
+bool initCorrelationEngine() {
+  fftRe = (float*)malloc(FFT_HALF * sizeof(float));
+  fftIm = (float*)malloc(FFT_HALF * sizeof(float));
+  fftCos = (float*)malloc(FFT_HALF * sizeof(float));
+  fftSin = (float*)malloc(FFT_HALF * sizeof(float));
+  fftPower = (float*)malloc((FFT_HALF + 1) * sizeof(float));
+  fftCorr = (float*)malloc(CORR_TABLE_LEN * sizeof(float));
+  if (!fftRe || !fftIm || !fftCos || !fftSin || !fftPower || !fftCorr) return false;
+
+  for (int k = 0; k < FFT_HALF; k++) {
+    double a = 2.0 * M_PI * k / FFT_LEN;
+    fftCos[k] = (float)cos(a);
+    fftSin[k] = (float)sin(a);
+  }
+  return true;
+}
+
+// Fills fftCorr[] with the linear autocorrelation of sampleBuffer for all lags
+void prepareCorrelation() {
+  // Pack even/odd samples into one complex sequence (zero padding past SAMPLES)
+  for (int n = 0; n < FFT_HALF; n++) {
+    fftRe[n] = (2 * n < SAMPLES) ? sampleBuffer[2 * n] : 0.0f;
+    fftIm[n] = (2 * n + 1 < SAMPLES) ? sampleBuffer[2 * n + 1] : 0.0f;
+  }
+  fftComplex(fftRe, fftIm, FFT_HALF, fftCos, fftSin, false);
+  realFftPower(fftRe, fftIm, FFT_HALF, fftCos, fftSin, fftPower);
+
+  // Inverse real FFT of the (real, even) power spectrum, packed the same way
+  for (int k = 0; k < FFT_HALF; k++) {
+    float e = 0.5f * (fftPower[k] + fftPower[FFT_HALF - k]);
+    float a = 0.5f * (fftPower[k] - fftPower[FFT_HALF - k]);
+    fftRe[k] = e - a * fftSin[k];
+    fftIm[k] = a * fftCos[k];
+  }
+  fftComplex(fftRe, fftIm, FFT_HALF, fftCos, fftSin, true);
+
+  const float scale = 1.0f / FFT_HALF;
+  for (int lag = 0; lag < CORR_TABLE_LEN; lag++) {
+    float v = (lag & 1) ? fftIm[lag >> 1] : fftRe[lag >> 1];
+    fftCorr[lag] = v * scale;
+  }
+}
+
+int32_t lagCorrelation(int lag) {
+  float v = fftCorr[lag];
+  v = constrain(v, -2.0e9f, 2.0e9f);
+  return (int32_t)lrintf(v);
+}
+
+void neighbourCorrelations(int lag, int32_t &prev, int32_t &next) {
+  prev = lagCorrelation(lag - 1);
+  next = lagCorrelation(lag + 1);
+}
+
+void advanceCorrelation(uint32_t windowEnd) {
+}
+
+#elif CORR_ENGINE == CORR_ENGINE_SLIDING
+
+const uint16_t CORR_TABLE_LEN = SAMPLES / 2 + 2;
+
+// Highest lag the detector reads (the refinement looks at bestLag + 1)
+const int SLIDE_MAX_LAG = (SAMPLING_FREQ / F_MIN < SAMPLES / 2)
+                          ? (int)(SAMPLING_FREQ / F_MIN) + 1 : SAMPLES / 2 + 1;
+
+// Lag sums of the window as it sits in the ring (already DC-blocked). Kept
+// modulo 2^32 like the DIRECT engine's int32 accumulators, so they match it
+// bit for bit.
+uint32_t slideSums[CORR_TABLE_LEN];
+int16_t *slideHist;                    // Previous window start .. current window end
+uint32_t slideEnd = 0;
+bool slideValid = false;
+
+bool initCorrelationEngine() {
+  slideHist = (int16_t*)malloc(2 * SAMPLES * sizeof(int16_t));
+  return slideHist != nullptr;
+}
+
+// Moves the running sums to the window ending at windowEnd. Each hop of d
+// samples drops the pairs that start in the old head and adds the pairs that
+// end in the new tail: O(d * lags) instead of O(SAMPLES * lags).
+void advanceCorrelation(uint32_t windowEnd) {
+  uint32_t d = windowEnd - slideEnd;
+
+  if (!slideValid || d > (uint32_t)(SAMPLES - SLIDE_MAX_LAG)) {
+    // Too far from the last window to update incrementally - rebuild
+    sampleRing.copyWindow(slideHist, windowEnd, SAMPLES);
+    for (int lag = 0; lag <= SLIDE_MAX_LAG; lag++) {
+      slideSums[lag] = (uint32_t)dotProduct16(slideHist, slideHist + lag, SAMPLES - lag);
+    }
+  } else {
+    // slideHist[0] is the old window start; the new window starts at slideHist[d]
+    sampleRing.copyWindow(slideHist, windowEnd, SAMPLES + d);
+    const int16_t* x = slideHist;
+    for (int lag = 0; lag <= SLIDE_MAX_LAG; lag++) {
+      uint32_t out = (uint32_t)dotProduct16(x, x + lag, d);
+      uint32_t in = (uint32_t)dotProduct16(x + SAMPLES - lag, x + SAMPLES, d);
+      slideSums[lag] += in - out;
+    }
+  }
+
+  slideEnd = windowEnd;
+  slideValid = true;
+}
+
+void prepareCorrelation() {
+}
+
+int32_t lagCorrelation(int lag) {
+  return (int32_t)slideSums[lag];
+}
+
+void neighbourCorrelations(int lag, int32_t &prev, int32_t &next) {
+  prev = (int32_t)slideSums[lag - 1];
+  next = (int32_t)slideSums[lag + 1];
+}
+
+#else
+
+bool initCorrelationEngine() {
+  return true;
+}
+
+void advanceCorrelation(uint32_t windowEnd) {
+}
+
+void prepareCorrelation() {
+}
+
+int32_t lagCorrelation(int lag) {
+  return dotProduct16(sampleBuffer, sampleBuffer + lag, SAMPLES - lag);
+}
+
+// lag+1 covers SAMPLES-lag-1 products; lag-1 shares those and has two more
+void neighbourCorrelations(int lag, int32_t &prev, int32_t &next) {
+  const int n = SAMPLES - lag - 1;
+  dotProduct16Pair(sampleBuffer, sampleBuffer + lag - 1, sampleBuffer + lag + 1, n, prev, next);
+  uint32_t tail = (uint32_t)((int32_t)sampleBuffer[n] * sampleBuffer[n + lag - 1]) +
+                  (uint32_t)((int32_t)sampleBuffer[n + 1] * sampleBuffer[n + lag]);
+  prev = (int32_t)((uint32_t)prev + tail);
+}
+
+#endif
+
+// ===== COARSE-TO-FINE LAG SEARCH =====
+
+int16_t coarseBuffer[SAMPLES / COARSE_DECIMATION];
+
+// Anti-aliased decimation: 7-tap triangular FIR (two cascaded 4-sample
+// boxcars, nulls at multiples of fs/4) evaluated only at the kept samples
+void decimateForCoarseSearch() {
+  const int n = SAMPLES / COARSE_DECIMATION;
+  for (int k = 0; k < n; k++) {
+    int center = k * COARSE_DECIMATION;
+    int32_t acc = 0;
+    for (int t = -3; t <= 3; t++) {
+      int i = center + t;
+      if (i < 0 || i >= SAMPLES) continue;
+      acc += (int32_t)(4 - abs(t)) * sampleBuffer[i];
+    }
+    coarseBuffer[k] = acc / 16;
+  }
+}
+
+// Returns the best full-rate lag in [minLag, maxLag] (0 if none is positive).
+// Cost is ~1/16 of a full scan for the coarse pass plus
+// COARSE_CANDIDATES * (2 * COARSE_REFINE_SPAN + 1) full-rate lags.
+// pitch_bench (autocorr, auto vs auto_full_scan, STANDARD strings) measures
+// it 1.4-2.5x faster than the full scan with AVX2 and 1.7-4.1x on plain
+// x86-64; the saving on the S3 is not measured. A refine span of 4 is the
+// narrowest that finds what the full scan does on the selftest corpus
+// (selftest_test checks it); 2 and 3 lost notes, more candidates didn't help.
+int coarseToFineLagSearch(int minLag, int maxLag, int32_t &maxCorr) {
+  const int n = SAMPLES / COARSE_DECIMATION;
+  decimateForCoarseSearch();
+
+  int coarseMin = minLag / COARSE_DECIMATION;
+  int coarseMax = (maxLag + COARSE_DECIMATION - 1) / COARSE_DECIMATION;
+  if (coarseMin < 1) coarseMin = 1;
+
+  int candCenter[COARSE_CANDIDATES] = {0};
+  float candCorr[COARSE_CANDIDATES] = {0};
+  int32_t prev = 0, curr = 0;
+
+  // Keep the strongest local maxima of the coarse correlation. Peaks are
+  // ranked by their parabolic vertex, not the sampled value: a short period
+  // that falls between two coarse lags would otherwise lose to its multiples.
+  for (int lag = coarseMin - 1; lag <= coarseMax + 1; lag++) {
+    int32_t next = dotProduct16(coarseBuffer, coarseBuffer + lag, n - lag);
+    int peak = lag - 1;
+    if (peak >= coarseMin && peak <= coarseMax && curr > 0 && curr >= prev && curr > next) {
+      float denom = (float)prev - 2.0f * curr + (float)next;
+      float delta = 0.0f;
+      float height = curr;
+      if (denom < 0.0f) {
+        delta = 0.5f * ((float)prev - (float)next) / denom;
+        height = curr - 0.25f * ((float)prev - (float)next) * delta;
+      }
+      for (int c = 0; c < COARSE_CANDIDATES; c++) {
+        if (height > candCorr[c]) {
+          for (int m = COARSE_CANDIDATES - 1; m > c; m--) {
+            candCenter[m] = candCenter[m - 1];
+            candCorr[m] = candCorr[m - 1];
+          }
+          candCenter[c] = (int)lroundf((peak + delta) * COARSE_DECIMATION);
+          candCorr[c] = height;
+          break;
+        }
+      }
+    }
+    prev = curr;
+    curr = next;
+  }
+
+  maxCorr = 0;
+  int bestLag = 0;
+  for (int c = 0; c < COARSE_CANDIDATES && candCenter[c] > 0; c++) {
+    int center = candCenter[c];
+    int lo = max(center - COARSE_REFINE_SPAN, minLag);
+    int hi = min(center + COARSE_REFINE_SPAN, maxLag);
+    for (int lag = lo; lag <= hi; lag++) {
+      int32_t corr = lagCorrelation(lag);
+      if (corr > maxCorr) {
+        maxCorr = corr;
+        bestLag = lag;
+      }
+    }
+  }
+  return bestLag;
+}
+
+// ===== FIXED-POINT CENTS =====
+
+// Vertex of the parabola through (lag-1, prev), (lag, curr), (lag+1, next) in
+// Q15 samples. Integer version of the float refinement, same +-0.5 clamp.
+int32_t parabolicPeakQ15(int lag, int32_t prev, int32_t curr, int32_t next) {
+  int32_t lagQ15 = lag << 15;
+  int64_t denom = 2 * ((int64_t)prev - 2 * (int64_t)curr + next);
+  if (denom == 0) return lagQ15;
+  int64_t delta = (((int64_t)prev - next) << 15) / denom;
+  return lagQ15 + (int32_t)constrain(delta, (int64_t)-16384, (int64_t)16384);
+}
+
+int32_t periodQ8FromLagQ15(int32_t lagQ15) {
+  int32_t L = lagQ15 >> 15;
+  int64_t v = ((int64_t)(lagQ15 & 0x7FFF) << 16) / L;     // Q31
+  int64_t v2 = (v * v) >> 31;
+  int64_t series = v - (v2 >> 1) + ((v2 * v) >> 31) / 3;
+  return lagCentsQ8[L] + (int32_t)((LOG2_CENTS_Q8 * series) >> 31);
+}
+
+int32_t centsFromLagQ15(int32_t lagQ15, int tuning, int s) {
+  return tuningModes[tuning].centsQ8[s] - periodQ8FromLagQ15(lagQ15);
+}
+
+int stringForPeriodQ8(int32_t periodQ8, int tuning) {
+  const int32_t* bounds = tuningModes[tuning].lowerPeriodsQ8;
+  int s = 0;
+  while (s < 5 && periodQ8 <= bounds[s]) s++;
+  return s;
+}
+
+int stringForLagQ15(int32_t lagQ15, int tuning) {
+  return stringForPeriodQ8(periodQ8FromLagQ15(lagQ15), tuning);
+}
+
+// freqToNote() for a known string, from the detector's Q15 period
+void lagToNote(int32_t lagQ15, int tuning, int stringNum, const char* &name, int &cents) {
+  periodToNote(periodQ8FromLagQ15(lagQ15), tuning, stringNum, name, cents);
+}
+
+void periodToNote(int32_t periodQ8, int tuning, int stringNum, const char* &name, int &cents) {
+  int32_t c = tuningModes[tuning].centsQ8[stringNum] - periodQ8;
+  int32_t noteNum = (tuningModes[tuning].midi[stringNum] * 100 * 256 + c + 50 * 256) / (100 * 256);
+  name = NOTE_NAMES[noteNum % 12];
+  cents = (c + 128) >> 8;
+}
+
+void freqToNote(float f, int tuning, int stringNum, const char* &name, int &cents) {
+  if (f <= 0) { name = "--"; cents = 0; return; }
+
+  float midi = 69.0f + 12.0f * log2f(f / 440.0f);
+  int noteNum = roundf(midi);
+  int idx = noteNum % 12;
+  if (idx < 0) idx += 12;
+  name = NOTE_NAMES[idx];
+
+  if (stringNum >= 0) {
+    float targetFreq = tuningModes[tuning].freqs[stringNum];
+    cents = roundf(1200.0f * log2f(f / targetFreq));
+  } else {
+    float fNote = 440.0f * powf(2.0f, (noteNum - 69) / 12.0f);
+    cents = roundf(1200.0f * log2f(f / fNote));
+  }
+}
+
+// ===== AUTOCORRELATION PITCH DETECTION =====
+
+// Targets are tuning strings, so this is normally a precomputed window; any
+// other target gets the same window built here
+LagWindow lagWindowFor(float expectedFreq, bool prefiltered) {
+  for (int t = 0; t < NUM_TUNINGS; t++) {
+    for (int s = 0; s < 6; s++) {
+      if (tuningModes[t].freqs[s] == expectedFreq) {
+        return prefiltered ? tuningModes[t].narrowLagWindows[s] : tuningModes[t].lagWindows[s];
+      }
+    }
+  }
+  return lagWindowAround(expectedFreq, prefiltered);
+}
+
+float detectPitchAutocorrelation(float expectedFreq) {
+  const BandPass* bp = (CORR_ENGINE != CORR_ENGINE_SLIDING) ? prefilterFor(expectedFreq) : nullptr;
+  if (bp) prefilterFrame(bp);
+
+  int minLag = MIN_LAG;
+  int maxLag = MAX_LAG;
+
+  if (expectedFreq > 0.0f) {
+    LagWindow w = lagWindowFor(expectedFreq, bp != nullptr);
+    minLag = w.min;
+    maxLag = w.max;
+  }
+
+  int32_t maxCorr = 0;
+  int bestLag = 0;
+
+  {
+    PROFILE_SCOPE(PROF_LAG_SCAN);
+    prepareCorrelation();
+    if (CORR_ENGINE == CORR_ENGINE_DIRECT && useCoarseSearch && expectedFreq <= 0.0f) {
+      bestLag = coarseToFineLagSearch(minLag, maxLag, maxCorr);
+    } else {
+      for (int lag = minLag; lag <= maxLag; lag++) {
+        int32_t corr = lagCorrelation(lag);
+        if (corr > maxCorr) {
+          maxCorr = corr;
+          bestLag = lag;
+        }
+      }
+    }
+  }
+
+  PROFILE_SCOPE(PROF_REFINE);
+  if (bestLag == 0) return 0.0f;
+
+  float detectedFreq = SAMPLING_FREQ / (float)bestLag;
+  if (detectedFreq < F_MIN || detectedFreq > F_MAX) {
+    return 0.0f;
+  }
+
+  // Always check for subharmonic (octave below) - harmonics are common on guitar
+  // If detected frequency is significantly higher than expected, check for fundamental
+  bool checkSubharmonic = false;
+  if (bp) {
+    // Prefiltered: harmonics are already attenuated
+  } else if (expectedFreq > 0.0f && detectedFreq > expectedFreq * 1.4f) {
+    // Detected freq is way higher than expected - likely a harmonic
+    checkSubharmonic = true;
+  } else if (expectedFreq <= 0.0f && detectedFreq > 150.0f) {
+    // Auto mode - check higher frequencies for possible harmonics
+    checkSubharmonic = true;
+  }
+  
+  if (checkSubharmonic) {
+    int doubleLag = bestLag * 2;
+    if (doubleLag <= MAX_LAG) {
+      int32_t corr2x = lagCorrelation(doubleLag);
+      // If subharmonic correlation is reasonably strong, use it
+      if (corr2x > maxCorr * 0.5f) {
+        bestLag = doubleLag;
+        maxCorr = corr2x;
+        detectedFreq = SAMPLING_FREQ / (float)bestLag;
+        detectedSubharmonic = true;
+      }
+    }
+  }
+
+  // Fixed point: the refined period and its range check stay in Q15
+  // samples; Hz is only worked out for the return value
+  if (useFixedPointPitch) {
+    int32_t lagQ15 = bestLag << 15;
+    if (bestLag > minLag && bestLag < maxLag) {
+      int32_t corrPrev, corrNext;
+      neighbourCorrelations(bestLag, corrPrev, corrNext);
+      lagQ15 = parabolicPeakQ15(bestLag, corrPrev, maxCorr, corrNext);
+    }
+    if (lagQ15 < MIN_PERIOD_Q15 || lagQ15 > MAX_PERIOD_Q15) return 0.0f;
+    detectedLagQ15 = lagQ15;
+    return SAMPLING_FREQ * 32768.0f / lagQ15;
+  }
+
+  if (bestLag > minLag && bestLag < maxLag) {
+    int32_t corrPrev, corrCurr = maxCorr, corrNext;
+    neighbourCorrelations(bestLag, corrPrev, corrNext);
+
+    float denom = 2.0f * (corrPrev - 2.0f * corrCurr + corrNext);
+    if (fabsf(denom) > 0.001f) {
+      float delta = (float)(corrPrev - corrNext) / denom;
+      delta = constrain(delta, -0.5f, 0.5f);
+      float refinedLag = bestLag + delta;
+      if (refinedLag > 0) {
+        detectedFreq = SAMPLING_FREQ / refinedLag;
+      }
+    }
+  }
+
+  if (detectedFreq < F_MIN || detectedFreq > F_MAX) {
+    return 0.0f;
+  }
+
+  return detectedFreq;
+}
+
+// ===== YIN PITCH DETECTION =====
+
+float yinCmndf[SAMPLES / 2 + 2];
+
+// Cumulative-mean-normalized difference (de Cheveigne & Kawahara). The first
+// dip under YIN_THRESHOLD is the period, so octave errors need no separate
+// subharmonic pass, and the scan stops as soon as that dip bottoms out.
+float detectPitchYIN(float expectedFreq) {
+  const BandPass* bp = prefilterFor(expectedFreq);
+  if (bp) prefilterFrame(bp);
+
+  int minLag = (int)(SAMPLING_FREQ / F_MAX);
+  int maxLag = (int)(SAMPLING_FREQ / F_MIN);
+  if (maxLag > SAMPLES / 2) maxLag = SAMPLES / 2;
+  if (minLag < 2) minLag = 2;
+
+  // Same integration window for every lag so the CMNDF values are comparable
+  const int window = SAMPLES - maxLag - 1;
+
+  // With a target we only need to look one octave below it
+  if (expectedFreq > 0.0f) {
+    int localMax = (int)(2.0f * SAMPLING_FREQ / expectedFreq);
+    if (localMax < maxLag) maxLag = localMax;
+  }
+
+  yinCmndf[0] = 1.0f;
+  float runningSum = 0.0f;
+  int bestLag = 0;
+
+  {
+    PROFILE_SCOPE(PROF_LAG_SCAN);
+    for (int lag = 1; lag <= maxLag + 1; lag++) {
+      uint64_t diff = 0;
+      for (int i = 0; i < window; i++) {
+        int32_t d = (int32_t)sampleBuffer[i] - sampleBuffer[i + lag];
+        diff += (uint32_t)(d * d);
+      }
+      runningSum += (float)diff;
+      yinCmndf[lag] = runningSum > 0.0f ? (float)diff * lag / runningSum : 1.0f;
+
+      if (bestLag == 0) {
+        if (lag > minLag && lag <= maxLag && yinCmndf[lag] < YIN_THRESHOLD) {
+          bestLag = lag;
+        }
+      } else if (yinCmndf[lag] < yinCmndf[bestLag]) {
+        bestLag = lag;  // Still descending into the dip
+      } else {
+        break;          // yinCmndf[bestLag + 1] is known - dip found
+      }
+    }
+  }
+
+  PROFILE_SCOPE(PROF_REFINE);
+  if (bestLag == 0 || bestLag > maxLag) return 0.0f;
+
+  float refinedLag = bestLag;
+  float prev = yinCmndf[bestLag - 1];
+  float curr = yinCmndf[bestLag];
+  float next = yinCmndf[bestLag + 1];
+  float denom = 2.0f * (prev - 2.0f * curr + next);
+  if (fabsf(denom) > 1e-6f) {
+    float delta = constrain((prev - next) / denom, -0.5f, 0.5f);
+    refinedLag += delta;
+  }
+
+  float detectedFreq = SAMPLING_FREQ / refinedLag;
+  if (detectedFreq < F_MIN || detectedFreq > F_MAX) {
+    return 0.0f;
+  }
+
+  if (useFixedPointPitch) {
+    detectedLagQ15 = (int32_t)lroundf(refinedLag * 32768.0f);
+  }
+
+  return detectedFreq;
+}
+
+float (*const PITCH_DETECTORS[ENGINE_COUNT])(float expectedFreq) = {
+  detectPitchAutocorrelation,
+  detectPitchYIN
+};
+
+// Noise gate first: captureSamples() already decided from the ring's level
+// and onsets, so a gated frame costs nothing beyond capture
+float detectPitch(float expectedFreq) {
+  detectedLagQ15 = 0;
+  detectedSubharmonic = false;
+  signalLevel = frameLevel;
+  if (!frameActive) {
+    return 0.0f;
+  }
+  PROFILE_SCOPE(PROF_DETECT);
+  return PITCH_DETECTORS[pitchEngine](expectedFreq);
+}
@@ -0,0 +1,518 @@
+// Pitch detection core: the sample ring, correlation engines, the
+// autocorrelation and YIN detectors and the tuning and lag tables. Nothing
+// here touches Arduino APIs (hal.h covers the clock), so the sketch, the
+// host benchmark and the host tests all build the same code.
+//
+// CORR_ENGINE and PROFILE select code in pitch_dsp.cpp as well as in the
+// sketch, so set them as build flags rather than #defines in the sketch.
+#pragma once
+
+#include "hal.h"
+#include "profile.h"
+#include <stdint.h>
+#include <atomic>
+
+
+// ===== AUTOCORRELATION CONFIG =====
+const uint16_t SAMPLES = 1024;
+constexpr double SAMPLING_FREQ = 8192.0;
+const uint32_t SAMPLE_PERIOD_US = 1000000UL / (unsigned long)SAMPLING_FREQ;
+extern int16_t *sampleBuffer;
+
+// Correlation engine (compile-time). DIRECT evaluates each lag as a dot
+// product; FFT computes every lag at once from the zero-padded power spectrum
+// (Wiener-Khinchin), O(N log N) regardless of the lag window.
+// FFT matches DIRECT's bestLag except for near-ties within ~1e-5 of the peak,
+// and the refined frequency to within 0.01 cent across F_MIN..F_MAX.
+// SLIDING keeps running per-lag sums across overlapping frames and only adds
+// and subtracts the products that enter and leave the window each hop; it is
+// bit-exact with DIRECT.
+#define CORR_ENGINE_DIRECT   0
+#define CORR_ENGINE_FFT      1
+#define CORR_ENGINE_SLIDING  2
+#ifndef CORR_ENGINE
+#define CORR_ENGINE CORR_ENGINE_DIRECT
+#endif
+
+// ===== BACKGROUND ACQUISITION =====
+// Samples are produced continuously into a ring buffer; loop() takes the
+// newest SAMPLES-long window whenever FRAME_HOP new samples have arrived.
+const uint32_t RING_SIZE = 4096;  // Must be a power of two, > 2 * SAMPLES + FRAME_HOP
+#if CORR_ENGINE == CORR_ENGINE_SLIDING
+const uint16_t FRAME_HOP = 256;   // Overlapping frames: a pitch update every ~31 ms
+#else
+const uint16_t FRAME_HOP = SAMPLES;
+#endif
+
+// Frequency range for guitar (E2=82Hz to E4=330Hz)
+constexpr float F_MIN = 75.0f;
+constexpr float F_MAX = 450.0f;
+
+// Noise gate. A frame is analysed when its level clears NOISE_THRESHOLD (the
+// ADC's own noise) and NOISE_FLOOR_RATIO x the adaptive ambient floor, and it
+// either follows an onset within ONSET_HOLD_SAMPLES or is far enough above the
+// floor to count as sustained signal on its own.
+extern float NOISE_THRESHOLD;
+extern bool useOnsetGate;
+const float NOISE_FLOOR_RATIO = 2.0f;
+const float SUSTAIN_FLOOR_RATIO = 6.0f;
+const uint32_t ONSET_HOLD_SAMPLES = 3 * (uint32_t)SAMPLING_FREQ;
+
+// Onset detector, run by the acquisition on ONSET_BLOCK-sample sub-blocks
+// (~8 ms): a block louder than ONSET_RISE x both preceding blocks and
+// ONSET_FLOOR_RATIO x the floor starts a new note.
+const int ONSET_BLOCK = 64;
+const float ONSET_RISE = 2.0f;
+const float ONSET_FLOOR_RATIO = 4.0f;
+const uint32_t ONSET_REFRACTORY = (uint32_t)(0.15 * SAMPLING_FREQ);
+const float FLOOR_FALL = 1.0f / 8;     // Per block, towards a quieter block
+const float FLOOR_RISE = 1.0f / 256;   // Per block, ~2 s time constant
+const uint32_t FLOOR_STUCK_BLOCKS = 10 * (uint32_t)SAMPLING_FREQ / ONSET_BLOCK;
+
+// Pitch detector, switchable at runtime (hold SELECT on the mode screen)
+enum PitchEngine {
+  ENGINE_AUTOCORR,
+  ENGINE_YIN,
+  ENGINE_COUNT
+};
+
+extern const char* PITCH_ENGINE_NAMES[ENGINE_COUNT];
+extern int pitchEngine;
+
+// AUTO mode (no expected frequency): find candidate lags on a 4x decimated
+// copy first, then evaluate full-rate lags only around the best candidates.
+// Only used with the DIRECT engine - the table engines have every lag anyway.
+extern bool useCoarseSearch;
+const int COARSE_DECIMATION = 4;
+const int COARSE_CANDIDATES = 5;
+const int COARSE_REFINE_SPAN = 4;  // Full-rate lags checked either side of 4 * candidate
+
+// YIN: first CMNDF dip below this is taken as the period
+const float YIN_THRESHOLD = 0.15f;
+
+// Band-pass the frame around the target string (manual and auto-tune modes)
+// so the correlation peak is the fundamental. Allows a narrower lag window and
+// no subharmonic check. Not with the SLIDING engine, whose sums come from the
+// unfiltered ring.
+extern bool useStringPrefilter;
+const float PREFILTER_Q = 3.0f;
+
+// Fixed-point pitch: the autocorrelation refinement runs in Q15 and cents come
+// from lag tables per tuning string (lagToNote) instead of log2f/powf
+extern bool useFixedPointPitch;
+extern int32_t detectedLagQ15;    // Period of the last detection in Q15 samples, 0 = none
+extern bool detectedSubharmonic;  // The last detection took the octave-below correction
+
+// ===== COMPILE-TIME TABLES =====
+// C++11-compatible constexpr helpers (single-return recursion), so the same
+// tables build on both the 2.x and 3.x ESP32 cores.
+
+template<int... I> struct IndexSeq {};
+
+template<class A, class B> struct ConcatSeq;
+template<int... A, int... B> struct ConcatSeq<IndexSeq<A...>, IndexSeq<B...> > {
+  typedef IndexSeq<A..., (int)sizeof...(A) + B...> type;
+};
+
+// IndexSeq<0, 1, ..., N-1>, built by halving to keep template depth at log2(N)
+template<int N> struct MakeSeq {
+  typedef typename ConcatSeq<typename MakeSeq<N / 2>::type,
+                             typename MakeSeq<N - N / 2>::type>::type type;
+};
+template<> struct MakeSeq<0> { typedef IndexSeq<> type; };
+template<> struct MakeSeq<1> { typedef IndexSeq<0> type; };
+
+// values[i] = F(i), evaluated by the compiler and placed in flash
+template<class T, T (*F)(int), class Seq> struct ConstTable;
+template<class T, T (*F)(int), int... I> struct ConstTable<T, F, IndexSeq<I...> > {
+  static constexpr T values[sizeof...(I)] = {F(I)...};
+};
+template<class T, T (*F)(int), int... I>
+constexpr T ConstTable<T, F, IndexSeq<I...> >::values[sizeof...(I)];
+
+// atanh(y) = sum of y^k / k over odd k; y <= 1/3 below, so 21 terms is plenty
+constexpr double atanhSeries(double y, double yk, int k) {
+  return k > 41 ? 0.0 : yk / k + atanhSeries(y, yk * y * y, k + 2);
+}
+
+// log2(x) for x > 0: scale into [1, 2), then ln(m) = 2 * atanh((m-1)/(m+1))
+constexpr double constLog2(double x) {
+  return x >= 2.0 ? 1.0 + constLog2(x / 2.0)
+       : x < 1.0  ? constLog2(x * 2.0) - 1.0
+       : 2.0 * atanhSeries((x - 1.0) / (x + 1.0), (x - 1.0) / (x + 1.0), 1) / 0.69314718055994530942;
+}
+
+// 2^(n/24) for n >= 0: whole octaves exactly, then quarter tones
+constexpr double quarterToneRatio(int n) {
+  return n >= 24 ? 2.0 * quarterToneRatio(n - 24)
+       : n == 0  ? 1.0
+       : 1.02930223664349206789 * quarterToneRatio(n - 1);
+}
+
+// Frequency of MIDI note midi2 / 2 (A4 = 440 Hz), so half-way points between
+// notes are exact too. Offset by 11 octaves to keep the exponent positive.
+constexpr double halfMidiToFreq(int midi2) {
+  return 440.0 * quarterToneRatio(midi2 - 138 + 264) / 2048.0;
+}
+
+// Cents to Q8 (1/256 cent), rounded half away from zero
+constexpr int32_t centsToQ8(double cents) {
+  return (int32_t)(cents * 256.0 + (cents >= 0.0 ? 0.5 : -0.5));
+}
+
+// Full-range autocorrelation lag bounds
+constexpr int MIN_LAG = (int)(SAMPLING_FREQ / F_MAX) < 2 ? 2 : (int)(SAMPLING_FREQ / F_MAX);
+constexpr int MAX_LAG = (int)(SAMPLING_FREQ / F_MIN) > SAMPLES / 2 ? SAMPLES / 2
+                      : (int)(SAMPLING_FREQ / F_MIN);
+
+// F_MIN..F_MAX as periods in Q15 samples, for the fixed-point range check
+constexpr int32_t MIN_PERIOD_Q15 = (int32_t)(SAMPLING_FREQ / F_MAX * 32768.0);
+constexpr int32_t MAX_PERIOD_Q15 = (int32_t)(SAMPLING_FREQ / F_MIN * 32768.0);
+
+// Autocorrelation lag window aimed at one string
+struct LagWindow {
+  int16_t center, min, max;
+};
+
+constexpr int16_t clampLag(int lag) {
+  return lag < MIN_LAG ? MIN_LAG : lag > MAX_LAG ? MAX_LAG : lag;
+}
+
+// Narrower window: 0.7x to 1.3x the expected period to avoid harmonics.
+// Behind the band-pass prefilter the harmonics are gone, so 0.8x to 1.25x.
+constexpr LagWindow lagWindowFromCenter(int center, bool prefiltered) {
+  return prefiltered
+    ? LagWindow{(int16_t)center, clampLag((int)(center * 0.8f)), clampLag((int)(center * 1.25f))}
+    : LagWindow{(int16_t)center, clampLag((int)(center * 0.7f)), clampLag((int)(center * 1.3f))};
+}
+
+constexpr LagWindow lagWindowAround(float freq, bool prefiltered) {
+  return lagWindowFromCenter((int)(SAMPLING_FREQ / freq), prefiltered);
+}
+
+// ===== TUNING DEFINITIONS =====
+// Each tuning is one line of MIDI notes, low string first. Frequencies, note
+// names and the per-string detection tables in TuningDef are all expanded
+// from these at compile time.
+struct TuningSpec {
+  const char* name;
+  uint8_t midi[6];
+  bool flats;  // Spell accidentals as flats (Eb) instead of sharps (D#)
+};
+
+constexpr TuningSpec TUNING_SPECS[] = {
+  {"STANDARD",    {40, 45, 50, 55, 59, 64}, false},  // E2 A2 D3 G3 B3 E4
+  {"Eb Standard", {39, 44, 49, 54, 58, 63}, true},   // Eb2 Ab2 Db3 Gb3 Bb3 Eb4
+  {"Drop D",      {38, 45, 50, 55, 59, 64}, false},  // D2 A2 D3 G3 B3 E4
+  {"Open G",      {38, 43, 50, 55, 59, 62}, false}   // D2 G2 D3 G3 B3 D4
+};
+
+const int NUM_TUNINGS = sizeof(TUNING_SPECS) / sizeof(TUNING_SPECS[0]);
+
+struct TuningDef {
+  const char* name;
+  float freqs[6];
+  const char* noteNames[6];  // Note names for each string in this tuning
+  uint8_t midi[6];
+  float upperBounds[6];      // String s covers freqs below upperBounds[s]
+  int32_t lowerPeriodsQ8[6]; // Same bounds as 1200*log2(period), Q8: s covers periods above
+  LagWindow lagWindows[6];   // Autocorrelation search window per string
+  LagWindow narrowLagWindows[6];  // Same, behind the band-pass prefilter
+  int32_t centsQ8[6];        // 1200 * log2(SAMPLING_FREQ / freq), Q8 cents
+};
+
+struct NoteName {
+  char s[4];
+};
+
+constexpr NoteName makeNoteName(int midi, bool flats) {
+  return "010100101010"[midi % 12] == '1'
+    ? NoteName{{(flats ? "CDDEEFGGAABB" : "CCDDEFFGGAAB")[midi % 12], flats ? 'b' : '#',
+                (char)('0' + midi / 12 - 1), 0}}
+    : NoteName{{"CCDDEFFGGAAB"[midi % 12], (char)('0' + midi / 12 - 1), 0, 0}};
+}
+
+constexpr NoteName tuningNoteName(int i) {
+  return makeNoteName(TUNING_SPECS[i / 6].midi[i % 6], TUNING_SPECS[i / 6].flats);
+}
+
+typedef ConstTable<NoteName, tuningNoteName, MakeSeq<NUM_TUNINGS * 6>::type> TuningNoteNames;
+
+constexpr double stringFreq(int t, int s) {
+  return halfMidiToFreq(2 * TUNING_SPECS[t].midi[s]);
+}
+
+// Strings split at the geometric midpoint of neighbouring targets, i.e. the
+// note half-way between them, so a pitch goes to the string it is fewer cents from
+constexpr float stringUpperBound(int t, int s) {
+  return s < 5 ? (float)halfMidiToFreq(TUNING_SPECS[t].midi[s] + TUNING_SPECS[t].midi[s + 1]) : 1e9f;
+}
+
+constexpr int32_t stringLowerPeriodQ8(int t, int s) {
+  return s < 5 ? centsToQ8(1200.0 * constLog2(SAMPLING_FREQ /
+                           halfMidiToFreq(TUNING_SPECS[t].midi[s] + TUNING_SPECS[t].midi[s + 1])))
+               : 0;
+}
+
+template<int... S>
+constexpr TuningDef makeTuningDef(int t, IndexSeq<S...>) {
+  return TuningDef{
+    TUNING_SPECS[t].name,
+    {(float)stringFreq(t, S)...},
+    {TuningNoteNames::values[t * 6 + S].s...},
+    {TUNING_SPECS[t].midi[S]...},
+    {stringUpperBound(t, S)...},
+    {stringLowerPeriodQ8(t, S)...},
+    {lagWindowAround((float)stringFreq(t, S), false)...},
+    {lagWindowAround((float)stringFreq(t, S), true)...},
+    {centsToQ8(1200.0 * constLog2(SAMPLING_FREQ / stringFreq(t, S)))...}
+  };
+}
+
+constexpr TuningDef tuningDefAt(int t) {
+  return makeTuningDef(t, MakeSeq<6>::type());
+}
+
+typedef ConstTable<TuningDef, tuningDefAt, MakeSeq<NUM_TUNINGS>::type> TuningTable;
+static constexpr const TuningDef (&tuningModes)[NUM_TUNINGS] = TuningTable::values;
+
+extern const char* NOTE_NAMES[12];
+
+extern float signalLevel;  // Level of the last frame given to detectPitch(), on its thread
+
+// ===== SAMPLE CAPTURE =====
+
+// Lock-free single-producer / single-consumer ring. The producer (the ADC's
+// acquisition task or a test source) only advances 'written'; the consumer
+// only reads.
+// RING_SIZE - SAMPLES samples of slack (~375 ms) cover a slow consumer.
+//
+// push() is also the acquisition pre-pass: each sample goes through a one-pole
+// DC blocker (the piezo idles at mid-scale) and into a running sum of |x| over
+// the newest SAMPLES samples. A captured window is already DC-free and its
+// level is known without another pass over it. Every ONSET_BLOCK samples it
+// also updates the ambient noise floor and checks for an onset.
+class SampleRing {
+public:
+  void push(int16_t raw) {
+    // y[n] = x[n] - x[n-1] + R * y[n-1], R = 1 - 2^-DC_BLOCK_SHIFT, state in Q8
+    if (!primed) {
+      lastRaw = raw;
+      primed = true;
+    }
+    dcState += ((int32_t)(raw - lastRaw) << 8) - (dcState >> DC_BLOCK_SHIFT);
+    lastRaw = raw;
+    int32_t y = (dcState + 128) >> 8;
+    int16_t v = (int16_t)constrain(y, -32768, 32767);
+
+    uint32_t w = written.load(std::memory_order_relaxed);
+    int16_t leaving = buf[(w - SAMPLES) & (RING_SIZE - 1)];
+    buf[w & (RING_SIZE - 1)] = v;
+    levelSum.store(levelSum.load(std::memory_order_relaxed) + abs(v) - abs(leaving),
+                   std::memory_order_relaxed);
+    written.store(w + 1, std::memory_order_release);
+    trackOnset(abs(v), w + 1);
+  }
+
+  uint32_t count() const {
+    return written.load(std::memory_order_acquire);
+  }
+
+  // Mean |x| of the newest SAMPLES samples. The producer may have pushed a
+  // few more since count() was read, which is fine for a noise gate.
+  float level() const {
+    return (float)levelSum.load(std::memory_order_relaxed) / SAMPLES;
+  }
+
+  // Onsets seen so far; onsetIndex()/onsetMs() describe the latest one
+  uint32_t onsetCount() const {
+    return onsets.load(std::memory_order_acquire);
+  }
+
+  uint32_t onsetIndex() const {
+    return lastOnsetIndex.load(std::memory_order_relaxed);
+  }
+
+  unsigned long onsetMs() const {
+    return lastOnsetMs.load(std::memory_order_relaxed);
+  }
+
+  // Ambient level in the same units as level()
+  float noiseFloor() const {
+    return floorLevel.load(std::memory_order_relaxed);
+  }
+
+  // Copy the n samples ending at absolute index 'end' (exclusive)
+  void copyWindow(int16_t* dst, uint32_t end, uint16_t n) const {
+    uint32_t start = end - n;
+    for (uint16_t i = 0; i < n; i++) {
+      dst[i] = buf[(start + i) & (RING_SIZE - 1)];
+    }
+  }
+
+  // Back to an empty, unprimed ring; only while no producer is running
+  void reset() {
+    memset(buf, 0, sizeof(buf));
+    written.store(0);
+    levelSum.store(0);
+    dcState = 0;
+    lastRaw = 0;
+    primed = false;
+    blockSum = 0;
+    blockFill = 0;
+    prevBlock[0] = prevBlock[1] = 0.0f;
+    loudBlocks = 0;
+    floorLevel.store(NOISE_THRESHOLD / NOISE_FLOOR_RATIO);
+    onsets.store(0);
+    lastOnsetIndex.store(0);
+    lastOnsetMs.store(0);
+  }
+
+private:
+  static const int DC_BLOCK_SHIFT = 8;  // ~5 Hz corner at 8192 Hz
+
+  // index = absolute position just past the sample, as count() would report
+  void trackOnset(int32_t mag, uint32_t index) {
+    blockSum += mag;
+    if (++blockFill < ONSET_BLOCK) return;
+    float blockLevel = (float)blockSum / ONSET_BLOCK;
+    blockSum = 0;
+    blockFill = 0;
+
+    float floorNow = floorLevel.load(std::memory_order_relaxed);
+    uint32_t n = onsets.load(std::memory_order_relaxed);
+    bool loud = blockLevel >= ONSET_FLOOR_RATIO * floorNow;
+    if (loud && blockLevel >= NOISE_THRESHOLD &&
+        blockLevel > ONSET_RISE * prevBlock[0] && blockLevel > ONSET_RISE * prevBlock[1] &&
+        (n == 0 || index - lastOnsetIndex.load(std::memory_order_relaxed) >= ONSET_REFRACTORY)) {
+      lastOnsetIndex.store(index, std::memory_order_relaxed);
+      lastOnsetMs.store(halMillis(), std::memory_order_relaxed);
+      onsets.store(n + 1, std::memory_order_release);
+    }
+    prevBlock[1] = prevBlock[0];
+    prevBlock[0] = blockLevel;
+
+    // Minimum-following floor: drops quickly, creeps up slowly, and ignores
+    // blocks that are clearly signal unless they go on long enough to be
+    // the new ambient (hum, a fan) rather than a note
+    loudBlocks = loud ? loudBlocks + 1 : 0;
+    if (!loud || loudBlocks > FLOOR_STUCK_BLOCKS) {
+      floorNow += (blockLevel - floorNow) * (blockLevel < floorNow ? FLOOR_FALL : FLOOR_RISE);
+      floorLevel.store(floorNow, std::memory_order_relaxed);
+    }
+  }
+
+  int16_t buf[RING_SIZE];
+  std::atomic<uint32_t> written{0};
+  std::atomic<int32_t> levelSum{0};
+  int32_t dcState = 0;
+  int16_t lastRaw = 0;
+  bool primed = false;
+
+  int32_t blockSum = 0;
+  int blockFill = 0;
+  float prevBlock[2] = {0.0f, 0.0f};
+  uint32_t loudBlocks = 0;
+  std::atomic<float> floorLevel{NOISE_THRESHOLD / NOISE_FLOOR_RATIO};
+  std::atomic<uint32_t> onsets{0};
+  std::atomic<uint32_t> lastOnsetIndex{0};
+  std::atomic<unsigned long> lastOnsetMs{0};
+};
+
+extern SampleRing sampleRing;
+extern uint32_t lastWindowEnd;
+extern float frameLevel;   // Ring level when the current frame was captured
+extern bool frameActive;   // Current frame passed the noise/onset gate
+
+// Sample n of the synthetic pluck used by the bench: decaying fundamental
+// plus two harmonics on a mid-scale offset, re-plucked every second
+int16_t syntheticSample(float freq, uint32_t n);
+
+// Noise gate for the window ending at 'end', from the ring's level, noise
+// floor and latest onset
+bool frameGateOpen(uint32_t end);
+
+// Non-blocking: copies the newest window into sampleBuffer and returns true
+// once FRAME_HOP fresh samples are available, otherwise returns false.
+bool captureSamples();
+
+// Band-pass biquad centred on the target string (RBJ, 0 dB peak gain).
+// Q14 coefficients; b1 = 0 and b2 = -b0 for a band-pass.
+struct BandPass {
+  float freq;
+  int32_t b0, a1, a2;
+};
+
+const BandPass* prefilterFor(float expectedFreq);
+void prefilterFrame(const BandPass* bp);
+
+// ===== CORRELATION KERNEL =====
+int32_t dotProduct16(const int16_t* a, const int16_t* b, int n);
+void dotProduct16Pair(const int16_t* a, const int16_t* b0, const int16_t* b1, int n,
+                      int32_t &out0, int32_t &out1);
+
+// ===== FFT =====
+void fftComplex(float* re, float* im, int n, const float* cosTab, const float* sinTab,
+                bool inverse);
+void realFftPower(const float* re, const float* im, int n, const float* cosTab,
+                  const float* sinTab, float* power);
+
+// ===== CORRELATION ENGINES =====
+bool initCorrelationEngine();
+void advanceCorrelation(uint32_t windowEnd);
+void prepareCorrelation();
+int32_t lagCorrelation(int lag);
+void neighbourCorrelations(int lag, int32_t &prev, int32_t &next);
+int coarseToFineLagSearch(int minLag, int maxLag, int32_t &maxCorr);
+
+// ===== FIXED-POINT CENTS =====
+int32_t parabolicPeakQ15(int lag, int32_t prev, int32_t curr, int32_t next);
+
+// Fixed-point cents, carried in Q8 (1/256 cent). With L the integer lag and
+// v = frac / L: 1200*log2(L + frac) = lagCents[L] + K*(v - v^2/2 + v^3/3),
+// K = 1200/ln 2; v < 1/18 here so the truncated series is good to 0.005 cent.
+const int LAG_CENTS_LEN = SAMPLES / 2 + 2;
+const int64_t LOG2_CENTS_Q8 = 443196;       // 1200 / ln(2) in Q8
+
+// 1200 * log2(L) in Q8, generated at compile time
+constexpr int32_t lagCentsAt(int lag) {
+  return lag > 0 ? centsToQ8(1200.0 * constLog2(lag)) : 0;
+}
+
+typedef ConstTable<int32_t, lagCentsAt, MakeSeq<LAG_CENTS_LEN>::type> LagCentsTable;
+static constexpr const int32_t (&lagCentsQ8)[LAG_CENTS_LEN] = LagCentsTable::values;
+
+// A4 as a period: 1200 * log2(SAMPLING_FREQ / 440) in Q8. Pitch in cents re
+// A4 is this minus the period's log, so the tracker can run on lags too.
+constexpr int32_t A4_PERIOD_Q8 = centsToQ8(1200.0 * constLog2(SAMPLING_FREQ / 440.0));
+
+// 1200 * log2(period) in Q8 for a period in Q15 samples: the log the cents
+// come from
+int32_t periodQ8FromLagQ15(int32_t lagQ15);
+
+// Cents of the period lagQ15 relative to string s of the given tuning, in Q8
+int32_t centsFromLagQ15(int32_t lagQ15, int tuning, int s);
+
+// String of the given tuning whose range holds the period, by bounds on
+// 1200*log2(period), so the fixed-point path never goes through Hz
+int stringForPeriodQ8(int32_t periodQ8, int tuning);
+int stringForLagQ15(int32_t lagQ15, int tuning);
+
+// Note name and cents for a period on a known string, as a Q15 lag or as
+// 1200*log2(period) in Q8
+void lagToNote(int32_t lagQ15, int tuning, int stringNum, const char* &name, int &cents);
+void periodToNote(int32_t periodQ8, int tuning, int stringNum, const char* &name, int &cents);
+
+// Float path: nearest note name, cents from the string's target, or from the
+// nearest note when stringNum is -1
+void freqToNote(float f, int tuning, int stringNum, const char* &name, int &cents);
+
+// ===== PITCH DETECTION =====
+LagWindow lagWindowFor(float expectedFreq, bool prefiltered);
+float detectPitchAutocorrelation(float expectedFreq);
+float detectPitchYIN(float expectedFreq);
+
+extern float (*const PITCH_DETECTORS[ENGINE_COUNT])(float expectedFreq);
+
+// Runs the selected detector on the captured frame; 0 = no pitch
+float detectPitch(float expectedFreq);
@@ -0,0 +1,93 @@
+// Plucked-string generator for the self tests: the "selftest" commands on
+// the device and host/test/selftest_test.cpp on Linux play the same seeded
+// plucks, so their reports can be compared.
+#pragma once
+
+#include <math.h>
+
+#include "pitch_dsp.h"
+
+// Karplus-Strong plucked string: a delay line closed through a two-point
+// average, an allpass for stiffness (upper partials run sharp) and a
+// fractional-delay allpass that tunes the loop exactly. Output is scaled and
+// offset like the piezo front end, with white noise added.
+class PluckSynth {
+public:
+  float dispersion = 0.25f;  // Stiffness allpass coefficient, 0 = harmonic
+  float t60 = 3.0f;          // Seconds to decay by 60 dB
+  float amplitude = 500.0f;
+  float noise = 3.0f;        // Peak white noise, ADC counts
+  float dcOffset = 2048.0f;
+
+  void pluck(float freq, uint32_t seed) {
+    rng = seed ? seed : 1;
+    float w = 2.0f * (float)M_PI * freq / SAMPLING_FREQ;
+    float ad = -dispersion;
+    float dispDelay = allpassDelay(ad, w);
+    float loop = SAMPLING_FREQ / freq - 0.5f - dispDelay;  // Average adds 0.5
+    len = (int)(loop - 0.5f);
+    if (len > MAX_LEN) len = MAX_LEN;
+    float frac = loop - len;  // In [0.5, 1.5): keeps the tuning allpass stable
+    disp.a = ad;
+    tune.a = sinf((1.0f - frac) * w / 2.0f) / sinf((1.0f + frac) * w / 2.0f);
+    disp.x1 = disp.y1 = tune.x1 = tune.y1 = 0.0f;
+    gain = powf(10.0f, -3.0f / (t60 * freq));
+
+    float mean = 0.0f;
+    for (int i = 0; i < len; i++) {
+      line[i] = uniform();
+      mean += line[i];
+    }
+    mean /= len;
+    for (int i = 0; i < len; i++) line[i] -= mean;
+    prev = 0.0f;
+    pos = 0;
+  }
+
+  // Ambient noise only, for the quiet lead-in before a pluck
+  int16_t quiet() {
+    return (int16_t)lroundf(dcOffset + noise * uniform());
+  }
+
+  int16_t next() {
+    float out = line[pos];
+    float avg = 0.5f * (out + prev);
+    prev = out;
+    line[pos] = gain * tune.process(disp.process(avg));
+    if (++pos >= len) pos = 0;
+    return (int16_t)lroundf(dcOffset + amplitude * out + noise * uniform());
+  }
+
+private:
+  struct Allpass {
+    float a, x1, y1;
+    float process(float x) {
+      float y = a * x + x1 - a * y1;
+      x1 = x;
+      y1 = y;
+      return y;
+    }
+  };
+
+  // Phase delay in samples of (a + z^-1) / (1 + a z^-1) at w rad/sample
+  static float allpassDelay(float a, float w) {
+    float num = atan2f(-sinf(w), a + cosf(w));
+    float den = atan2f(-a * sinf(w), 1.0f + a * cosf(w));
+    return -(num - den) / w;
+  }
+
+  // Uniform in [-1, 1), xorshift32 so runs are repeatable
+  float uniform() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return (float)(int32_t)rng / 2147483648.0f;
+  }
+
+  static const int MAX_LEN = 256;
+  float line[MAX_LEN];
+  Allpass disp, tune;
+  float gain = 1.0f, prev = 0.0f;
+  int len = 1, pos = 0;
+  uint32_t rng = 1;
+};
@@ -0,0 +1,41 @@
+#include "profile.h"
+
+#if PROFILE
+
+const char* PROFILE_STAGE_NAMES[PROF_STAGE_COUNT] = {
+  "capture", "prefilter", "lag_scan", "refine", "detect", "note", "servo",
+  "display", "loop_delay"
+};
+
+ProfileStat profileStats[PROF_STAGE_COUNT];
+
+void profileRecord(int stage, uint32_t cycles) {
+  ProfileStat &p = profileStats[stage];
+  if (p.count == 0 || cycles < p.minCycles) p.minCycles = cycles;
+  if (cycles > p.maxCycles) p.maxCycles = cycles;
+  p.totalCycles += cycles;
+  p.hist[cycles ? 31 - __builtin_clz(cycles) : 0]++;
+  p.count++;
+}
+
+void profileReset() {
+  memset(profileStats, 0, sizeof(profileStats));
+}
+
+uint32_t profilePercentile(const ProfileStat &p, float fraction) {
+  if (p.count == 0) return 0;
+  float want = fraction * p.count;
+  uint32_t seen = 0;
+  for (int b = 0; b < PROFILE_BUCKETS; b++) {
+    if (p.hist[b] == 0) continue;
+    if (seen + p.hist[b] >= want) {
+      float lo = (float)(1u << b);
+      float into = (want - seen) / p.hist[b];
+      return min((uint32_t)(lo + lo * into), p.maxCycles);
+    }
+    seen += p.hist[b];
+  }
+  return p.maxCycles;
+}
+
+#endif  // PROFILE
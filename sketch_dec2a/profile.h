@@ -0,0 +1,66 @@
+// Per-stage profiling. PROFILE_SCOPE(stage) times the rest of the enclosing
+// block in CPU cycles and adds it to that stage's log2 histogram. "prof" on
+// Serial dumps min/mean/p99/max per stage, as does the hidden screen (hold
+// SELECT on the string select screen). Build with -DPROFILE=0 to compile it
+// all out; set it as a build flag so every translation unit agrees.
+#pragma once
+
+#include "hal.h"
+
+#ifndef PROFILE
+#define PROFILE 1
+#endif
+
+#if PROFILE
+
+enum ProfileStage {
+  PROF_CAPTURE,         // Window copy and correlation engine update
+  PROF_PREFILTER,       // Band-pass over the frame
+  PROF_LAG_SCAN,        // Correlation / CMNDF scan
+  PROF_REFINE,          // Subharmonic check and peak interpolation
+  PROF_DETECT,          // Whole detector, the three above included
+  PROF_NOTE,            // Frequency or lag to note and cents
+  PROF_SERVO,
+  PROF_DISPLAY,
+  PROF_LOOP_DELAY,      // The delay() at the end of loop()
+  PROF_STAGE_COUNT
+};
+
+extern const char* PROFILE_STAGE_NAMES[PROF_STAGE_COUNT];
+
+const int PROFILE_BUCKETS = 32;  // Bucket b counts spans of 2^b .. 2^(b+1) - 1 cycles
+
+// Each stage is written by one task only (the DSP task or loop()); readers
+// take the counters as they are, which is good enough for a dump
+struct ProfileStat {
+  uint32_t count;
+  uint32_t minCycles, maxCycles;
+  uint64_t totalCycles;
+  uint32_t hist[PROFILE_BUCKETS];
+};
+
+extern ProfileStat profileStats[PROF_STAGE_COUNT];
+
+void profileRecord(int stage, uint32_t cycles);
+void profileReset();
+
+// Cycles below which 'fraction' of the spans fall, interpolated linearly
+// inside the log2 bucket and capped at the largest span seen
+uint32_t profilePercentile(const ProfileStat &p, float fraction);
+
+class ProfileScope {
+public:
+  explicit ProfileScope(int stage) : stage(stage), start(halCycles()) {}
+  ~ProfileScope() { profileRecord(stage, halCycles() - start); }
+
+private:
+  int stage;
+  uint32_t start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(stage) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(stage)
+#else
+#define PROFILE_SCOPE(stage) ((void)0)
+#endif
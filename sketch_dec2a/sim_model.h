@@ -0,0 +1,105 @@
+// Guitar model for the auto-tune simulators: the "sim" command on the
+// device and host/sim/tuner_sim.cpp on Linux draw the same seeded strings
+// and play the same tone, so their reports can be compared.
+#pragma once
+
+#include "pitch_dsp.h"
+
+const int SIM_HARMONICS = 4;
+
+// xorshift32; unit() is uniform in [0, 1)
+struct SimRng {
+  uint32_t state;
+
+  explicit SimRng(uint32_t seed) : state(seed * 2654435761u | 1) {}
+
+  uint32_t next() {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  float unit() { return (float)(next() >> 8) / 16777216.0f; }
+};
+
+// One string: pitch follows the servo angle through a first-order lag (the
+// string takes a moment to slip over the nut), cents = detune + gain * angle
+// travelled since the string was started
+struct SimString {
+  float targetHz;
+  float detune;    // Cents at the starting angle
+  float gain;      // Cents per degree
+  float tauMs;     // Angle lag
+  float refAngle;  // Servo angle the detune refers to
+  float angle;     // Angle the string has followed to
+
+  float cents() const {
+    return detune + gain * (angle - refAngle);
+  }
+
+  float hz() const {
+    return targetHz * powf(2.0f, cents() / 1200.0f);
+  }
+
+  // Where the string ends up once it has caught up with the servo
+  float settledCents(int servoAngle) const {
+    return detune + gain * (servoAngle - refAngle);
+  }
+
+  // Starts the string from the servo's current angle
+  void engage(int servoAngle) {
+    refAngle = angle = (float)servoAngle;
+  }
+
+  void follow(int servoAngle, float dtMs) {
+    angle += (servoAngle - angle) * (1.0f - expf(-dtMs / tauMs));
+  }
+
+  // The user moved the servo horn back without touching the tuning peg
+  void shift(int deg) {
+    angle += deg;
+    refAngle += deg;
+  }
+};
+
+// The six strings of one scenario: random detune (+-60 cents), gain
+// (3-8 c/deg) and lag (120-220 ms) from 'rng'
+inline void simDrawStrings(SimRng &rng, const float targetHz[6], SimString strings[6]) {
+  for (int s = 0; s < 6; s++) {
+    strings[s].targetHz = targetHz[s];
+    strings[s].detune = -60.0f + 120.0f * rng.unit();
+    strings[s].gain = 3.0f + 5.0f * rng.unit();
+    strings[s].tauMs = 120.0f + 100.0f * rng.unit();
+    strings[s].refAngle = strings[s].angle = 0.0f;
+  }
+}
+
+// Decaying harmonic tone at the string's current pitch, scaled like the
+// piezo front end
+struct SimTone {
+  float phase = 0.0f;
+  float env = 0.0f;
+  float decay = 1.0f;
+  uint32_t rng = 1;
+
+  void pluck() {
+    env = 1.0f;
+    decay = powf(10.0f, -3.0f / (3.0f * (float)SAMPLING_FREQ));  // t60 = 3 s
+  }
+
+  int16_t next(float hz) {
+    phase += hz / (float)SAMPLING_FREQ;
+    if (phase >= 1.0f) phase -= 1.0f;
+    float v = 0.0f;
+    for (int h = 1; h <= SIM_HARMONICS; h++) {
+      v += sinf(2.0f * (float)M_PI * h * phase) / h;
+    }
+    env *= decay;
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    float noise = 3.0f * (float)(int32_t)rng / 2147483648.0f;
+    return (int16_t)lroundf(2048.0f + 500.0f / 2.08f * env * v + noise);  // Harmonics peak at ~2.08
+  }
+};
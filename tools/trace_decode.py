@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+"""Decodes the tuner's binary trace ("trace bin") into the CSV that
+"trace csv" prints on the device: us,event,servo,cents,value,level.
+
+    trace_decode.py [capture.bin] [--text]
+
+Reads a raw serial capture (stdin when no file is given). Anything between
+frames - command replies, other prints, a frame cut short - is skipped;
+--text copies it to stderr. The frame layout is in trace_format.md.
+"""
+
+import argparse
+import struct
+import sys
+
+SYNC = b"\xa5\x5a"
+RECORD = struct.Struct("<IBBhff")  # TraceRecord
+VERSION = 1
+
+# As in TRACE_EVENT_NAMES; a header frame replaces them
+EVENT_NAMES = ["track", "frame", "held", "display", "onset", "subharmonic", "narrow",
+               "enter", "leave", "in_tune", "servo", "limit", "gain"]
+
+
+def frames(data):
+    """Yields (type, payload) for each valid frame and (None, bytes) for the
+    bytes between them."""
+    pos = 0
+    skipped = bytearray()
+    while pos < len(data):
+        start = data.find(SYNC, pos)
+        if start < 0 or start + 4 > len(data):
+            skipped += data[pos:]
+            break
+        skipped += data[pos:start]
+        ftype, length = data[start + 2], data[start + 3]
+        end = start + 4 + length
+        if end < len(data) and (ftype + length + sum(data[start + 4:end])) & 0xFF == data[end]:
+            if skipped:
+                yield None, bytes(skipped)
+                skipped = bytearray()
+            yield chr(ftype), data[start + 4:end]
+            pos = end + 1
+        else:
+            skipped += data[start:start + 1]  # Not a frame after all; resync past it
+            pos = start + 1
+    if skipped:
+        yield None, bytes(skipped)
+
+
+def decode(data, out, text=None):
+    names = list(EVENT_NAMES)
+    out.write("us,event,servo,cents,value,level\n")
+    for ftype, payload in frames(data):
+        if ftype is None:
+            if text:
+                text.write(payload.decode("latin-1"))
+        elif ftype == "H":
+            version, size, count = payload[0], payload[1], payload[2]
+            if version != VERSION or size != RECORD.size:
+                raise SystemExit(f"trace_decode: unsupported stream (version {version}, "
+                                 f"{size}-byte records)")
+            header_names = [n.decode() for n in payload[3:].split(b"\0")[:-1]]
+            if len(header_names) == count:
+                names = header_names
+        elif ftype == "R" and len(payload) == RECORD.size:
+            us, event, servo, cents, value, level = RECORD.unpack(payload)
+            name = names[event] if event < len(names) else "?"
+            out.write("%d,%s,%d,%d,%.2f,%.1f\n" % (us, name, servo, cents, value, level))
+        elif ftype == "D" and len(payload) == 4:
+            out.write("# trace: %d records dropped\n" % struct.unpack("<I", payload)[0])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("capture", nargs="?", help="raw serial capture (default: stdin)")
+    parser.add_argument("--text", action="store_true", help="copy non-trace bytes to stderr")
+    args = parser.parse_args()
+    if args.capture:
+        with open(args.capture, "rb") as f:
+            data = f.read()
+    else:
+        data = sys.stdin.buffer.read()
+    decode(data, sys.stdout, sys.stderr if args.text else None)
+
+
+if __name__ == "__main__":
+    main()